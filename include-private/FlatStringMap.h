@@ -0,0 +1,209 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef MAPLANG_SRC_FLATSTRINGMAP_H_
+#define MAPLANG_SRC_FLATSTRINGMAP_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace maplang {
+
+/**
+ * A string-keyed hash map which stores its entries in one array (open
+ * addressing with linear probing).
+ *
+ * Lookups take a std::string_view and the key's hash, so callers can hash a
+ * key once and look it up without creating a std::string. Only inserting a
+ * key longer than the small-string buffer allocates, apart from growing.
+ *
+ * Inserting and erasing move entries, so pointers to values are only valid
+ * until the next insert() or erase().
+ */
+template <class Value>
+class FlatStringMap final {
+ public:
+  static size_t hashKey(std::string_view key) {
+    return std::hash<std::string_view>()(key);
+  }
+
+  Value* find(std::string_view key) { return find(key, hashKey(key)); }
+
+  Value* find(std::string_view key, size_t keyHash) {
+    if (mSize == 0) {
+      return nullptr;
+    }
+
+    for (size_t i = getHomeIndex(keyHash);; i = getNextIndex(i)) {
+      Slot& slot = mSlots[i];
+      if (!slot.occupied) {
+        return nullptr;
+      } else if (slot.keyHash == keyHash && slot.key == key) {
+        return &slot.value;
+      }
+    }
+  }
+
+  /**
+   * Returns the value for |key|, and true if it was inserted (as Value()).
+   */
+  std::pair<Value*, bool> insert(std::string_view key, size_t keyHash) {
+    Value* const existingValue = find(key, keyHash);
+    if (existingValue != nullptr) {
+      return {existingValue, false};
+    }
+
+    if ((mSize + 1) * kMaxLoadDenominator
+        > mSlots.size() * kMaxLoadNumerator) {
+      grow();
+    }
+
+    size_t i = getHomeIndex(keyHash);
+    while (mSlots[i].occupied) {
+      i = getNextIndex(i);
+    }
+
+    Slot& slot = mSlots[i];
+    slot.occupied = true;
+    slot.keyHash = keyHash;
+    slot.key.assign(key.data(), key.size());
+    mSize++;
+
+    return {&slot.value, true};
+  }
+
+  // Returns false if there was no value for |key|.
+  bool erase(std::string_view key, size_t keyHash) {
+    if (mSize == 0) {
+      return false;
+    }
+
+    size_t i = getHomeIndex(keyHash);
+    while (true) {
+      const Slot& slot = mSlots[i];
+      if (!slot.occupied) {
+        return false;
+      } else if (slot.keyHash == keyHash && slot.key == key) {
+        break;
+      }
+
+      i = getNextIndex(i);
+    }
+
+    /*
+     * Moves later entries of the probe sequence back into the hole, so
+     * lookups never need to skip erased slots.
+     */
+    size_t hole = i;
+    for (size_t j = getNextIndex(hole); mSlots[j].occupied;
+         j = getNextIndex(j)) {
+      const size_t home = getHomeIndex(mSlots[j].keyHash);
+      const bool homeIsAfterHole =
+          (j > hole) ? (home > hole && home <= j) : (home > hole || home <= j);
+      if (homeIsAfterHole) {
+        continue;
+      }
+
+      mSlots[hole] = std::move(mSlots[j]);
+      hole = j;
+    }
+
+    mSlots[hole] = Slot();
+    mSize--;
+
+    return true;
+  }
+
+  bool erase(std::string_view key) { return erase(key, hashKey(key)); }
+
+  size_t size() const { return mSize; }
+  bool empty() const { return mSize == 0; }
+
+  template <class Function>
+  void forEach(Function&& function) {
+    for (Slot& slot : mSlots) {
+      if (slot.occupied) {
+        function(std::string_view(slot.key), slot.value);
+      }
+    }
+  }
+
+ private:
+  static constexpr size_t kInitialCapacity = 16;
+  static constexpr size_t kMaxLoadNumerator = 3;
+  static constexpr size_t kMaxLoadDenominator = 4;
+
+  struct Slot final {
+    bool occupied = false;
+    size_t keyHash = 0;
+    std::string key;
+    Value value {};
+  };
+
+  /*
+   * Fibonacci hashing spreads the hash over the table, even when the low bits
+   * of hashes are the same (e.g. keys which were sharded by hash).
+   */
+  size_t getHomeIndex(size_t keyHash) const {
+    return static_cast<size_t>(
+        (static_cast<uint64_t>(keyHash) * 0x9E3779B97F4A7C15ull)
+        >> mIndexShift);
+  }
+
+  size_t getNextIndex(size_t index) const {
+    return (index + 1) & (mSlots.size() - 1);
+  }
+
+  void grow() {
+    const size_t newCapacity =
+        mSlots.empty() ? kInitialCapacity : mSlots.size() * 2;
+
+    std::vector<Slot> oldSlots(newCapacity);
+    oldSlots.swap(mSlots);
+
+    mIndexShift = 64;
+    for (size_t capacity = newCapacity; capacity > 1; capacity >>= 1) {
+      mIndexShift--;
+    }
+
+    for (Slot& oldSlot : oldSlots) {
+      if (!oldSlot.occupied) {
+        continue;
+      }
+
+      size_t i = getHomeIndex(oldSlot.keyHash);
+      while (mSlots[i].occupied) {
+        i = getNextIndex(i);
+      }
+
+      mSlots[i] = std::move(oldSlot);
+    }
+  }
+
+ private:
+  std::vector<Slot> mSlots;
+  size_t mSize = 0;
+  unsigned mIndexShift = 64;
+};
+
+}  // namespace maplang
+
+#endif  // MAPLANG_SRC_FLATSTRINGMAP_H_
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef MAPLANG_SRC_HTTPCHUNKEDDECODER_H_
+#define MAPLANG_SRC_HTTPCHUNKEDDECODER_H_
+
+#include <cstdint>
+
+#include "maplang/Buffer.h"
+
+namespace maplang {
+
+/**
+ * Decodes a body sent with "Transfer-Encoding: chunked", as the bytes arrive.
+ *
+ * Decoded data is returned as slices of the received buffers, so chunk data is
+ * never copied. Chunk extensions and trailers are skipped.
+ */
+class HttpChunkedDecoder final {
+ public:
+  // Longest chunk size line (with extensions), and longest trailer section.
+  static constexpr size_t kMaxChunkLineLength = 4 * 1024;
+  static constexpr size_t kMaxTrailersLength = 64 * 1024;
+
+  HttpChunkedDecoder();
+
+  /**
+   * Decodes bytes from the start of |buffer|, and returns how many of them
+   * belong to the body. Decoding stops after the first chunk data found, which
+   * is put in |data| (empty when there is none), or at the end of the body.
+   * Call again with the rest of |buffer| until it is used up or isComplete().
+   *
+   * When isComplete() becomes true, the rest of |buffer| is the next message.
+   *
+   * Throws if the body is malformed.
+   */
+  size_t decode(const Buffer& buffer, Buffer* data);
+
+  bool isComplete() const { return mState == State::Complete; }
+
+  void reset();
+
+ private:
+  enum class State {
+    Size,
+    Extension,
+    SizeLineEnd,
+    Data,
+    DataCr,
+    DataLineEnd,
+    TrailerLineStart,
+    Trailer,
+    TrailerLineEnd,
+    LastLineEnd,
+    Complete,
+  };
+
+  void expectByte(uint8_t actual, uint8_t expected, State nextState);
+
+ private:
+  State mState;
+  uint64_t mChunkSize;
+  size_t mChunkSizeDigitCount;
+  size_t mLineLength;
+  size_t mTrailersLength;
+};
+
+}  // namespace maplang
+
+#endif  // MAPLANG_SRC_HTTPCHUNKEDDECODER_H_
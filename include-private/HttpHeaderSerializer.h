@@ -0,0 +1,81 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef MAPLANG_SRC_HTTPHEADERSERIALIZER_H_
+#define MAPLANG_SRC_HTTPHEADERSERIALIZER_H_
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "maplang/Buffer.h"
+#include "maplang/IBufferFactory.h"
+
+namespace maplang {
+
+/**
+ * Serializes the start line and headers of an HTTP/1.1 message into one
+ * buffer of exactly the right size.
+ *
+ * Parts are referenced until serialize() copies them, so strings passed in
+ * must outlive it. Status lines for the default reasons are formatted once.
+ * Bodies aren't serialized; they go in the packet as separate buffers, and are
+ * written together with the headers by the TCP connection's vectored write.
+ */
+class HttpHeaderSerializer final {
+ public:
+  HttpHeaderSerializer();
+
+  HttpHeaderSerializer(const HttpHeaderSerializer&) = delete;
+  HttpHeaderSerializer& operator=(const HttpHeaderSerializer&) = delete;
+
+  // "HTTP/1.1 <status> <default reason>\r\n"
+  void addStatusLine(uint64_t statusCode);
+  void addStatusLine(uint64_t statusCode, std::string_view reason);
+
+  // "<method> <path> HTTP/1.1\r\n"
+  void addRequestLine(std::string_view method, std::string_view path);
+
+  void addHeader(std::string_view name, std::string_view value);
+  void addContentLength(size_t contentLength);
+
+  // The blank line after the headers.
+  void endHeaders();
+
+  // The size line of a chunk in a chunked body ("<hex size>\r\n").
+  void addChunkSize(size_t chunkSize);
+
+  void addLineEnd();
+
+  Buffer serialize(const IBufferFactory& bufferFactory) const;
+
+ private:
+  void add(std::string_view part);
+  std::string_view formatNumber(uint64_t number, int base);
+
+ private:
+  std::vector<std::string_view> mParts;
+  size_t mLength;
+
+  // Formatted numbers, referenced by mParts.
+  std::array<char, 64> mNumbers;
+  size_t mNumbersLength;
+};
+
+}  // namespace maplang
+
+#endif  // MAPLANG_SRC_HTTPHEADERSERIALIZER_H_
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef MAPLANG_SRC_HTTPREQUESTPARSER_H_
+#define MAPLANG_SRC_HTTPREQUESTPARSER_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "maplang/Buffer.h"
+#include "maplang/json.hpp"
+
+namespace maplang {
+
+/**
+ * Parses the request line and headers of an HTTP/1.x request in one pass, as
+ * the bytes arrive.
+ *
+ * Fields are kept as offsets into the received buffers, which are referenced
+ * rather than copied. Strings are only created by createParameters(), for the
+ * fields and headers which are put in the parameters. Header values are found
+ * with memchr(), which scans many bytes at a time.
+ */
+class HttpRequestParser final {
+ public:
+  static constexpr size_t kMaxHeaderBlockLength = 64 * 1024;
+  static constexpr uint64_t kNoContentLength = UINT64_MAX;
+
+  HttpRequestParser();
+
+  /**
+   * Parses the next bytes of the request, and returns how many bytes of
+   * |buffer| belong to the request line and headers. Parsing stops at the end
+   * of the headers, so when isComplete() becomes true, the rest of |buffer| is
+   * body data (or the next request).
+   *
+   * Throws if the request is malformed or its headers are too long.
+   */
+  size_t parse(const Buffer& buffer);
+
+  bool isComplete() const { return mState == State::Complete; }
+
+  // Forgets the parsed request, and releases the received buffers.
+  void reset();
+
+  // kNoContentLength when the request has no Content-Length header.
+  uint64_t getContentLength() const { return mContentLength; }
+
+  bool hasTransferEncoding() const { return mHasTransferEncoding; }
+
+  // True when the body is sent with "Transfer-Encoding: chunked".
+  bool isChunked() const { return mIsChunked; }
+
+  /**
+   * Returns the method, path, version and headers (with lower-case names) as
+   * parameters. When |includedHeaders| isn't null, only the headers named in
+   * it are included. Only call when isComplete().
+   */
+  nlohmann::json createParameters(
+      const std::unordered_set<std::string>* includedHeaders = nullptr) const;
+
+ private:
+  enum class State {
+    LeadingLineEnd,
+    Method,
+    Path,
+    Version,
+    RequestLineEnd,
+    HeaderLineStart,
+    HeaderName,
+    HeaderValueStart,
+    HeaderValue,
+    HeaderLineEnd,
+    HeadersEnd,
+    Complete,
+  };
+
+  // Offsets are from the start of the first received buffer.
+  struct Slice final {
+    size_t offset = 0;
+    size_t length = 0;
+  };
+
+  struct Header final {
+    Slice name;
+    Slice value;
+  };
+
+  uint8_t byteAt(size_t offset) const;
+  Slice trimTrailingWhitespace(Slice slice) const;
+  bool equalsIgnoringCase(const Slice& slice, std::string_view lowerCase) const;
+  void appendSlice(const Slice& slice, bool toLowerCase, std::string* out)
+      const;
+  std::string toString(const Slice& slice, bool toLowerCase = false) const;
+
+  void onHeaderParsed();
+
+ private:
+  State mState;
+  size_t mParsedLength;
+  std::vector<Buffer> mBuffers;
+
+  Slice mMethod;
+  Slice mPath;
+  Slice mVersion;
+  Header mHeader;
+  std::vector<Header> mHeaders;
+  uint64_t mContentLength;
+  bool mHasTransferEncoding;
+  bool mIsChunked;
+};
+
+}  // namespace maplang
+
+#endif  // MAPLANG_SRC_HTTPREQUESTPARSER_H_
@@ -30,6 +30,7 @@ class AddParametersNode : public IImplementation, public IPathable {
   ~AddParametersNode() override = default;
 
   void handlePacket(const PathablePacket& incomingPacket) override;
+  bool isStateless() const override { return true; }
 
   IPathable* asPathable() override { return this; }
   ISource* asSource() override { return nullptr; }
@@ -18,17 +18,22 @@
 #define MAPLANG_HTTP_REQUEST_EXTRACTOR_H_
 
 #include <list>
+#include <optional>
 #include <random>
+#include <unordered_set>
 
+#include "HttpChunkedDecoder.h"
+#include "HttpRequestParser.h"
 #include "maplang/Factories.h"
 #include "maplang/IImplementation.h"
 #include "maplang/ISource.h"
-#include "maplang/MemoryStream.h"
 #include "maplang/json.hpp"
 
 namespace maplang {
 
-class HttpRequestExtractor final : public IImplementation, public IPathable {
+class HttpRequestExtractor final : public IImplementation,
+                                   public IPathable,
+                                   public IResettable {
  public:
   HttpRequestExtractor(
       const Factories& factories,
@@ -36,27 +41,46 @@ class HttpRequestExtractor final : public IImplementation, public IPathable {
   ~HttpRequestExtractor() override;
 
   void handlePacket(const PathablePacket& packet) override;
+  void reset() override;
 
   IPathable* asPathable() override { return this; }
   ISource* asSource() override { return nullptr; }
   IGroup* asGroup() override { return nullptr; }
+  IResettable* asResettable() override { return this; }
 
  private:
   const Factories mFactories;
   const nlohmann::json mInitParameters;
 
+  // When set, only these headers are put in "New Request" packets.
+  const std::optional<std::unordered_set<std::string>> mIncludedHeaders;
+
   std::shared_ptr<IPacketPusher> mLastPayloadsPacketPusher;
   std::random_device mRandomDevice;
   std::uniform_int_distribution<uint64_t> mUniformDistribution;
   bool mSentHeaders;
-  MemoryStream mHeaderData;
+
+  // Set when a request is malformed. Later packets are dropped until reset().
+  bool mConnectionFailed;
+
+  HttpRequestParser mRequestParser;
+  HttpChunkedDecoder mChunkedDecoder;
+
+  // Request ids are the connection id and the request's index on it.
+  std::string mConnectionId;
+  uint64_t mRequestIndex;
   std::string mRequestId;
   size_t mBodyLength;
   size_t mSentBodyDataByteCount;
 
-  void reset();
-  static nlohmann::json parseHeaders(const MemoryStream& headers);
-  Packet createHeaderPacket(const MemoryStream& memoryStream) const;
+  void startRequest(const std::shared_ptr<IPacketPusher>& packetPusher);
+  void endRequest(const std::shared_ptr<IPacketPusher>& packetPusher);
+  size_t sendChunkedBodyData(
+      const Buffer& buffer,
+      const std::shared_ptr<IPacketPusher>& packetPusher);
+  void resetRequest();
+  void resetConnection();
+  Packet createHeaderPacket() const;
   Packet createBodyPacket(const Buffer& bodyBuffer) const;
 
   void sendEndOfRequestPacketIfRequestPending(
@@ -19,6 +19,7 @@
 
 #include <random>
 
+#include "HttpChunkedDecoder.h"
 #include "maplang/Factories.h"
 #include "maplang/IImplementation.h"
 #include "maplang/ISource.h"
@@ -51,10 +52,14 @@ class HttpResponseExtractor final : public IImplementation,
   bool mReceivedHeaders;
   MemoryStream mHeaderData;
   std::string mRequestId;
+  HttpChunkedDecoder mChunkedDecoder;
+  bool mIsChunked;
   size_t mBodyLength;
   size_t mSentBodyDataByteCount;
 
   void reset();
+  void setBodyLength(const nlohmann::json& headers);
+  void sendBodyData(const Buffer& buffer);
   static nlohmann::json parseHeaders(const MemoryStream& headers);
   Packet createHeaderPacket(const MemoryStream& memoryStream) const;
   Packet createBodyPacket(const Buffer& bodyBuffer) const;
@@ -17,12 +17,27 @@
 #ifndef MAPLANG_RESPONSE_WRITER_H_
 #define MAPLANG_RESPONSE_WRITER_H_
 
+#include <memory>
+
 #include "maplang/Factories.h"
 #include "maplang/IImplementation.h"
 #include "maplang/ISource.h"
 
 namespace maplang {
 
+/**
+ * Writes HTTP/1.1 responses.
+ *
+ * Init parameters:
+ * - "dateHeader": true adds a Date header to responses without one. The date
+ *   is formatted once per second, by a timer on the node's loop.
+ * - "maxCachedResponses": keeps the serialized headers of up to this many
+ *   recent responses, and reuses them instead of serializing the same headers
+ *   again. A response is reused for the same status, httpHeaders and body
+ *   length. The least recently used response is evicted first. 0 (the
+ *   default) disables the cache. Cached Date headers are refreshed when the
+ *   date changes.
+ */
 class HttpResponseWriter : public IImplementation, public IPathable {
  public:
   HttpResponseWriter(
@@ -32,6 +47,9 @@ class HttpResponseWriter : public IImplementation, public IPathable {
 
   void handlePacket(const PathablePacket& packet) override;
 
+  void setSubgraphContext(
+      const std::shared_ptr<ISubgraphContext>& context) override;
+
   ISource* asSource() override { return nullptr; }
   IPathable* asPathable() override { return this; }
   IGroup* asGroup() override { return nullptr; }
@@ -39,6 +57,26 @@ class HttpResponseWriter : public IImplementation, public IPathable {
  private:
   const Factories mFactories;
   const nlohmann::json mInitParameters;
+
+  class DateHeader;
+  class ResponseCache;
+
+  // Null when disabled.
+  std::shared_ptr<DateHeader> mDateHeader;
+  std::shared_ptr<ResponseCache> mResponseCache;
+
+  // Ends each chunk of a chunked body.
+  const Buffer mLineEnd;
+
+  Buffer createHeaderBuffer(
+      const Packet& packet,
+      const nlohmann::json& httpHeaders,
+      bool isChunked,
+      const std::string* date) const;
+  Packet createHttpDataPacket(
+      const Buffer& headerBuffer,
+      const Buffer& body,
+      bool isChunk) const;
 };
 
 }  // namespace maplang
@@ -33,6 +33,7 @@ class ParameterExtractor : public IPathable, public IImplementation {
   ~ParameterExtractor() override = default;
 
   void handlePacket(const PathablePacket& packet) override;
+  bool isStateless() const override { return true; }
 
   ISource* asSource() override { return nullptr; }
   IPathable* asPathable() override { return this; }
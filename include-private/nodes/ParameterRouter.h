@@ -17,8 +17,12 @@
 #ifndef MAPLANG_INCLUDE_MAPLANG_PARAMETERROUTER_H_
 #define MAPLANG_INCLUDE_MAPLANG_PARAMETERROUTER_H_
 
+#include <list>
+#include <string_view>
+
 #include "maplang/Factories.h"
 #include "maplang/IImplementation.h"
+#include "maplang/ParameterSchema.h"
 
 namespace maplang {
 
@@ -42,7 +46,14 @@ class ParameterRouter final : public IPathable, public IImplementation {
   const Factories mFactories;
   const nlohmann::json mInitParameters;
 
-  nlohmann::json_pointer<nlohmann::basic_json<>> mRoutingKey;
+  ParameterSchema mParameterSchema;
+  ParameterSlot mRoutingKeySlot;
+  std::list<std::string> mChannels;
+
+ private:
+  static constexpr size_t kMaxCachedChannels = 64;
+
+  const std::string* findOrCacheChannel(std::string_view channelValue);
 };
 
 }  // namespace maplang
@@ -26,6 +26,13 @@ namespace maplang {
 
 class UvTcpImpl;
 
+/**
+ * TCP connections, listening and connecting on the group's loop.
+ *
+ * Open connections and the listening socket are closed, without sending
+ * packets, when the group and its interfaces are gone. They must be released
+ * on the loop's thread, or after the loop has stopped.
+ */
 class UvTcpConnectionGroup : public IGroup, public IImplementation {
  public:
   UvTcpConnectionGroup(
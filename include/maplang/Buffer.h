@@ -23,16 +23,19 @@
 #include <memory>
 #include <string>
 
+#include "maplang/BufferPtr.h"
+
 namespace maplang {
 
 struct Buffer {
   Buffer();
+  Buffer(BufferPtr data, size_t length);
   Buffer(const std::shared_ptr<uint8_t>& data, size_t length);
   explicit Buffer(const std::string& str);
 
   Buffer slice(size_t offset, size_t length = SIZE_MAX) const;
 
-  std::shared_ptr<uint8_t> data;
+  BufferPtr data;
   size_t length;
 };
 
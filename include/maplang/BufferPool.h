@@ -25,16 +25,33 @@
 
 namespace maplang {
 
-class BufferPool final {
+/**
+ * Recycles buffers in power-of-two size classes.
+ *
+ * Released buffers go to a small cache on the releasing thread, and from
+ * there to a free list shared by all threads. At most |maxRetainedBytes| are
+ * kept for reuse. Buffers larger than the largest size class are not pooled.
+ *
+ * A BufferPool is an IBufferFactory, so it can be the bufferFactory in
+ * Factories. Copies share the same buffers.
+ */
+class BufferPool final : public IBufferFactory {
  public:
+  static constexpr size_t kDefaultMaxRetainedBytes = 32 * 1024 * 1024;
+
   explicit BufferPool(
-      const std::shared_ptr<const IBufferFactory>& bufferFactory);
+      const std::shared_ptr<const IBufferFactory>& bufferFactory,
+      size_t maxRetainedBytes = kDefaultMaxRetainedBytes);
+
+  Buffer get(size_t minimumSize) const;
+
+  Buffer Create(size_t size) const override { return get(size); }
 
-  Buffer get(size_t minimumSize);
+  size_t getRetainedBytes() const;
 
  private:
-  struct Impl;
-  const std::shared_ptr<Impl> mImpl;
+  class Impl;
+  std::shared_ptr<Impl> mImpl;
 };
 
 }  // namespace maplang
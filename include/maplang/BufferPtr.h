@@ -0,0 +1,230 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MAPLANG_BUFFERPTR_H_
+#define MAPLANG_BUFFERPTR_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace maplang {
+
+/**
+ * The reference count of a BufferPtr, stored in the same allocation as the
+ * bytes it owns (or as the deleter, for bytes allocated elsewhere).
+ */
+struct BufferHeader {
+  // Called once, when the last reference is released. Frees the header.
+  void (*release)(BufferHeader* header);
+
+  std::atomic<size_t> references;
+
+  // Thread-confined buffers are counted without atomic read-modify-writes.
+  bool threadConfined;
+};
+
+/**
+ * An intrusively reference-counted pointer to buffer bytes.
+ *
+ * It has the parts of the std::shared_ptr<uint8_t> API which Buffer users
+ * need, and converts from a std::shared_ptr<uint8_t>, so code written for
+ * shared_ptr buffers still compiles. Buffers allocated with make() keep the
+ * reference count in front of their bytes, and copying or slicing one never
+ * allocates.
+ */
+class BufferPtr final {
+ public:
+  /**
+   * Allocates |size| bytes and the reference count together.
+   */
+  static BufferPtr make(size_t size);
+
+  /**
+   * Like make(), but the reference count is not atomic. The buffer and all of
+   * its copies must stay on one thread (usually one ThreadGroup's), so these
+   * are only for buffers which are not sent in packets.
+   */
+  static BufferPtr makeThreadConfined(size_t size);
+
+  /**
+   * Takes the reference in |header|, which must have a count of 1.
+   */
+  static BufferPtr adopt(BufferHeader* header, uint8_t* data) noexcept {
+    BufferPtr adopted;
+    adopted.mHeader = header;
+    adopted.mData = data;
+
+    return adopted;
+  }
+
+ public:
+  BufferPtr() noexcept = default;
+  BufferPtr(std::nullptr_t) noexcept {}
+
+  BufferPtr(const BufferPtr& other) noexcept
+      : mHeader(other.mHeader), mData(other.mData) {
+    addReference();
+  }
+
+  BufferPtr(BufferPtr&& other) noexcept
+      : mHeader(other.mHeader), mData(other.mData) {
+    other.mHeader = nullptr;
+    other.mData = nullptr;
+  }
+
+  /**
+   * Shares ownership with |owner| and points to |data|, like the shared_ptr
+   * aliasing constructor.
+   */
+  BufferPtr(const BufferPtr& owner, uint8_t* data) noexcept
+      : mHeader(owner.mHeader), mData(data) {
+    addReference();
+  }
+
+  /**
+   * Calls |deleter| with |data| when the last reference is released.
+   */
+  template <class Deleter>
+  BufferPtr(uint8_t* data, Deleter deleter);
+
+  BufferPtr(std::shared_ptr<uint8_t> data);
+
+  ~BufferPtr() { releaseReference(); }
+
+  BufferPtr& operator=(const BufferPtr& other) noexcept {
+    BufferPtr(other).swap(*this);
+    return *this;
+  }
+
+  BufferPtr& operator=(BufferPtr&& other) noexcept {
+    BufferPtr(std::move(other)).swap(*this);
+    return *this;
+  }
+
+  BufferPtr& operator=(std::nullptr_t) noexcept {
+    reset();
+    return *this;
+  }
+
+  uint8_t* get() const noexcept { return mData; }
+  uint8_t& operator*() const noexcept { return *mData; }
+  explicit operator bool() const noexcept { return mData != nullptr; }
+
+  void reset() noexcept { BufferPtr().swap(*this); }
+
+  size_t use_count() const noexcept {
+    return mHeader != nullptr
+               ? mHeader->references.load(std::memory_order_relaxed)
+               : 0;
+  }
+
+  void swap(BufferPtr& other) noexcept {
+    std::swap(mHeader, other.mHeader);
+    std::swap(mData, other.mData);
+  }
+
+ private:
+  template <class Deleter>
+  struct DeleterHeader final : BufferHeader {
+    uint8_t* data;
+    Deleter deleter;
+
+    static void releaseHeader(BufferHeader* header) {
+      auto deleterHeader = static_cast<DeleterHeader*>(header);
+      deleterHeader->deleter(deleterHeader->data);
+      delete deleterHeader;
+    }
+  };
+
+  void addReference() const noexcept {
+    if (mHeader == nullptr) {
+      return;
+    } else if (mHeader->threadConfined) {
+      mHeader->references.store(
+          mHeader->references.load(std::memory_order_relaxed) + 1,
+          std::memory_order_relaxed);
+    } else {
+      mHeader->references.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  void releaseReference() noexcept {
+    if (mHeader == nullptr) {
+      return;
+    }
+
+    size_t previousReferences;
+    if (mHeader->threadConfined) {
+      previousReferences = mHeader->references.load(std::memory_order_relaxed);
+      mHeader->references.store(
+          previousReferences - 1,
+          std::memory_order_relaxed);
+    } else {
+      previousReferences =
+          mHeader->references.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    if (previousReferences == 1) {
+      mHeader->release(mHeader);
+    }
+  }
+
+ private:
+  BufferHeader* mHeader = nullptr;
+  uint8_t* mData = nullptr;
+};
+
+template <class Deleter>
+BufferPtr::BufferPtr(uint8_t* data, Deleter deleter) {
+  auto header = new DeleterHeader<Deleter> {
+      {&DeleterHeader<Deleter>::releaseHeader, {1}, false},
+      data,
+      std::move(deleter)};
+
+  mHeader = header;
+  mData = data;
+}
+
+inline bool operator==(const BufferPtr& a, const BufferPtr& b) noexcept {
+  return a.get() == b.get();
+}
+
+inline bool operator!=(const BufferPtr& a, const BufferPtr& b) noexcept {
+  return a.get() != b.get();
+}
+
+inline bool operator==(const BufferPtr& a, std::nullptr_t) noexcept {
+  return a.get() == nullptr;
+}
+
+inline bool operator==(std::nullptr_t, const BufferPtr& b) noexcept {
+  return b.get() == nullptr;
+}
+
+inline bool operator!=(const BufferPtr& a, std::nullptr_t) noexcept {
+  return a.get() != nullptr;
+}
+
+inline bool operator!=(std::nullptr_t, const BufferPtr& b) noexcept {
+  return b.get() != nullptr;
+}
+
+}  // namespace maplang
+
+#endif  // MAPLANG_BUFFERPTR_H_
@@ -24,6 +24,7 @@
 #include "maplang/Graph.h"
 #include "maplang/IGroup.h"
 #include "maplang/IImplementation.h"
+#include "maplang/QueueOverflowPolicy.h"
 
 namespace maplang {
 
@@ -34,6 +35,13 @@ class DataGraph final : public IGroup {
  public:
   static const std::string kDefaultThreadGroupName;
 
+  /**
+   * Packets which a full ThreadGroup queue rejects are pushed on this channel
+   * of the sending node, when the ThreadGroup's QueueOverflowPolicy is
+   * RouteToOverflowChannel.
+   */
+  static const std::string kChannel_Overflow;
+
  public:
   explicit DataGraph(const Factories& factories);
   ~DataGraph() override = default;
@@ -63,6 +71,32 @@ class DataGraph final : public IGroup {
       const std::string& instanceName,
       const std::string& threadGroup);
 
+  /**
+   * Gives a ThreadGroup |workerCount| worker threads, which share the work of
+   * its stateless pathables (see IPathable::isStateless()). They take packets
+   * from each other when idle, so packets to a stateless pathable are handled
+   * in parallel and can be handled out of order.
+   *
+   * Set it before packets are sent. The worker count can't be changed later.
+   */
+  void setThreadGroupWorkerCount(
+      const std::string& threadGroupName,
+      size_t workerCount);
+
+  /**
+   * Limits how many packets can wait in a ThreadGroup's queue. When the queue
+   * is full, |overflowPolicy| decides what happens to the next packet. A
+   * |maxQueuedPackets| of 0 removes the limit (the default).
+   *
+   * Packets pushed directly to a target on the same thread are never queued,
+   * so they don't count towards the limit. Packets queued for worker threads
+   * do.
+   */
+  void setThreadGroupQueueLimit(
+      const std::string& threadGroupName,
+      size_t maxQueuedPackets,
+      QueueOverflowPolicy overflowPolicy);
+
   /**
    * An instance is an instantiated IImplementation. It doesn't have a concept
    * of connections.
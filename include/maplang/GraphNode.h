@@ -24,6 +24,7 @@
 
 #include "maplang/GraphEdge.h"
 #include "maplang/IPacketPusher.h"
+#include "maplang/Parameters.h"
 
 namespace maplang {
 
@@ -46,7 +47,7 @@ struct GraphNode final {
 
   // for parameter propagation when the downstream node(s) get a packet from
   // this node.
-  std::shared_ptr<const nlohmann::json> lastReceivedParameters;
+  Parameters lastReceivedParameters;
   std::list<std::weak_ptr<GraphNode>> backEdges;
 
   // All GraphElements this one connects to. channel => edges from this channel
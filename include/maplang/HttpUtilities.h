@@ -26,12 +26,16 @@ const extern std::string kParameter_HttpVersion;
 const extern std::string kParameter_HttpPath;
 const extern std::string kParameter_HttpMethod;
 const extern std::string kParameter_HttpRequestId;
+const extern std::string kParameter_HttpRequestIndex;
 const extern std::string kParameter_HttpHeaders;
 const extern std::string kParameter_HttpStatusCode;
 const extern std::string kParameter_HttpStatusReason;
+const extern std::string kParameter_HttpChunk;
 
 const extern std::string kHttpHeaderNormalized_ContentLength;
 const extern std::string kHttpHeaderNormalized_ContentType;
+const extern std::string kHttpHeaderNormalized_TransferEncoding;
+const extern std::string kHttpHeaderNormalized_Date;
 
 const extern int kHttpStatus_Continue;
 const extern int kHttpStatus_Ok;
@@ -39,6 +43,9 @@ const extern int kHttpStatus_BadRequest;
 
 std::string getDefaultReasonForHttpStatus(int status);
 
+// True when the last coding in a Transfer-Encoding header value is "chunked".
+bool isChunkedTransferEncoding(const std::string& transferEncoding);
+
 }  // namespace http
 }  // namespace maplang
 
@@ -20,6 +20,7 @@
 #include <functional>
 
 #include "maplang/IPathable.h"
+#include "maplang/IResettable.h"
 #include "maplang/ISource.h"
 #include "maplang/ISubgraphContext.h"
 #include "maplang/json.hpp"
@@ -38,6 +39,9 @@ class IImplementation {
   virtual IPathable* asPathable() = 0;
   virtual ISource* asSource() = 0;
   virtual IGroup* asGroup() = 0;
+
+  // Implementations which can be reused return non-null.
+  virtual IResettable* asResettable() { return nullptr; }
 };
 
 }  // namespace maplang
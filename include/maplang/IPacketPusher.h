@@ -17,6 +17,8 @@
 #ifndef MAPLANG_IPACKETPUSHER_H_
 #define MAPLANG_IPACKETPUSHER_H_
 
+#include <utility>
+
 #include "maplang/Packet.h"
 
 namespace maplang {
@@ -44,6 +46,21 @@ class IPacketPusher {
       const std::string& channelName) = 0;
 
   virtual void pushPacket(Packet&& packet, const std::string& channelName) = 0;
+
+  /**
+   * Like pushPacket(), but the packet inherits |receivedParameters| instead
+   * of the parameters of the last packet the node received.
+   *
+   * Nodes which hand packets to other threads use this, because the last
+   * packet the node received can be a different one by the time they push.
+   */
+  virtual void pushPacketInheritingFrom(
+      Packet&& packet,
+      const Parameters& receivedParameters,
+      const std::string& channelName) {
+    packet.parameters.inheritFrom(receivedParameters);
+    pushPacket(std::move(packet), channelName);
+  }
 };
 
 }  // namespace maplang
@@ -26,6 +26,19 @@ class IPathable {
   virtual ~IPathable() = default;
 
   virtual void handlePacket(const PathablePacket& incomingPacket) = 0;
+
+  /**
+   * Stateless pathables can handle several packets at once, on different
+   * threads. On a ThreadGroup with worker threads, they run on the workers
+   * (see DataGraph::setThreadGroupWorkerCount()), and others run on the
+   * ThreadGroup's own thread.
+   *
+   * A stateless pathable must push its packets from handlePacket(), because
+   * that's when its incoming parameters are known. Its packets can be handled
+   * out of order, so pathables which write a stream (e.g. HTTP responses on a
+   * connection) are not stateless.
+   */
+  virtual bool isStateless() const { return false; }
 };
 
 }  // namespace maplang
@@ -0,0 +1,42 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MAPLANG_IRESETTABLE_H_
+#define MAPLANG_IRESETTABLE_H_
+
+namespace maplang {
+
+/**
+ * Implementations which can be returned to their initial state.
+ *
+ * A Contextual node keeps the resettable instances of removed and evicted
+ * contexts, and reuses them for new contexts instead of creating new
+ * instances.
+ */
+class IResettable {
+ public:
+  virtual ~IResettable() = default;
+
+  /**
+   * Does what the destructor would do, then puts the instance in the state it
+   * had after construction. Called on the thread the instance runs on.
+   */
+  virtual void reset() = 0;
+};
+
+}  // namespace maplang
+
+#endif  // MAPLANG_IRESETTABLE_H_
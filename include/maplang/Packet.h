@@ -19,12 +19,13 @@
 
 #include "maplang/Buffer.h"
 #include "maplang/ISubgraphContext.h"
+#include "maplang/Parameters.h"
 #include "maplang/json.hpp"
 
 namespace maplang {
 
 struct Packet {
-  nlohmann::json parameters;
+  Parameters parameters;
   std::vector<Buffer> buffers;
 };
 
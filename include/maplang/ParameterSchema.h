@@ -0,0 +1,114 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MAPLANG_PARAMETERSCHEMA_H_
+#define MAPLANG_PARAMETERSCHEMA_H_
+
+#include <array>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "maplang/Parameters.h"
+
+namespace maplang {
+
+struct ParameterSlot final {
+  size_t index;
+};
+
+class ResolvedParameters;
+
+/**
+ * Declares the parameters a node reads from incoming packets.
+ *
+ * A node declares each key once (usually when it is constructed) and keeps
+ * the returned ParameterSlot. resolve() looks up every declared key in a
+ * single pass, after which reading a parameter is an array index, and strings
+ * are read as a std::string_view instead of being copied.
+ *
+ * Declared types and required keys are checked by resolve(). This is a first
+ * step towards the json-schema parameter validation in docs/Roadmap.md.
+ */
+class ParameterSchema final {
+ public:
+  static constexpr size_t kMaxSlots = 8;
+
+  enum class Type { Any, String, Number, Boolean, Object, Array };
+  enum class Presence { Optional, Required };
+
+ public:
+  /**
+   * |key| is a top-level key, or a JSON pointer if it starts with '/'.
+   */
+  ParameterSlot declare(
+      const std::string& key,
+      Type type = Type::Any,
+      Presence presence = Presence::Optional);
+
+  /**
+   * Throws if a required parameter is missing, or if a parameter has the
+   * wrong type.
+   *
+   * The result points into |parameters|, so it must not outlive them, and
+   * |parameters| must not be modified while the result is used.
+   */
+  ResolvedParameters resolve(const Parameters& parameters) const;
+
+  const std::string& getKey(ParameterSlot slot) const;
+
+ private:
+  struct Entry {
+    std::string key;
+    std::string firstToken;
+    std::optional<nlohmann::json::json_pointer> remainingPointer;
+    Type type;
+    Presence presence;
+  };
+
+  std::vector<Entry> mEntries;
+};
+
+class ResolvedParameters final {
+ public:
+  /**
+   * Returns nullptr if the parameter is not set.
+   */
+  const nlohmann::json* get(ParameterSlot slot) const {
+    return mValues[slot.index];
+  }
+
+  bool has(ParameterSlot slot) const { return get(slot) != nullptr; }
+
+  /**
+   * Throws if the parameter is not set or is not a string.
+   */
+  std::string_view getString(ParameterSlot slot) const;
+
+ private:
+  friend class ParameterSchema;
+
+  explicit ResolvedParameters(const ParameterSchema* schema)
+      : mSchema(schema) {}
+
+  const ParameterSchema* const mSchema;
+  std::array<const nlohmann::json*, ParameterSchema::kMaxSlots> mValues {};
+};
+
+}  // namespace maplang
+
+#endif  // MAPLANG_PARAMETERSCHEMA_H_
@@ -0,0 +1,205 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MAPLANG_PARAMETERS_H_
+#define MAPLANG_PARAMETERS_H_
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "maplang/json.hpp"
+
+namespace maplang {
+
+/**
+ * Packet parameters.
+ *
+ * Copies of a Parameters object share the same JSON value, so forwarding a
+ * Packet, fanning it out to several thread groups, or remembering it as a
+ * node's last received parameters only bumps a reference count. The shared
+ * value is never modified: the first modification made through a copy gives
+ * that copy its own value (copy-on-write).
+ *
+ * Parameters can also inherit from other Parameters (see inheritFrom()). This
+ * is how parameters propagate through the graph: inherited values are
+ * referenced rather than copied, and are only merged into a single object
+ * when the whole object is read (asJson(), iteration, dump(), etc.), or when
+ * flatten() is called. Single-key lookups with operator[], contains() and
+ * findValue() walk the inherited layers instead.
+ *
+ * Non-const operator[] and the other mutating methods detach (and flatten)
+ * first, so prefer reading parameters through a const reference (e.g.
+ * PathablePacket::packet).
+ */
+class Parameters final {
+ public:
+  Parameters() = default;
+  Parameters(std::nullptr_t) {}
+  Parameters(const nlohmann::json& value);
+  Parameters(nlohmann::json&& value);
+  Parameters(nlohmann::json::initializer_list_t init);
+
+  /**
+   * The current value, including inherited values. Null if nothing was set.
+   */
+  const nlohmann::json& asJson() const;
+  operator const nlohmann::json&() const { return asJson(); }
+
+  /**
+   * The current value, flattened and detached from other copies so it can be
+   * modified.
+   */
+  nlohmann::json& asMutableJson();
+
+  /**
+   * Adds |parent|'s values for keys which are not set here, without copying
+   * them. Values set here take precedence over inherited ones.
+   *
+   * If these parameters are null, they become a copy of |parent|. Parameters
+   * which are not an object (e.g. a number) do not inherit anything.
+   */
+  void inheritFrom(const Parameters& parent);
+
+  /**
+   * Merges inherited values into this object's own value.
+   */
+  void flatten();
+
+  bool isNull() const;
+
+  /**
+   * Looks up a top-level key, including inherited values. Returns nullptr if
+   * the key is not set.
+   */
+  const nlohmann::json* findValue(std::string_view key) const;
+
+  const nlohmann::json& operator[](std::string_view key) const;
+  const nlohmann::json& operator[](
+      const nlohmann::json::json_pointer& pointer) const {
+    return asJson()[pointer];
+  }
+
+  nlohmann::json& operator[](const std::string& key) {
+    return asMutableJson()[key];
+  }
+
+  nlohmann::json& operator[](const char* key) { return asMutableJson()[key]; }
+
+  nlohmann::json& operator[](const nlohmann::json::json_pointer& pointer) {
+    return asMutableJson()[pointer];
+  }
+
+  bool contains(std::string_view key) const {
+    return findValue(key) != nullptr;
+  }
+
+  bool contains(const nlohmann::json::json_pointer& pointer) const {
+    return asJson().contains(pointer);
+  }
+
+  template <typename Key>
+  nlohmann::json::const_iterator find(Key&& key) const {
+    return asJson().find(std::forward<Key>(key));
+  }
+
+  template <typename T>
+  T get() const {
+    return asJson().get<T>();
+  }
+
+  nlohmann::json::const_iterator begin() const { return asJson().begin(); }
+  nlohmann::json::const_iterator end() const { return asJson().end(); }
+  auto items() const { return asJson().items(); }
+  size_t size() const { return asJson().size(); }
+  bool empty() const { return asJson().empty(); }
+
+  std::string dump(int indent = -1) const { return asJson().dump(indent); }
+
+  /**
+   * Adds values for keys which are not set yet. Does not overwrite values.
+   */
+  void insert(
+      nlohmann::json::const_iterator first,
+      nlohmann::json::const_iterator last) {
+    asMutableJson().insert(first, last);
+  }
+
+  /**
+   * Adds values, overwriting existing keys.
+   */
+  void update(
+      nlohmann::json::const_iterator first,
+      nlohmann::json::const_iterator last) {
+    asMutableJson().update(first, last);
+  }
+
+  /**
+   * True if both objects share the same value (not just equal values).
+   */
+  bool sharesValueWith(const Parameters& other) const {
+    return mLayer == other.mLayer;
+  }
+
+ private:
+  struct Layer;
+
+  std::shared_ptr<Layer> mLayer;
+};
+
+inline bool operator==(const Parameters& parameters, std::nullptr_t) {
+  return parameters.isNull();
+}
+
+inline bool operator!=(const Parameters& parameters, std::nullptr_t) {
+  return !parameters.isNull();
+}
+
+inline bool operator==(const Parameters& a, const Parameters& b) {
+  return a.sharesValueWith(b) || a.asJson() == b.asJson();
+}
+
+inline bool operator!=(const Parameters& a, const Parameters& b) {
+  return !(a == b);
+}
+
+inline bool operator==(const Parameters& a, const nlohmann::json& b) {
+  return a.asJson() == b;
+}
+
+inline bool operator==(const nlohmann::json& a, const Parameters& b) {
+  return a == b.asJson();
+}
+
+inline bool operator!=(const Parameters& a, const nlohmann::json& b) {
+  return a.asJson() != b;
+}
+
+inline bool operator!=(const nlohmann::json& a, const Parameters& b) {
+  return a != b.asJson();
+}
+
+inline std::ostream& operator<<(
+    std::ostream& stream,
+    const Parameters& parameters) {
+  return stream << parameters.asJson();
+}
+
+}  // namespace maplang
+
+#endif  // MAPLANG_PARAMETERS_H_
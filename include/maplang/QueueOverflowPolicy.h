@@ -0,0 +1,44 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef MAPLANG_INCLUDE_MAPLANG_QUEUEOVERFLOWPOLICY_H_
+#define MAPLANG_INCLUDE_MAPLANG_QUEUEOVERFLOWPOLICY_H_
+
+#include "maplang/json.hpp"
+
+namespace maplang {
+
+/**
+ * What a ThreadGroup does with a packet when its queue is full.
+ */
+enum class QueueOverflowPolicy {
+  // Wait for space. Producers on the ThreadGroup's own thread can't wait, so
+  // their packets are queued anyway. Two ThreadGroups which block on each
+  // other's full queues deadlock, so use this for sources feeding a graph.
+  BlockProducer,
+  DropNewest,
+  DropOldest,
+
+  // Push the packet on the sending node's "Overflow" channel instead.
+  RouteToOverflowChannel,
+};
+
+void to_json(nlohmann::json& j, const QueueOverflowPolicy& policy);
+void from_json(const nlohmann::json& j, QueueOverflowPolicy& policy);
+
+}  // namespace maplang
+
+#endif  // MAPLANG_INCLUDE_MAPLANG_QUEUEOVERFLOWPOLICY_H_
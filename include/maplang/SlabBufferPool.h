@@ -0,0 +1,133 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MAPLANG_SLABBUFFERPOOL_H_
+#define MAPLANG_SLABBUFFERPOOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "maplang/Buffer.h"
+#include "maplang/BufferPtr.h"
+
+namespace maplang {
+
+/**
+ * Hands out buffers from slabs of fixed size classes.
+ *
+ * Buffers are allocated on one thread (the first thread to call allocate() or
+ * get(), usually a uv loop's thread), and can be released on any thread. A
+ * buffer released on another thread is returned to the pool the next time
+ * its free list is empty.
+ *
+ * The reference count of a buffer is stored in the buffer's slot, so handing
+ * out a buffer does not allocate once the slabs have grown large enough.
+ *
+ * Buffers can outlive the pool. The slabs are freed when the pool and all of
+ * its buffers are gone.
+ */
+class SlabBufferPool final {
+ public:
+  static const std::vector<size_t> kDefaultSizeClasses;
+
+  explicit SlabBufferPool(
+      const std::vector<size_t>& sizeClasses = kDefaultSizeClasses);
+  ~SlabBufferPool();
+
+  SlabBufferPool(const SlabBufferPool&) = delete;
+  SlabBufferPool& operator=(const SlabBufferPool&) = delete;
+
+  /**
+   * Returns the smallest buffer which holds |suggestedSize| bytes, or a buffer
+   * of the largest size class if none does. Like libuv's suggested size, the
+   * size is a hint, and |allocatedSize| is set to the buffer's real size.
+   *
+   * The buffer must be passed to share() once.
+   */
+  uint8_t* allocate(size_t suggestedSize, size_t* allocatedSize);
+
+  /**
+   * Returns ownership of a buffer from allocate(). |onRelease| is called, on
+   * the releasing thread, when the last reference is released.
+   */
+  template <class OnRelease>
+  static BufferPtr share(uint8_t* data, OnRelease&& onRelease);
+
+  static BufferPtr share(uint8_t* data);
+
+  Buffer get(size_t suggestedSize) {
+    size_t allocatedSize;
+    uint8_t* const data = allocate(suggestedSize, &allocatedSize);
+
+    return Buffer(share(data), allocatedSize);
+  }
+
+ private:
+  class Impl;
+
+  static constexpr size_t kOnReleaseSize = 32;
+
+  struct alignas(64) SlotHeader final {
+    // Must be first. BufferHeader::release() is passed a pointer to it.
+    BufferHeader bufferHeader;
+
+    void (*onRelease)(SlotHeader* slot);
+    alignas(std::max_align_t) unsigned char onReleaseStorage[kOnReleaseSize];
+
+    Impl* impl;
+    size_t sizeClassIndex;
+  };
+
+  static SlotHeader* getSlot(uint8_t* data) {
+    return reinterpret_cast<SlotHeader*>(data - sizeof(SlotHeader));
+  }
+
+  static BufferPtr shareSlot(SlotHeader* slot, uint8_t* data);
+
+  // Called on any thread.
+  static void releaseSlot(BufferHeader* bufferHeader);
+
+ private:
+  Impl* const mImpl;
+};
+
+template <class OnRelease>
+BufferPtr SlabBufferPool::share(uint8_t* data, OnRelease&& onRelease) {
+  using Callback = std::decay_t<OnRelease>;
+  static_assert(
+      sizeof(Callback) <= kOnReleaseSize,
+      "The onRelease callback does not fit in a slot.");
+  static_assert(alignof(Callback) <= alignof(std::max_align_t));
+
+  SlotHeader* const slot = getSlot(data);
+  new (slot->onReleaseStorage) Callback(std::forward<OnRelease>(onRelease));
+  slot->onRelease = [](SlotHeader* releasedSlot) {
+    auto callback =
+        std::launder(reinterpret_cast<Callback*>(releasedSlot->onReleaseStorage));
+    (*callback)();
+    callback->~Callback();
+  };
+
+  return shareSlot(slot, data);
+}
+
+}  // namespace maplang
+
+#endif  // MAPLANG_SLABBUFFERPOOL_H_
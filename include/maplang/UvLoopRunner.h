@@ -20,10 +20,12 @@
 #include <uv.h>
 
 #include <condition_variable>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <thread>
+#include <vector>
 
 namespace maplang {
 
@@ -34,6 +36,13 @@ class UvLoopRunner final {
 
   std::shared_ptr<uv_loop_t> getLoop() const;
 
+  /**
+   * Runs |task| on the loop's thread, after tasks posted before it. Handles
+   * must be initialized and closed on the loop's thread, so other threads use
+   * this to set them up. Called on any thread, until the loop exits.
+   */
+  void post(std::function<void()>&& task);
+
   void drain();
   bool waitForExit(
       const std::optional<std::chrono::milliseconds>& maxWait = {});
@@ -48,6 +57,13 @@ class UvLoopRunner final {
   bool mStopped = false;
   uv_async_s mUvAsync;
   std::thread::id mUvLoopThreadId;
+
+  std::mutex mTasksMutex;
+  std::vector<std::function<void()>> mTasks;
+
+ private:
+  static void onAsync(uv_async_t* async);
+  void runTasks();
 };
 
 }  // namespace maplang
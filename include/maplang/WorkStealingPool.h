@@ -0,0 +1,180 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef MAPLANG_WORKSTEALINGPOOL_H_
+#define MAPLANG_WORKSTEALINGPOOL_H_
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "maplang/concurrentqueue.h"
+#include "maplang/lightweightsemaphore.h"
+
+namespace maplang {
+
+/**
+ * Runs tasks on a fixed number of worker threads.
+ *
+ * Each worker has its own queue. Tasks submitted from a worker go to that
+ * worker's queue, and other tasks are spread over the queues round-robin. A
+ * worker with an empty queue steals from the others before it sleeps.
+ *
+ * Tasks run in parallel and in no particular order.
+ */
+template <class Task>
+class WorkStealingPool final {
+ public:
+  using TaskHandler = std::function<void(Task& task)>;
+
+  WorkStealingPool(size_t workerCount, TaskHandler&& handleTask);
+
+  /**
+   * Waits for running tasks to finish. Queued tasks are destroyed without
+   * being run.
+   */
+  ~WorkStealingPool();
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  void submit(Task&& task);
+
+  size_t getWorkerCount() const { return mWorkers.size(); }
+
+  bool isWorkerThread() const { return sCurrentPool == this; }
+
+ private:
+  struct Worker final {
+    moodycamel::ConcurrentQueue<Task> tasks;
+    std::thread thread;
+  };
+
+  // Sleeping workers wake up this often, in case a wakeup was missed.
+  static constexpr int64_t kMaxSleepMicroseconds = 50 * 1000;
+
+  void run(size_t workerIndex);
+  bool tryTakeTask(size_t workerIndex, Task& task);
+
+ private:
+  static inline thread_local const WorkStealingPool* sCurrentPool = nullptr;
+  static inline thread_local size_t sCurrentWorkerIndex = 0;
+
+  const TaskHandler mHandleTask;
+  std::vector<std::unique_ptr<Worker>> mWorkers;
+  moodycamel::LightweightSemaphore mTasksAvailable;
+  std::atomic<size_t> mSleepingWorkerCount = 0;
+  std::atomic<size_t> mNextWorkerIndex = 0;
+  std::atomic<bool> mStopping = false;
+};
+
+template <class Task>
+WorkStealingPool<Task>::WorkStealingPool(
+    size_t workerCount,
+    TaskHandler&& handleTask)
+    : mHandleTask(std::move(handleTask)) {
+  if (workerCount == 0) {
+    throw std::invalid_argument("A WorkStealingPool needs at least 1 worker.");
+  }
+
+  // All queues must exist before any worker steals from them.
+  for (size_t i = 0; i < workerCount; i++) {
+    mWorkers.push_back(std::make_unique<Worker>());
+  }
+
+  for (size_t i = 0; i < workerCount; i++) {
+    mWorkers[i]->thread = std::thread([this, i] { run(i); });
+  }
+}
+
+template <class Task>
+WorkStealingPool<Task>::~WorkStealingPool() {
+  mStopping = true;
+  mTasksAvailable.signal(mWorkers.size());
+
+  for (const auto& worker : mWorkers) {
+    worker->thread.join();
+  }
+}
+
+template <class Task>
+void WorkStealingPool<Task>::submit(Task&& task) {
+  const size_t workerIndex =
+      isWorkerThread()
+          ? sCurrentWorkerIndex
+          : mNextWorkerIndex.fetch_add(1, std::memory_order_relaxed)
+                % mWorkers.size();
+
+  mWorkers[workerIndex]->tasks.enqueue(std::move(task));
+
+  if (mSleepingWorkerCount.load() > 0) {
+    mTasksAvailable.signal();
+  }
+}
+
+template <class Task>
+void WorkStealingPool<Task>::run(size_t workerIndex) {
+  sCurrentPool = this;
+  sCurrentWorkerIndex = workerIndex;
+
+  Task task;
+  while (!mStopping.load(std::memory_order_relaxed)) {
+    if (!tryTakeTask(workerIndex, task)) {
+      // Checks again after announcing the sleep, so a task submitted
+      // in-between either is taken here or signals the semaphore.
+      mSleepingWorkerCount++;
+      const bool tookTask = tryTakeTask(workerIndex, task);
+      if (!tookTask) {
+        mTasksAvailable.wait(kMaxSleepMicroseconds);
+      }
+      mSleepingWorkerCount--;
+
+      if (!tookTask) {
+        continue;
+      }
+    }
+
+    mHandleTask(task);
+
+    // Releases what the task holds before waiting for the next one.
+    task = Task();
+  }
+}
+
+template <class Task>
+bool WorkStealingPool<Task>::tryTakeTask(size_t workerIndex, Task& task) {
+  if (mWorkers[workerIndex]->tasks.try_dequeue(task)) {
+    return true;
+  }
+
+  for (size_t i = 1; i < mWorkers.size(); i++) {
+    const size_t victimIndex = (workerIndex + i) % mWorkers.size();
+    if (mWorkers[victimIndex]->tasks.try_dequeue(task)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+}  // namespace maplang
+
+#endif  // MAPLANG_WORKSTEALINGPOOL_H_
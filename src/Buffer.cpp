@@ -6,12 +6,14 @@ namespace maplang {
 
 Buffer::Buffer() : data(nullptr), length(0) {}
 
+Buffer::Buffer(BufferPtr data, size_t length)
+    : data(move(data)), length(length) {}
+
 Buffer::Buffer(const shared_ptr<uint8_t>& data, size_t length)
-    : data(data, data.get()), length(length) {}
+    : data(data), length(length) {}
 
 Buffer::Buffer(const string& str)
-    : data {new uint8_t[str.length()], default_delete<uint8_t[]>()},
-      length(str.length()) {
+    : data(BufferPtr::make(str.length())), length(str.length()) {
   str.copy(reinterpret_cast<char*>(data.get()), str.length());
 }
 
@@ -23,7 +25,7 @@ Buffer Buffer::slice(size_t offset, size_t length) const {
   const size_t maxLength = this->length - offset;
 
   return Buffer(
-      shared_ptr<uint8_t>(data, data.get() + offset),
+      BufferPtr(data, data.get() + offset),
       min(maxLength, length));
 }
 
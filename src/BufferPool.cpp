@@ -16,7 +16,10 @@
 
 #include "maplang/BufferPool.h"
 
-#include <stack>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <vector>
 
 #include "maplang/concurrentqueue.h"
 
@@ -24,58 +27,278 @@ using namespace std;
 
 namespace maplang {
 
-struct BufferPool::Impl final {
-  using QueueType = moodycamel::ConcurrentQueue<Buffer>;
+// Size classes are 64 bytes to 1 MiB.
+static constexpr size_t kMinSizeClassShift = 6;
+static constexpr size_t kMaxSizeClassShift = 20;
+static constexpr size_t kSizeClassCount =
+    kMaxSizeClassShift - kMinSizeClassShift + 1;
+static constexpr size_t kMaxPooledSize = size_t(1) << kMaxSizeClassShift;
 
-  Impl(const std::shared_ptr<const IBufferFactory>& _bufferFactory)
-      : bufferFactory(_bufferFactory), bufferSize(0) {}
+// Each thread caches up to this many buffers, and bytes, per size class.
+static constexpr size_t kMaxThreadCacheBuffers = 16;
+static constexpr size_t kMaxThreadCacheBytes = 1024 * 1024;
 
-  const std::shared_ptr<const IBufferFactory> bufferFactory;
-  shared_ptr<QueueType> bufferQueue;
-  size_t bufferSize;
-};
+static size_t getSizeClass(size_t size) {
+  size_t shift = kMinSizeClassShift;
+  while ((size_t(1) << shift) < size) {
+    shift++;
+  }
 
-BufferPool::BufferPool(
-    const std::shared_ptr<const IBufferFactory>& bufferFactory)
-    : mImpl(make_shared<BufferPool::Impl>(bufferFactory)) {}
+  return shift - kMinSizeClassShift;
+}
+
+static size_t getSizeClassBytes(size_t sizeClass) {
+  return size_t(1) << (sizeClass + kMinSizeClassShift);
+}
+
+static size_t getThreadCacheLimit(size_t sizeClass) {
+  return clamp<size_t>(
+      kMaxThreadCacheBytes / getSizeClassBytes(sizeClass),
+      1,
+      kMaxThreadCacheBuffers);
+}
+
+class BufferPool::Impl final {
+ public:
+  Impl(
+      const shared_ptr<const IBufferFactory>& bufferFactory,
+      size_t maxRetainedBytes)
+      : mBufferFactory(bufferFactory), mMaxRetainedBytes(maxRetainedBytes) {}
+
+  Buffer get(size_t size) {
+    if (size == 0) {
+      return Buffer();
+    } else if (size > kMaxPooledSize) {
+      return mBufferFactory->Create(size);
+    }
+
+    const size_t sizeClass = getSizeClass(size);
+
+    PoolBuffer* poolBuffer = sThreadCache.take(this, sizeClass);
+    if (poolBuffer == nullptr) {
+      mFreeBuffers[sizeClass].try_dequeue(poolBuffer);
+    }
+
+    if (poolBuffer != nullptr) {
+      mRetainedBytes -= poolBuffer->storage.length;
+    } else {
+      poolBuffer = new PoolBuffer();
+      poolBuffer->release = &Impl::releasePoolBuffer;
+      poolBuffer->threadConfined = false;
+      poolBuffer->pool = this;
+      poolBuffer->sizeClass = sizeClass;
+      poolBuffer->storage =
+          mBufferFactory->Create(getSizeClassBytes(sizeClass));
+
+      mReferences.fetch_add(1, memory_order_relaxed);
+    }
+
+    poolBuffer->references.store(1, memory_order_relaxed);
 
-Buffer BufferPool::get(size_t bufferSize) {
-  if (bufferSize == 0) {
-    return Buffer();
+    return Buffer(
+        BufferPtr::adopt(poolBuffer, poolBuffer->storage.data.get()),
+        size);
   }
 
-  if (bufferSize > mImpl->bufferSize) {
-    mImpl->bufferQueue.reset();
-    mImpl->bufferQueue = make_shared<Impl::QueueType>();
-    mImpl->bufferSize = bufferSize;
+  size_t getRetainedBytes() const { return mRetainedBytes; }
+
+  // Called when the last BufferPool copy is gone.
+  void close() {
+    mClosed = true;
+    sThreadCache.drop(this);
+    destroyFreeBuffers();
+    release();
   }
 
-  Buffer sourceBuffer;
-  if (!mImpl->bufferQueue->try_dequeue(sourceBuffer)) {
-    sourceBuffer = mImpl->bufferFactory->Create(mImpl->bufferSize);
+ private:
+  struct PoolBuffer final : BufferHeader {
+    Impl* pool;
+    size_t sizeClass;
+    Buffer storage;
+  };
+
+  class ThreadCache final {
+   public:
+    ~ThreadCache() {
+      for (Entry& entry : mEntries) {
+        for (size_t sizeClass = 0; sizeClass < kSizeClassCount; sizeClass++) {
+          for (PoolBuffer* poolBuffer : entry.buffers[sizeClass]) {
+            entry.pool->returnToFreeBuffers(poolBuffer);
+          }
+        }
+      }
+    }
+
+    PoolBuffer* take(Impl* pool, size_t sizeClass) {
+      Entry* const entry = find(pool);
+      if (entry == nullptr || entry->buffers[sizeClass].empty()) {
+        return nullptr;
+      }
+
+      PoolBuffer* const poolBuffer = entry->buffers[sizeClass].back();
+      entry->buffers[sizeClass].pop_back();
+
+      return poolBuffer;
+    }
+
+    void put(PoolBuffer* poolBuffer) {
+      Impl* const pool = poolBuffer->pool;
+      Entry* entry = find(pool);
+      if (entry == nullptr) {
+        removeUnusedEntries();
+        mEntries.emplace_back();
+        entry = &mEntries.back();
+        entry->pool = pool;
+      }
+
+      vector<PoolBuffer*>& buffers = entry->buffers[poolBuffer->sizeClass];
+      if (buffers.size() >= getThreadCacheLimit(poolBuffer->sizeClass)) {
+        // Keeps half, so alternating gets and puts stay in this cache.
+        const size_t keepCount = buffers.size() / 2;
+        for (size_t i = keepCount; i < buffers.size(); i++) {
+          pool->returnToFreeBuffers(buffers[i]);
+        }
+
+        buffers.resize(keepCount);
+      }
+
+      buffers.push_back(poolBuffer);
+    }
+
+    void drop(Impl* pool) {
+      Entry* const entry = find(pool);
+      if (entry == nullptr) {
+        return;
+      }
+
+      for (auto& buffers : entry->buffers) {
+        for (PoolBuffer* poolBuffer : buffers) {
+          pool->destroyPoolBuffer(poolBuffer);
+        }
+
+        buffers.clear();
+      }
+    }
+
+   private:
+    struct Entry final {
+      Impl* pool;
+      array<vector<PoolBuffer*>, kSizeClassCount> buffers;
+    };
+
+    Entry* find(Impl* pool) {
+      for (Entry& entry : mEntries) {
+        if (entry.pool == pool) {
+          return &entry;
+        }
+      }
+
+      return nullptr;
+    }
+
+    /*
+     * Cached buffers hold a reference to their pool, so entries without any
+     * can refer to deleted pools. Buffers of closed pools are freed.
+     */
+    void removeUnusedEntries() {
+      for (Entry& entry : mEntries) {
+        if (!isEmpty(entry) && entry.pool->mClosed) {
+          drop(entry.pool);
+        }
+      }
+
+      mEntries.erase(
+          remove_if(mEntries.begin(), mEntries.end(), &ThreadCache::isEmpty),
+          mEntries.end());
+    }
+
+    static bool isEmpty(const Entry& entry) {
+      return all_of(
+          entry.buffers.begin(),
+          entry.buffers.end(),
+          [](const vector<PoolBuffer*>& buffers) { return buffers.empty(); });
+    }
+
+   private:
+    vector<Entry> mEntries;
+  };
+
+  // Called on the thread which released the last reference.
+  static void releasePoolBuffer(BufferHeader* header) {
+    auto poolBuffer = static_cast<PoolBuffer*>(header);
+    Impl* const pool = poolBuffer->pool;
+
+    const size_t retainedBytes =
+        pool->mRetainedBytes.fetch_add(poolBuffer->storage.length)
+        + poolBuffer->storage.length;
+
+    if (pool->mClosed || retainedBytes > pool->mMaxRetainedBytes) {
+      pool->mRetainedBytes -= poolBuffer->storage.length;
+      pool->destroyPoolBuffer(poolBuffer);
+      return;
+    }
+
+    sThreadCache.put(poolBuffer);
   }
 
-  if (bufferSize > sourceBuffer.length) {
-    throw runtime_error(
-        "Buffer Pool internal error. Recycled buffer is too small.");
+  void returnToFreeBuffers(PoolBuffer* poolBuffer) {
+    mFreeBuffers[poolBuffer->sizeClass].enqueue(poolBuffer);
+
+    // close() may have already emptied the free lists.
+    if (mClosed) {
+      destroyFreeBuffers();
+    }
   }
 
-  Buffer poolBuffer;
-  const weak_ptr<Impl::QueueType> weakBufferQueue = mImpl->bufferQueue;
-  poolBuffer.length = bufferSize;
-  poolBuffer.data = shared_ptr<uint8_t>(
-      sourceBuffer.data.get(),
-      [weakBufferQueue, origBuffer {sourceBuffer}](uint8_t* data) {
-        const auto bufferQueue = weakBufferQueue.lock();
+  void destroyFreeBuffers() {
+    for (auto& freeBuffers : mFreeBuffers) {
+      PoolBuffer* poolBuffer;
+      while (freeBuffers.try_dequeue(poolBuffer)) {
+        destroyPoolBuffer(poolBuffer);
+      }
+    }
+  }
 
-        if (bufferQueue == nullptr) {
-          return;
-        }
+  void destroyPoolBuffer(PoolBuffer* poolBuffer) {
+    delete poolBuffer;
+    release();
+  }
+
+  // BufferPool copies and each PoolBuffer hold a reference.
+  void release() {
+    if (mReferences.fetch_sub(1, memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+ private:
+  static thread_local ThreadCache sThreadCache;
 
-        bufferQueue->enqueue(origBuffer);
-      });
+  const shared_ptr<const IBufferFactory> mBufferFactory;
+  const size_t mMaxRetainedBytes;
+
+  array<moodycamel::ConcurrentQueue<PoolBuffer*>, kSizeClassCount>
+      mFreeBuffers;
+  atomic<size_t> mRetainedBytes {0};
+  atomic<size_t> mReferences {1};
+  atomic<bool> mClosed {false};
+};
+
+thread_local BufferPool::Impl::ThreadCache BufferPool::Impl::sThreadCache;
+
+BufferPool::BufferPool(
+    const shared_ptr<const IBufferFactory>& bufferFactory,
+    size_t maxRetainedBytes)
+    : mImpl(
+        new BufferPool::Impl(bufferFactory, maxRetainedBytes),
+        [](Impl* impl) { impl->close(); }) {}
+
+Buffer BufferPool::get(size_t bufferSize) const {
+  return mImpl->get(bufferSize);
+}
 
-  return poolBuffer;
+size_t BufferPool::getRetainedBytes() const {
+  return mImpl->getRetainedBytes();
 }
 
 }  // namespace maplang
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "maplang/BufferPtr.h"
+
+#include <new>
+
+using namespace std;
+
+namespace maplang {
+
+// Keeps the bytes after the header aligned like memory from operator new.
+static constexpr size_t kAlignedHeaderSize =
+    (sizeof(BufferHeader) + alignof(max_align_t) - 1) / alignof(max_align_t)
+    * alignof(max_align_t);
+
+static void releaseAllocatedHeader(BufferHeader* header) {
+  header->~BufferHeader();
+  ::operator delete(header);
+}
+
+static BufferPtr makeBufferPtr(size_t size, bool threadConfined) {
+  void* const allocation = ::operator new(kAlignedHeaderSize + size);
+  auto header = new (allocation)
+      BufferHeader {&releaseAllocatedHeader, {1}, threadConfined};
+
+  return BufferPtr::adopt(
+      header,
+      reinterpret_cast<uint8_t*>(allocation) + kAlignedHeaderSize);
+}
+
+BufferPtr BufferPtr::make(size_t size) { return makeBufferPtr(size, false); }
+
+BufferPtr BufferPtr::makeThreadConfined(size_t size) {
+  return makeBufferPtr(size, true);
+}
+
+BufferPtr::BufferPtr(shared_ptr<uint8_t> data) {
+  if (data == nullptr) {
+    return;
+  }
+
+  uint8_t* const rawData = data.get();
+  *this = BufferPtr(rawData, [owner = move(data)](uint8_t*) {});
+}
+
+}  // namespace maplang
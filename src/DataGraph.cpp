@@ -18,10 +18,14 @@
 
 #include <uv.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <iomanip>
 #include <list>
+#include <mutex>
 #include <optional>
-#include <set>
 #include <sstream>
 #include <unordered_map>
 
@@ -30,6 +34,7 @@
 #include "maplang/Instance.h"
 #include "maplang/Util.h"
 #include "maplang/UvLoopRunnerFactory.h"
+#include "maplang/WorkStealingPool.h"
 #include "maplang/concurrentqueue.h"
 
 using namespace std;
@@ -38,22 +43,90 @@ using json = nlohmann::json;
 namespace maplang {
 
 const string DataGraph::kDefaultThreadGroupName = "";
+const string DataGraph::kChannel_Overflow = "Overflow";
 
 }  // namespace maplang
 
 namespace maplang {
 
+/*
+ * Routing tables are compiled from a node's forwardEdges so pushPacket() does
+ * not need to look up instances, implementations or thread groups by name for
+ * every packet. They are rebuilt when the graph changes (see
+ * DataGraphImpl::invalidateRoutes()).
+ */
+struct PushedPacketInfo;
+using WorkerPool = WorkStealingPool<PushedPacketInfo>;
+
+struct CompiledEdge {
+  shared_ptr<GraphNode> node;
+  shared_ptr<IImplementation> implementation;
+  IPathable* pathable = nullptr;
+  ThreadGroup* threadGroup = nullptr;
+
+  // Set when the node is stateless and |threadGroup| has worker threads.
+  WorkerPool* workerPool = nullptr;
+
+  PacketDeliveryType deliveryType = PacketDeliveryType::PushDirectlyToTarget;
+};
+
+struct ThreadGroupRoute {
+  ThreadGroup* threadGroup = nullptr;
+
+  // Edges to stateless nodes on a ThreadGroup with workers have their own
+  // ThreadGroupRoute, with the ThreadGroup's WorkerPool.
+  WorkerPool* workerPool = nullptr;
+
+  // Edges to this thread group, which point into ChannelRoute::edges.
+  vector<const CompiledEdge*> edges;
+
+  // The subset of |edges| which queue even from the same thread.
+  vector<const CompiledEdge*> alwaysQueueEdges;
+};
+
+struct ChannelRoute {
+  string channel;
+  vector<CompiledEdge> edges;
+
+  // Each thread group used by |edges|, once.
+  vector<ThreadGroupRoute> threadGroups;
+};
+
+struct NodeRoutes {
+  uint64_t generation = 0;
+  vector<ChannelRoute> channels;
+
+  const ChannelRoute* find(const string& channel) const {
+    // Nodes have few channels, so a scan beats hashing the channel name.
+    for (const ChannelRoute& route : channels) {
+      if (route.channel == channel) {
+        return &route;
+      }
+    }
+
+    return nullptr;
+  }
+};
+
 struct PushedPacketInfo {
   Packet packet;
-  shared_ptr<GraphNode> fromNode;
-  thread::id queuedFromThreadId;
-  string channel;
+
+  // Set when enqueued from GraphPacketPusher::pushPacket(). |routes| keeps
+  // |targetEdges| alive if the graph changes while the packet is queued.
+  shared_ptr<const NodeRoutes> routes;
+  const vector<const CompiledEdge*>* targetEdges = nullptr;
 
   // Set when enqueued from DataGraph::sendPacket().
   shared_ptr<GraphNode> manualSendToNode;
 };
 
 struct ThreadGroup {
+  static constexpr size_t kMinDequeueBatchSize = 16;
+  static constexpr size_t kMaxDequeueBatchSize = 256;
+
+  // How long one packetReady() call delivers packets before yielding.
+  static constexpr uint64_t kPacketReadyTimeBudgetNs = 2 * 1000 * 1000;
+
   ThreadGroup(
       const shared_ptr<UvLoopRunner>& uvLoopRunner,
       const shared_ptr<DataGraphImpl>& dataGraphImpl);
@@ -63,6 +136,27 @@ struct ThreadGroup {
   void sendPacketToNode(
       const shared_ptr<GraphNode>& receivingNode,
       const Packet& packet);
+  void deliverPacket(const CompiledEdge& edge, const Packet& packet);
+  void deliverPacketOnWorker(PushedPacketInfo& packetInfo);
+
+  void setWorkerCount(size_t workerCount);
+  bool isThisThread(const WorkerPool* workerPool, thread::id threadId) const {
+    return workerPool != nullptr ? workerPool->isWorkerThread()
+                                 : threadId == mUvLoopThreadId;
+  }
+
+  /*
+   * Queues |info| and wakes the loop (or submits it to |workerPool|, if set),
+   * unless the queue is full and the overflow policy rejects it. |info| is
+   * only moved from when it's queued.
+   */
+  bool enqueue(PushedPacketInfo& info, WorkerPool* workerPool = nullptr);
+  bool acquireQueueSlot();
+  bool tryReserveQueueSlot(size_t maxQueuedPackets);
+  void releaseQueueSlots(size_t count);
+
+  // Sends mPacketReadyAsync unless a wakeup is already pending.
+  void wakeUp();
 
  public:
   const shared_ptr<UvLoopRunner> mUvLoopRunner;
@@ -71,6 +165,60 @@ struct ThreadGroup {
   moodycamel::ConcurrentQueue<PushedPacketInfo> mPacketQueue;
   thread::id mUvLoopThreadId;
   weak_ptr<DataGraphImpl> mDataGraphImpl;
+
+  // Set from the first enqueue after packetReady() starts draining, until
+  // the next packetReady(). Later enqueues don't need to send the async.
+  atomic<bool> mWakeupPending = false;
+
+  // Used by packetReady() only. Packets are dequeued into the same
+  // PushedPacketInfos every time, and the batch size grows while batches
+  // come back full.
+  moodycamel::ConsumerToken mPacketQueueConsumerToken;
+  vector<PushedPacketInfo> mDequeuedPackets;
+  size_t mDequeueBatchSize;
+
+  // 0 is unbounded.
+  atomic<size_t> mMaxQueuedPackets = 0;
+  atomic<QueueOverflowPolicy> mOverflowPolicy =
+      QueueOverflowPolicy::BlockProducer;
+  atomic<size_t> mQueuedPacketCount = 0;
+
+  // Producers blocked by QueueOverflowPolicy::BlockProducer wait here.
+  mutex mQueueSpaceMutex;
+  condition_variable mQueueSpaceAvailable;
+  atomic<size_t> mBlockedProducerCount = 0;
+
+  // Last, so workers stop before the rest of the ThreadGroup is destroyed.
+  unique_ptr<WorkerPool> mWorkerPool;
+};
+
+/*
+ * Set while a packet is delivered to a stateless node on a worker thread.
+ * Stateless nodes run on several threads at once, so a node's incoming
+ * parameters are kept here instead of in GraphNode::lastReceivedParameters.
+ */
+static thread_local const GraphNode* sWorkerDeliveryNode = nullptr;
+static thread_local const Parameters* sWorkerDeliveryParameters = nullptr;
+
+// Restores the previous delivery, for packets pushed directly from one
+// stateless node to another.
+class WorkerDeliveryScope final {
+ public:
+  WorkerDeliveryScope(const GraphNode* node, const Parameters* parameters)
+      : mPreviousNode(sWorkerDeliveryNode),
+        mPreviousParameters(sWorkerDeliveryParameters) {
+    sWorkerDeliveryNode = node;
+    sWorkerDeliveryParameters = parameters;
+  }
+
+  ~WorkerDeliveryScope() {
+    sWorkerDeliveryNode = mPreviousNode;
+    sWorkerDeliveryParameters = mPreviousParameters;
+  }
+
+ private:
+  const GraphNode* const mPreviousNode;
+  const Parameters* const mPreviousParameters;
 };
 
 class DataGraphImpl final : public enable_shared_from_this<DataGraphImpl> {
@@ -102,6 +250,13 @@ class DataGraphImpl final : public enable_shared_from_this<DataGraphImpl> {
   void validateInstanceImplementation(
       const string& graphNode,
       const shared_ptr<Instance>& instance) const;
+
+  shared_ptr<const NodeRoutes> compileRoutes(const shared_ptr<GraphNode>& node);
+  uint64_t getRoutesGeneration() const { return mRoutesGeneration.load(); }
+  void invalidateRoutes() { mRoutesGeneration++; }
+
+ private:
+  atomic<uint64_t> mRoutesGeneration = 1;
 };
 
 class SubgraphContext : public ISubgraphContext {
@@ -138,90 +293,227 @@ class GraphPacketPusher : public IPacketPusher {
       return;
     }
 
+    // Upstream parameters are referenced, not copied. They're merged with the
+    // packet's own parameters only if a node reads the whole object.
     Packet packetWithAccumulatedParameters = move(packet);
-    const auto lastReceivedParameters = fromNode->lastReceivedParameters;
+    packetWithAccumulatedParameters.parameters.inheritFrom(
+        sWorkerDeliveryNode == fromNode.get() ? *sWorkerDeliveryParameters
+                                              : fromNode->lastReceivedParameters);
 
-    if (lastReceivedParameters != nullptr) {
-      if (packetWithAccumulatedParameters.parameters == nullptr) {
-        packetWithAccumulatedParameters.parameters = *lastReceivedParameters;
-      } else {
-        // insert() does not overwrite values
-        packetWithAccumulatedParameters.parameters.insert(
-            lastReceivedParameters->begin(),
-            lastReceivedParameters->end());
-      }
+    routePacket(fromNode, move(packetWithAccumulatedParameters), fromChannel);
+  }
+
+  void pushPacketInheritingFrom(
+      Packet&& packet,
+      const Parameters& receivedParameters,
+      const string& fromChannel) override {
+    const auto fromNode = mNode.lock();
+    if (fromNode == nullptr) {
+      return;
     }
 
-    set<thread::id> queuedToThreadGroupIds;
+    Packet packetWithAccumulatedParameters = move(packet);
+    packetWithAccumulatedParameters.parameters.inheritFrom(receivedParameters);
+
+    routePacket(fromNode, move(packetWithAccumulatedParameters), fromChannel);
+  }
+
+  shared_ptr<const NodeRoutes> getRoutes(const shared_ptr<GraphNode>& node) {
+    auto routes = atomic_load(&mRoutes);
+
+    if (routes == nullptr
+        || routes->generation != mImpl->getRoutesGeneration()) {
+      routes = mImpl->compileRoutes(node);
+      atomic_store(&mRoutes, routes);
+    }
+
+    return routes;
+  }
+
+ private:
+  void routePacket(
+      const shared_ptr<GraphNode>& fromNode,
+      Packet&& packetWithAccumulatedParameters,
+      const string& fromChannel) {
     const thread::id thisThreadId = this_thread::get_id();
+    const auto routes = getRoutes(fromNode);
+    const ChannelRoute* const route = routes->find(fromChannel);
+    if (route == nullptr) {
+      DataGraphImpl::logDroppedPacket(
+          fromNode,
+          packetWithAccumulatedParameters,
+          fromChannel);
+      return;
+    }
+
     /*
-     * For each edge:
-     *   If the channel matches:
-     *     If the edge is direct and is in the same thread group, forward the
-     * packet If any channels match which are not direct, queue the packet to
-     * each matching thread group.
+     * Edges to nodes on this thread are pushed directly. Every other thread
+     * group (or this one, for AlwaysQueue edges) gets the packet queued once,
+     * because the ThreadGroup sends across all edges that run on it.
      */
+    for (const CompiledEdge& edge : route->edges) {
+      const bool pushDirectly =
+          edge.threadGroup->isThisThread(edge.workerPool, thisThreadId)
+          && edge.deliveryType == PacketDeliveryType::PushDirectlyToTarget;
 
-    vector<pair<shared_ptr<ThreadGroup>, Packet>> asyncThreadGroupPacketPairs;
-    const auto edgesFromChannelIt = fromNode->forwardEdges.find(fromChannel);
-    if (edgesFromChannelIt == fromNode->forwardEdges.end()) {
-      DataGraphImpl::logDroppedPacket(fromNode, packet, fromChannel);
-      return;
+      if (pushDirectly) {
+        edge.threadGroup->deliverPacket(edge, packetWithAccumulatedParameters);
+      }
     }
 
-    const vector<GraphEdge>& channelEdges = edgesFromChannelIt->second;
+    const ThreadGroupRoute* lastQueuedThreadGroupRoute = nullptr;
+    const vector<const CompiledEdge*>* lastQueuedTargetEdges = nullptr;
 
-    for (const GraphEdge& graphEdge : channelEdges) {
-      const shared_ptr<GraphNode> nextNode = graphEdge.next;
-      const shared_ptr<Instance> nextInstance =
-          mImpl->getInstanceForGraphNode(nextNode);
-      const auto nextNodesThreadGroup =
-          mImpl->getOrCreateThreadGroup(nextInstance->getThreadGroupName());
-      const auto nextNodesThreadId = nextNodesThreadGroup->mUvLoopThreadId;
-      const bool nextNodeIsSameThreadGroup = thisThreadId == nextNodesThreadId;
-      const bool pushDirectly =
-          nextNodeIsSameThreadGroup
-          && graphEdge.sameThreadQueueToTargetType
-                 == PacketDeliveryType::PushDirectlyToTarget;
+    for (const ThreadGroupRoute& threadGroupRoute : route->threadGroups) {
+      const bool isThisThread = threadGroupRoute.threadGroup->isThisThread(
+          threadGroupRoute.workerPool,
+          thisThreadId);
 
-      if (pushDirectly) {
-        nextNodesThreadGroup->sendPacketToNode(
-            nextNode,
-            packetWithAccumulatedParameters);
-      } else if (
-          queuedToThreadGroupIds.find(nextNodesThreadId)
-          == queuedToThreadGroupIds.end()) {
-        // Only dispatch once per thread group because the ThreadGroup will
-        // send across all connections that should be run on it.
-        asyncThreadGroupPacketPairs.emplace_back(
-            nextNodesThreadGroup,
-            packetWithAccumulatedParameters);
-
-        queuedToThreadGroupIds.insert(nextNodesThreadId);
+      // From this thread, only AlwaysQueue edges still need the packet.
+      const vector<const CompiledEdge*>& targetEdges =
+          isThisThread ? threadGroupRoute.alwaysQueueEdges
+                       : threadGroupRoute.edges;
+
+      if (targetEdges.empty()) {
+        continue;
       }
+
+      // Queue the previous one so the final thread group can take the packet
+      // without copying it.
+      if (lastQueuedThreadGroupRoute != nullptr) {
+        Packet copy = packetWithAccumulatedParameters;
+        queuePacket(
+            fromNode,
+            fromChannel,
+            *lastQueuedThreadGroupRoute,
+            routes,
+            lastQueuedTargetEdges,
+            move(copy));
+      }
+
+      lastQueuedThreadGroupRoute = &threadGroupRoute;
+      lastQueuedTargetEdges = &targetEdges;
     }
 
-    for (const auto& threadGroupPacketPair : asyncThreadGroupPacketPairs) {
-      const auto& threadGroup = threadGroupPacketPair.first;
-      const auto& packetWithAccumulatedParameters =
-          threadGroupPacketPair.second;
+    if (lastQueuedThreadGroupRoute != nullptr) {
+      queuePacket(
+          fromNode,
+          fromChannel,
+          *lastQueuedThreadGroupRoute,
+          routes,
+          lastQueuedTargetEdges,
+          move(packetWithAccumulatedParameters));
+    }
+  }
 
-      PushedPacketInfo info;
-      info.packet = packetWithAccumulatedParameters;
-      info.fromNode = fromNode;
-      info.channel = fromChannel;
-      info.queuedFromThreadId = thisThreadId;
+  void queuePacket(
+      const shared_ptr<GraphNode>& fromNode,
+      const string& fromChannel,
+      const ThreadGroupRoute& threadGroupRoute,
+      const shared_ptr<const NodeRoutes>& routes,
+      const vector<const CompiledEdge*>* targetEdges,
+      Packet&& packet) {
+    PushedPacketInfo info;
+    info.packet = move(packet);
+    info.routes = routes;
+    info.targetEdges = targetEdges;
+
+    ThreadGroup* const threadGroup = threadGroupRoute.threadGroup;
+    if (threadGroup->enqueue(info, threadGroupRoute.workerPool)) {
+      return;
+    }
 
-      threadGroup->mPacketQueue.enqueue(move(info));
-      uv_async_send(&threadGroup->mPacketReadyAsync);
+    // Packets rejected from the Overflow channel are dropped, so an overflow
+    // handler on a full ThreadGroup can't loop.
+    const bool routeToOverflowChannel =
+        threadGroup->mOverflowPolicy.load(memory_order_relaxed)
+            == QueueOverflowPolicy::RouteToOverflowChannel
+        && fromChannel != DataGraph::kChannel_Overflow;
+
+    if (routeToOverflowChannel) {
+      routePacket(fromNode, move(info.packet), DataGraph::kChannel_Overflow);
+    } else {
+      logd(
+          "Dropped packet from node '%s' channel '%s': ThreadGroup queue is "
+          "full.\n",
+          fromNode->name.c_str(),
+          fromChannel.c_str());
     }
   }
 
  private:
   const shared_ptr<DataGraphImpl> mImpl;
   const weak_ptr<GraphNode> mNode;
+  shared_ptr<const NodeRoutes> mRoutes;
 };
 
+shared_ptr<const NodeRoutes> DataGraphImpl::compileRoutes(
+    const shared_ptr<GraphNode>& node) {
+  const auto routes = make_shared<NodeRoutes>();
+
+  // Read before compiling, so a concurrent change forces another compile.
+  routes->generation = getRoutesGeneration();
+
+  for (const auto& channelEdgesPair : node->forwardEdges) {
+    const vector<GraphEdge>& graphEdges = channelEdgesPair.second;
+    if (graphEdges.empty()) {
+      continue;
+    }
+
+    ChannelRoute route;
+    route.channel = channelEdgesPair.first;
+
+    for (const GraphEdge& graphEdge : graphEdges) {
+      const auto nextInstance = getInstanceForGraphNode(graphEdge.next);
+      const auto threadGroup =
+          getOrCreateThreadGroup(nextInstance->getThreadGroupName());
+
+      CompiledEdge edge;
+      edge.node = graphEdge.next;
+      edge.implementation = nextInstance->getImplementation();
+      edge.pathable = edge.implementation != nullptr
+                          ? edge.implementation->asPathable()
+                          : nullptr;
+      edge.threadGroup = threadGroup.get();
+      edge.deliveryType = graphEdge.sameThreadQueueToTargetType;
+
+      if (edge.pathable != nullptr && edge.pathable->isStateless()) {
+        edge.workerPool = threadGroup->mWorkerPool.get();
+      }
+
+      route.edges.push_back(move(edge));
+    }
+
+    // route.edges doesn't change from here on, so it's safe to point into it.
+    for (const CompiledEdge& edge : route.edges) {
+      auto threadGroupRouteIt = find_if(
+          route.threadGroups.begin(),
+          route.threadGroups.end(),
+          [&edge](const ThreadGroupRoute& threadGroupRoute) {
+            return threadGroupRoute.threadGroup == edge.threadGroup
+                   && threadGroupRoute.workerPool == edge.workerPool;
+          });
+
+      if (threadGroupRouteIt == route.threadGroups.end()) {
+        route.threadGroups.emplace_back();
+        threadGroupRouteIt = prev(route.threadGroups.end());
+        threadGroupRouteIt->threadGroup = edge.threadGroup;
+        threadGroupRouteIt->workerPool = edge.workerPool;
+      }
+
+      threadGroupRouteIt->edges.push_back(&edge);
+
+      if (edge.deliveryType == PacketDeliveryType::AlwaysQueue) {
+        threadGroupRouteIt->alwaysQueueEdges.push_back(&edge);
+      }
+    }
+
+    routes->channels.push_back(move(route));
+  }
+
+  return routes;
+}
+
 shared_ptr<ThreadGroup> DataGraphImpl::getOrCreateThreadGroup(
     const string& threadGroupName) {
   auto existingIt = mThreadGroups.find(threadGroupName);
@@ -238,13 +530,140 @@ shared_ptr<ThreadGroup> DataGraphImpl::getOrCreateThreadGroup(
   return threadGroup;
 }
 
+bool ThreadGroup::enqueue(PushedPacketInfo& info, WorkerPool* workerPool) {
+  if (!acquireQueueSlot()) {
+    return false;
+  }
+
+  if (workerPool != nullptr) {
+    workerPool->submit(move(info));
+  } else {
+    mPacketQueue.enqueue(move(info));
+    wakeUp();
+  }
+
+  return true;
+}
+
+void ThreadGroup::wakeUp() {
+  if (!mWakeupPending.exchange(true)) {
+    uv_async_send(&mPacketReadyAsync);
+  }
+}
+
+bool ThreadGroup::acquireQueueSlot() {
+  while (true) {
+    const size_t maxQueuedPackets =
+        mMaxQueuedPackets.load(memory_order_relaxed);
+
+    if (tryReserveQueueSlot(maxQueuedPackets)) {
+      return true;
+    }
+
+    switch (mOverflowPolicy.load(memory_order_relaxed)) {
+      case QueueOverflowPolicy::DropNewest:
+      case QueueOverflowPolicy::RouteToOverflowChannel:
+        return false;
+
+      case QueueOverflowPolicy::DropOldest: {
+        // The queue is only FIFO per producer, so this is the oldest packet
+        // from some producer, not necessarily the oldest overall.
+        PushedPacketInfo droppedInfo;
+        if (mPacketQueue.try_dequeue(droppedInfo)) {
+          logd("Dropped oldest queued packet: ThreadGroup queue is full.\n");
+
+          // The new packet takes the dropped packet's slot.
+          return true;
+        }
+
+        /*
+         * Nothing to drop: either packetReady() emptied the queue in the
+         * meantime, or the slots are held by packets on the worker pool,
+         * which can't be dropped. In the first case there's room now.
+         * Otherwise the new packet is dropped, as with DropNewest, instead
+         * of waiting for the workers.
+         */
+        return tryReserveQueueSlot(
+            mMaxQueuedPackets.load(memory_order_relaxed));
+      }
+
+      case QueueOverflowPolicy::BlockProducer: {
+        // The loop thread (or a worker) would be waiting on itself.
+        const bool isOwnThread =
+            this_thread::get_id() == mUvLoopThreadId
+            || (mWorkerPool != nullptr && mWorkerPool->isWorkerThread());
+
+        if (isOwnThread) {
+          mQueuedPacketCount++;
+          return true;
+        }
+
+        if (mDataGraphImpl.expired()) {
+          return false;
+        }
+
+        mBlockedProducerCount++;
+
+        {
+          unique_lock<mutex> lock(mQueueSpaceMutex);
+
+          // Timed, so a producer notices when the graph goes away.
+          mQueueSpaceAvailable.wait_for(lock, chrono::milliseconds(100), [&] {
+            const size_t currentMax = mMaxQueuedPackets.load();
+            return currentMax == 0 || mQueuedPacketCount.load() < currentMax;
+          });
+        }
+
+        mBlockedProducerCount--;
+        break;
+      }
+
+      default:
+        throw runtime_error(
+            "Unknown queue overflow policy: "
+            + to_string(static_cast<uint32_t>(mOverflowPolicy.load())));
+    }
+  }
+}
+
+bool ThreadGroup::tryReserveQueueSlot(size_t maxQueuedPackets) {
+  if (maxQueuedPackets == 0) {
+    mQueuedPacketCount++;
+    return true;
+  }
+
+  size_t queuedPacketCount = mQueuedPacketCount.load();
+  do {
+    if (queuedPacketCount >= maxQueuedPackets) {
+      return false;
+    }
+  } while (!mQueuedPacketCount.compare_exchange_weak(
+      queuedPacketCount,
+      queuedPacketCount + 1));
+
+  return true;
+}
+
+void ThreadGroup::releaseQueueSlots(size_t count) {
+  mQueuedPacketCount -= count;
+
+  if (mBlockedProducerCount.load() > 0) {
+    // Locking orders this with a producer which is checking for space.
+    lock_guard<mutex> lock(mQueueSpaceMutex);
+    mQueueSpaceAvailable.notify_all();
+  }
+}
+
 ThreadGroup::ThreadGroup(
     const shared_ptr<UvLoopRunner>& uvLoopRunner,
     const shared_ptr<DataGraphImpl>& dataGraphImpl)
     : mUvLoopRunner(uvLoopRunner),
       mSubgraphContext(
           make_shared<SubgraphContext>(dataGraphImpl, uvLoopRunner->getLoop())),
-      mDataGraphImpl(dataGraphImpl) {
+      mDataGraphImpl(dataGraphImpl),
+      mPacketQueueConsumerToken(mPacketQueue),
+      mDequeuedPackets(kMaxDequeueBatchSize),
+      mDequeueBatchSize(kMinDequeueBatchSize) {
   memset(&mPacketReadyAsync, 0, sizeof(mPacketReadyAsync));
   int status = uv_async_init(
       mUvLoopRunner->getLoop().get(),
@@ -272,56 +691,52 @@ void ThreadGroup::packetReady() {
     return;
   }
 
-  static constexpr size_t kMaxDequeueAtOnce = 100;
-  PushedPacketInfo pushedPackets[kMaxDequeueAtOnce];
-  size_t processedPacketCount = 0;
-  const thread::id thisThreadId = this_thread::get_id();
+  /*
+   * Cleared before draining, so a packet enqueued from here on either gets
+   * dequeued below or sends another wakeup.
+   */
+  mWakeupPending = false;
+
+  const uint64_t startTimeNs = uv_hrtime();
 
   while (true) {
-    const size_t dequeuedPacketCount =
-        mPacketQueue.try_dequeue_bulk(pushedPackets, kMaxDequeueAtOnce);
+    const size_t dequeuedPacketCount = mPacketQueue.try_dequeue_bulk(
+        mPacketQueueConsumerToken,
+        mDequeuedPackets.begin(),
+        mDequeueBatchSize);
 
     if (dequeuedPacketCount == 0) {
       break;
     }
 
-    processedPacketCount += dequeuedPacketCount;
+    releaseQueueSlots(dequeuedPacketCount);
 
     for (size_t i = 0; i < dequeuedPacketCount; i++) {
-      PushedPacketInfo& packetInfo = pushedPackets[i];
-
-      if (packetInfo.fromNode) {
-        for (const auto& nextChannelInfo : packetInfo.fromNode->forwardEdges) {
-          const string& channel = nextChannelInfo.first;
-          const vector<GraphEdge>& channelEdges = nextChannelInfo.second;
-
-          for (const GraphEdge& nextEdge : channelEdges) {
-            const auto nextNode = nextEdge.next;
-            const auto nextInstance = impl->getInstanceForGraphNode(nextNode);
-            const auto sendOnThreadGroup = impl->getOrCreateThreadGroup(
-                nextInstance->getThreadGroupName());
-            const bool edgeUsesThisThread =
-                thisThreadId == sendOnThreadGroup->mUvLoopThreadId;
-
-            if (!edgeUsesThisThread) {
-              continue;
-            }
-
-            const bool queuedFromThisThread =
-                thisThreadId == packetInfo.queuedFromThreadId;
-            const bool thisEdgeUsesQueuedPackets =
-                !queuedFromThisThread
-                || nextEdge.sameThreadQueueToTargetType
-                       == PacketDeliveryType::AlwaysQueue;
-
-            if (thisEdgeUsesQueuedPackets && channel == packetInfo.channel) {
-              sendPacketToNode(nextNode, packetInfo.packet);
-            }
-          }
+      PushedPacketInfo& packetInfo = mDequeuedPackets[i];
+
+      if (packetInfo.targetEdges != nullptr) {
+        for (const CompiledEdge* edge : *packetInfo.targetEdges) {
+          deliverPacket(*edge, packetInfo.packet);
         }
       } else if (packetInfo.manualSendToNode) {
         sendPacketToNode(packetInfo.manualSendToNode, packetInfo.packet);
       }
+
+      // Releases the packet's buffers and routes now rather than when this
+      // slot is reused.
+      packetInfo = PushedPacketInfo();
+    }
+
+    if (dequeuedPacketCount == mDequeueBatchSize) {
+      mDequeueBatchSize = min(mDequeueBatchSize * 2, kMaxDequeueBatchSize);
+    } else {
+      mDequeueBatchSize = max(mDequeueBatchSize / 2, kMinDequeueBatchSize);
+    }
+
+    // Lets the loop run its other handles, and comes back for the rest.
+    if (uv_hrtime() - startTimeNs >= kPacketReadyTimeBudgetNs) {
+      wakeUp();
+      break;
     }
   }
 }
@@ -335,7 +750,7 @@ void ThreadGroup::sendPacketToNode(
     return;
   }
 
-  receivingNode->lastReceivedParameters = make_shared<json>(packet.parameters);
+  receivingNode->lastReceivedParameters = packet.parameters;
 
   const auto receivingInstance =
       dataGraphImpl->getInstanceForGraphNode(receivingNode);
@@ -358,6 +773,52 @@ void ThreadGroup::sendPacketToNode(
   pathable->handlePacket(PathablePacket(packet, receivingNode->packetPusher));
 }
 
+void ThreadGroup::deliverPacket(const CompiledEdge& edge, const Packet& packet) {
+  if (edge.pathable == nullptr) {
+    throw runtime_error(
+        "Type or Implementation has not been set for Instance '"
+        + edge.node->instanceName + "'.");
+  }
+
+  if (edge.workerPool == nullptr) {
+    edge.node->lastReceivedParameters = packet.parameters;
+    edge.pathable->handlePacket(
+        PathablePacket(packet, edge.node->packetPusher));
+    return;
+  }
+
+  WorkerDeliveryScope deliveryScope(edge.node.get(), &packet.parameters);
+  edge.pathable->handlePacket(PathablePacket(packet, edge.node->packetPusher));
+}
+
+void ThreadGroup::deliverPacketOnWorker(PushedPacketInfo& packetInfo) {
+  releaseQueueSlots(1);
+
+  for (const CompiledEdge* edge : *packetInfo.targetEdges) {
+    deliverPacket(*edge, packetInfo.packet);
+  }
+}
+
+void ThreadGroup::setWorkerCount(size_t workerCount) {
+  if (mWorkerPool != nullptr) {
+    if (mWorkerPool->getWorkerCount() == workerCount) {
+      return;
+    }
+
+    throw runtime_error(
+        "ThreadGroup already has "
+        + to_string(mWorkerPool->getWorkerCount())
+        + " worker threads. It can't be changed to "
+        + to_string(workerCount) + ".");
+  }
+
+  mWorkerPool = make_unique<WorkerPool>(
+      workerCount,
+      [this](PushedPacketInfo& packetInfo) {
+        deliverPacketOnWorker(packetInfo);
+      });
+}
+
 DataGraph::DataGraph(const Factories& factories)
     : impl(new DataGraphImpl(factories)) {}
 
@@ -422,6 +883,7 @@ void DataGraph::connect(
   auto& edge = impl->mGraph.connect(fromNodeName, fromChannel, toNodeName);
 
   edge.sameThreadQueueToTargetType = sameThreadQueueToTargetType;
+  impl->invalidateRoutes();
 }
 
 void DataGraph::disconnect(
@@ -435,6 +897,7 @@ void DataGraph::disconnect(
       fromChannel.c_str());
 
   impl->mGraph.disconnect(fromNodeName, fromChannel, toNodeName);
+  impl->invalidateRoutes();
 }
 
 void DataGraph::sendPacket(const Packet& packet, const string& toNodeName) {
@@ -443,14 +906,16 @@ void DataGraph::sendPacket(const Packet& packet, const string& toNodeName) {
   PushedPacketInfo packetInfo;
   packetInfo.packet = packet;
   packetInfo.manualSendToNode = toNode;
-  packetInfo.queuedFromThreadId = this_thread::get_id();
 
   const auto instance = impl->getInstanceForGraphNode(toNode);
   const auto sendToThreadGroup =
       impl->getOrCreateThreadGroup(instance->getThreadGroupName());
 
-  sendToThreadGroup->mPacketQueue.enqueue(move(packetInfo));
-  uv_async_send(&sendToThreadGroup->mPacketReadyAsync);
+  if (!sendToThreadGroup->enqueue(packetInfo)) {
+    logd(
+        "Dropped packet sent to node '%s': ThreadGroup queue is full.\n",
+        toNodeName.c_str());
+  }
 }
 
 void DataGraphImpl::logDroppedPacket(
@@ -477,6 +942,26 @@ void DataGraph::setThreadGroupForInstance(
   impl->setThreadGroupForInstance(instanceName, threadGroupName);
 }
 
+void DataGraph::setThreadGroupWorkerCount(
+    const string& threadGroupName,
+    size_t workerCount) {
+  impl->getOrCreateThreadGroup(threadGroupName)->setWorkerCount(workerCount);
+  impl->invalidateRoutes();
+}
+
+void DataGraph::setThreadGroupQueueLimit(
+    const string& threadGroupName,
+    size_t maxQueuedPackets,
+    QueueOverflowPolicy overflowPolicy) {
+  const auto threadGroup = impl->getOrCreateThreadGroup(threadGroupName);
+
+  threadGroup->mOverflowPolicy = overflowPolicy;
+  threadGroup->mMaxQueuedPackets = maxQueuedPackets;
+
+  // Blocked producers re-check against the new limit.
+  threadGroup->releaseQueueSlots(0);
+}
+
 void DataGraphImpl::setThreadGroupForInstance(
     const string& instanceName,
     const string& threadGroupName) {
@@ -484,6 +969,7 @@ void DataGraphImpl::setThreadGroupForInstance(
   const auto threadGroup = getOrCreateThreadGroup(threadGroupName);
   instance->setThreadGroupName(threadGroupName);
   instance->setSubgraphContext(threadGroup->mSubgraphContext);
+  invalidateRoutes();
 }
 
 void DataGraphImpl::validateInstanceImplementation(
@@ -546,6 +1032,7 @@ void DataGraph::setNodeInstance(
   const shared_ptr<GraphNode> node = impl->mGraph.getNodeOrThrow(nodeName);
 
   node->instanceName = instanceName;
+  impl->invalidateRoutes();
 }
 
 void DataGraph::setInstanceInitParameters(
@@ -596,6 +1083,7 @@ void DataGraph::setInstanceType(
 
   impl->validateInstanceImplementation(instanceName, instance);
   impl->mInstances[instanceName] = instance;
+  impl->invalidateRoutes();
 }
 
 void DataGraph::setInstanceImplementation(
@@ -603,6 +1091,7 @@ void DataGraph::setInstanceImplementation(
     const std::shared_ptr<IImplementation>& implementation) {
   const shared_ptr<Instance> instance = impl->getOrCreateInstance(instanceName);
   instance->setImplementation(implementation);
+  impl->invalidateRoutes();
 }
 
 void DataGraph::setInstanceImplementationToGroupInterface(
@@ -640,6 +1129,7 @@ void DataGraph::setInstanceImplementationToGroupInterface(
 
   const shared_ptr<Instance> instance = impl->getOrCreateInstance(instanceName);
   instance->setImplementation(groupInterfaceNode);
+  impl->invalidateRoutes();
 }
 
 shared_ptr<Instance> DataGraphImpl::getOrCreateInstance(
@@ -801,6 +1291,16 @@ void DataGraph::startGraph() {
 
     instance->setPacketPusherForISources(node->packetPusher);
   });
+
+  // Compile routing tables up front so the first packets don't pay for it.
+  impl->mGraph.visitNodes([this](const shared_ptr<GraphNode>& node) {
+    const auto packetPusher =
+        dynamic_pointer_cast<GraphPacketPusher>(node->packetPusher);
+
+    if (packetPusher != nullptr) {
+      packetPusher->getRoutes(node);
+    }
+  });
 }
 
 }  // namespace maplang
@@ -19,6 +19,7 @@
 #include <future>
 
 #include "maplang/BufferFactory.h"
+#include "maplang/BufferPool.h"
 #include "maplang/Factories.h"
 #include "maplang/ImplementationFactory.h"
 #include "maplang/ImplementationFactoryBuilder.h"
@@ -45,7 +46,8 @@ FactoriesBuilder& FactoriesBuilder::WithImplementationFactoryBuilder(
 
 Factories FactoriesBuilder::BuildFactories() const {
   const shared_ptr<const IBufferFactory> bufferFactory =
-      mBufferFactory ? *mBufferFactory : make_shared<BufferFactory>();
+      mBufferFactory ? *mBufferFactory
+                     : make_shared<BufferPool>(make_shared<BufferFactory>());
 
   const shared_ptr<IImplementationFactoryBuilder> implementationFactoryBuilder =
       mImplementationFactoryBuilder
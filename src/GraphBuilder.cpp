@@ -362,6 +362,72 @@ static nlohmann::json getObjectOrThrow(
   return value;
 }
 
+/*
+ * "threadGroup" is either the ThreadGroup's name, or an object like
+ * { "name": "Workers", "workerThreads": 4, "maxQueuedPackets": 1000,
+ *   "overflowPolicy": "Drop Oldest" }
+ */
+static void implementThreadGroup(
+    const shared_ptr<DataGraph>& dataGraph,
+    const string& instanceName,
+    const nlohmann::json& threadGroup) {
+  const string containingKey = instanceName + ".threadGroup";
+
+  if (threadGroup.is_string()) {
+    dataGraph->setThreadGroupForInstance(
+        instanceName,
+        threadGroup.get<string>());
+    return;
+  } else if (!threadGroup.is_object()) {
+    THROW("'threadGroup' must be a string or an object in '"
+          << instanceName << "'. Actual type: " << threadGroup.type_name());
+  }
+
+  const nlohmann::json& name = getJson(threadGroup, containingKey, "name");
+  if (!name.is_string()) {
+    THROW("'name' must be a string in '" << containingKey
+                                          << "'. Actual type: "
+                                          << name.type_name());
+  }
+
+  const string threadGroupName = name.get<string>();
+  dataGraph->setThreadGroupForInstance(instanceName, threadGroupName);
+
+  if (threadGroup.contains("workerThreads")) {
+    const nlohmann::json& workerThreads = threadGroup["workerThreads"];
+    if (!workerThreads.is_number_unsigned() || workerThreads == 0) {
+      THROW("'workerThreads' must be a positive integer in '"
+            << containingKey << "'. Actual value: " << workerThreads);
+    }
+
+    dataGraph->setThreadGroupWorkerCount(
+        threadGroupName,
+        workerThreads.get<size_t>());
+  }
+
+  if (!threadGroup.contains("maxQueuedPackets")) {
+    return;
+  }
+
+  const nlohmann::json& maxQueuedPackets =
+      getJson(threadGroup, containingKey, "maxQueuedPackets");
+  if (!maxQueuedPackets.is_number_unsigned()) {
+    THROW("'maxQueuedPackets' must be a non-negative integer in '"
+          << containingKey << "'. Actual type: "
+          << maxQueuedPackets.type_name());
+  }
+
+  const QueueOverflowPolicy overflowPolicy =
+      threadGroup.contains("overflowPolicy")
+          ? threadGroup["overflowPolicy"].get<QueueOverflowPolicy>()
+          : QueueOverflowPolicy::BlockProducer;
+
+  dataGraph->setThreadGroupQueueLimit(
+      threadGroupName,
+      maxQueuedPackets.get<size_t>(),
+      overflowPolicy);
+}
+
 void implementDataGraph(
     const shared_ptr<DataGraph>& dataGraph,
     const string& implementationJson) {
@@ -392,6 +458,14 @@ void implementDataGraph(
           instanceImplementation["initParameters"]);
     }
 
+    // Set the ThreadGroup, and optionally limit its queue
+    if (instanceImplementation.contains("threadGroup")) {
+      implementThreadGroup(
+          dataGraph,
+          instanceName,
+          instanceImplementation["threadGroup"]);
+    }
+
     // Set Implementation
     if (!instanceImplementation.contains("type")
         && !instanceImplementation.contains("implementationFromGroup")) {
@@ -0,0 +1,187 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "HttpChunkedDecoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+namespace maplang {
+
+static int hexDigitValue(uint8_t c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  } else if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  } else if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+
+  return -1;
+}
+
+HttpChunkedDecoder::HttpChunkedDecoder() { reset(); }
+
+void HttpChunkedDecoder::reset() {
+  mState = State::Size;
+  mChunkSize = 0;
+  mChunkSizeDigitCount = 0;
+  mLineLength = 0;
+  mTrailersLength = 0;
+}
+
+size_t HttpChunkedDecoder::decode(const Buffer& buffer, Buffer* data) {
+  const uint8_t* const bytes = buffer.data.get();
+  const size_t length = buffer.length;
+
+  *data = Buffer();
+
+  size_t i = 0;
+  while (i < length && mState != State::Complete) {
+    const uint8_t c = bytes[i];
+
+    switch (mState) {
+      case State::Size: {
+        const int digitValue = hexDigitValue(c);
+        if (digitValue >= 0) {
+          if (mChunkSize > (UINT64_MAX >> 4)) {
+            throw runtime_error("Chunk size is too large.");
+          }
+
+          mChunkSize = (mChunkSize << 4) | digitValue;
+          mChunkSizeDigitCount++;
+          mLineLength++;
+          i++;
+          break;
+        } else if (mChunkSizeDigitCount == 0) {
+          throw runtime_error("Chunk size is missing.");
+        }
+
+        mState = c == '\r' ? State::SizeLineEnd : State::Extension;
+        if (mState == State::Extension && c != ';' && c != ' ' && c != '\t') {
+          throw runtime_error("Invalid chunk size.");
+        }
+
+        i++;
+        break;
+      }
+
+      case State::Extension:
+      case State::Trailer: {
+        const void* const lineEnd = memchr(bytes + i, '\r', length - i);
+        const size_t lineLength =
+            lineEnd != nullptr
+                ? static_cast<const uint8_t*>(lineEnd) - (bytes + i)
+                : length - i;
+
+        mLineLength += lineLength;
+        if (mState == State::Trailer) {
+          mTrailersLength += lineLength;
+        }
+
+        if (mLineLength > kMaxChunkLineLength
+            || mTrailersLength > kMaxTrailersLength) {
+          throw runtime_error("Chunk line is too long.");
+        }
+
+        i += lineLength;
+        if (lineEnd != nullptr) {
+          mState = mState == State::Extension ? State::SizeLineEnd
+                                              : State::TrailerLineEnd;
+          i++;
+        }
+
+        break;
+      }
+
+      case State::SizeLineEnd:
+        expectByte(
+            c,
+            '\n',
+            mChunkSize > 0 ? State::Data : State::TrailerLineStart);
+        mLineLength = 0;
+        i++;
+        break;
+
+      case State::Data: {
+        const size_t dataLength =
+            static_cast<size_t>(min<uint64_t>(mChunkSize, length - i));
+
+        *data = buffer.slice(i, dataLength);
+        mChunkSize -= dataLength;
+        i += dataLength;
+
+        if (mChunkSize == 0) {
+          mState = State::DataCr;
+        }
+
+        return i;
+      }
+
+      case State::DataCr:
+        expectByte(c, '\r', State::DataLineEnd);
+        i++;
+        break;
+
+      case State::DataLineEnd:
+        expectByte(c, '\n', State::Size);
+        mChunkSizeDigitCount = 0;
+        i++;
+        break;
+
+      case State::TrailerLineStart:
+        mLineLength = 0;
+        if (c == '\r') {
+          mState = State::LastLineEnd;
+          i++;
+        } else {
+          mState = State::Trailer;
+        }
+        break;
+
+      case State::TrailerLineEnd:
+        expectByte(c, '\n', State::TrailerLineStart);
+        i++;
+        break;
+
+      case State::LastLineEnd:
+        expectByte(c, '\n', State::Complete);
+        i++;
+        break;
+
+      case State::Complete:
+        break;
+    }
+  }
+
+  return i;
+}
+
+void HttpChunkedDecoder::expectByte(
+    uint8_t actual,
+    uint8_t expected,
+    State nextState) {
+  if (actual != expected) {
+    throw runtime_error("Malformed chunked body.");
+  }
+
+  mState = nextState;
+}
+
+}  // namespace maplang
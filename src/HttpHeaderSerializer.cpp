@@ -0,0 +1,143 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "HttpHeaderSerializer.h"
+
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "maplang/HttpUtilities.h"
+
+using namespace std;
+
+namespace maplang {
+
+static constexpr string_view kCrLf = "\r\n";
+static constexpr string_view kHeaderSeparator = ": ";
+static constexpr string_view kContentLengthPrefix = "content-length: ";
+static constexpr string_view kStatusLinePrefix = "HTTP/1.1 ";
+static constexpr string_view kRequestLineSuffix = " HTTP/1.1\r\n";
+
+static constexpr uint64_t kMinStatusCode = 100;
+static constexpr uint64_t kMaxStatusCode = 599;
+
+// Enough parts for a start line and 8 headers without reallocating.
+static constexpr size_t kInitialPartCapacity = 40;
+
+static const vector<string>& getDefaultStatusLines() {
+  static const vector<string> statusLines = [] {
+    vector<string> lines;
+    for (uint64_t statusCode = kMinStatusCode; statusCode <= kMaxStatusCode;
+         statusCode++) {
+      lines.push_back(
+          string(kStatusLinePrefix) + to_string(statusCode) + " "
+          + http::getDefaultReasonForHttpStatus(statusCode) + string(kCrLf));
+    }
+
+    return lines;
+  }();
+
+  return statusLines;
+}
+
+HttpHeaderSerializer::HttpHeaderSerializer()
+    : mLength(0), mNumbersLength(0) {
+  mParts.reserve(kInitialPartCapacity);
+}
+
+void HttpHeaderSerializer::addStatusLine(uint64_t statusCode) {
+  if (statusCode < kMinStatusCode || statusCode > kMaxStatusCode) {
+    throw runtime_error("Invalid HTTP status " + to_string(statusCode) + ".");
+  }
+
+  add(getDefaultStatusLines()[statusCode - kMinStatusCode]);
+}
+
+void HttpHeaderSerializer::addStatusLine(
+    uint64_t statusCode,
+    string_view reason) {
+  add(kStatusLinePrefix);
+  add(formatNumber(statusCode, 10));
+  add(" ");
+  add(reason);
+  add(kCrLf);
+}
+
+void HttpHeaderSerializer::addRequestLine(
+    string_view method,
+    string_view path) {
+  add(method);
+  add(" ");
+  add(path);
+  add(kRequestLineSuffix);
+}
+
+void HttpHeaderSerializer::addHeader(string_view name, string_view value) {
+  add(name);
+  add(kHeaderSeparator);
+  add(value);
+  add(kCrLf);
+}
+
+void HttpHeaderSerializer::addContentLength(size_t contentLength) {
+  add(kContentLengthPrefix);
+  add(formatNumber(contentLength, 10));
+  add(kCrLf);
+}
+
+void HttpHeaderSerializer::endHeaders() { add(kCrLf); }
+
+void HttpHeaderSerializer::addChunkSize(size_t chunkSize) {
+  add(formatNumber(chunkSize, 16));
+  add(kCrLf);
+}
+
+void HttpHeaderSerializer::addLineEnd() { add(kCrLf); }
+
+Buffer HttpHeaderSerializer::serialize(
+    const IBufferFactory& bufferFactory) const {
+  Buffer buffer = bufferFactory.Create(mLength);
+
+  uint8_t* out = buffer.data.get();
+  for (const string_view& part : mParts) {
+    memcpy(out, part.data(), part.size());
+    out += part.size();
+  }
+
+  return buffer;
+}
+
+void HttpHeaderSerializer::add(string_view part) {
+  mParts.push_back(part);
+  mLength += part.size();
+}
+
+string_view HttpHeaderSerializer::formatNumber(uint64_t number, int base) {
+  char* const start = mNumbers.data() + mNumbersLength;
+  const auto result =
+      to_chars(start, mNumbers.data() + mNumbers.size(), number, base);
+  if (result.ec != errc()) {
+    throw runtime_error("Too many numbers in HTTP headers.");
+  }
+
+  mNumbersLength = result.ptr - mNumbers.data();
+
+  return string_view(start, result.ptr - start);
+}
+
+}  // namespace maplang
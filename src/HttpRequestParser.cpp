@@ -0,0 +1,337 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "HttpRequestParser.h"
+
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+
+#include "maplang/HttpUtilities.h"
+
+using namespace std;
+using namespace nlohmann;
+
+namespace maplang {
+
+static bool isWhitespace(uint8_t c) { return c == ' ' || c == '\t'; }
+
+// ASCII only, so bytes over 0x7f are left as they are.
+static char toLowerAscii(uint8_t c) {
+  return static_cast<char>(c >= 'A' && c <= 'Z' ? c | 0x20 : c);
+}
+
+HttpRequestParser::HttpRequestParser() { reset(); }
+
+void HttpRequestParser::reset() {
+  mState = State::LeadingLineEnd;
+  mParsedLength = 0;
+  mBuffers.clear();
+  mMethod = Slice();
+  mPath = Slice();
+  mVersion = Slice();
+  mHeader = Header();
+  mHeaders.clear();
+  mContentLength = kNoContentLength;
+  mHasTransferEncoding = false;
+  mIsChunked = false;
+}
+
+size_t HttpRequestParser::parse(const Buffer& buffer) {
+  const uint8_t* const data = buffer.data.get();
+  const size_t length = buffer.length;
+  const size_t bufferOffset = mParsedLength;
+
+  // Added first, so byteAt() can read it. Trimmed to the parsed bytes below.
+  mBuffers.push_back(buffer);
+
+  size_t i = 0;
+  while (i < length && mState != State::Complete) {
+    const uint8_t c = data[i];
+    const size_t offset = bufferOffset + i;
+
+    switch (mState) {
+      case State::LeadingLineEnd:
+        // Ignores line ends before the request line, like the ones a client
+        // can send after a body.
+        if (c != '\r' && c != '\n') {
+          mMethod.offset = offset;
+          mState = State::Method;
+          continue;
+        }
+        break;
+
+      case State::Method:
+        if (c == ' ') {
+          mMethod.length = offset - mMethod.offset;
+          mPath.offset = offset + 1;
+          mState = State::Path;
+        } else if (c == '\r' || c == '\n') {
+          throw runtime_error("Invalid HTTP request line.");
+        }
+        break;
+
+      case State::Path:
+        if (c == ' ') {
+          mPath.length = offset - mPath.offset;
+          mVersion.offset = offset + 1;
+          mState = State::Version;
+        } else if (c == '\r' || c == '\n') {
+          throw runtime_error("Invalid HTTP request line.");
+        }
+        break;
+
+      case State::Version:
+        if (c == '\r') {
+          mVersion.length = offset - mVersion.offset;
+          mState = State::RequestLineEnd;
+        }
+        break;
+
+      case State::RequestLineEnd:
+      case State::HeaderLineEnd:
+        if (c != '\n') {
+          throw runtime_error("Expected LF after CR in HTTP request.");
+        }
+
+        mState = State::HeaderLineStart;
+        break;
+
+      case State::HeaderLineStart:
+        if (c == '\r') {
+          mState = State::HeadersEnd;
+          break;
+        }
+
+        mHeader = Header();
+        mHeader.name.offset = offset;
+        mState = State::HeaderName;
+        continue;
+
+      case State::HeaderName:
+        if (c == ':') {
+          mHeader.name.length = offset - mHeader.name.offset;
+          mState = State::HeaderValueStart;
+        } else if (c == '\r' || c == '\n') {
+          throw runtime_error("HTTP header line without a ':'.");
+        } else if (isWhitespace(c)) {
+          // Rejected (RFC 9112 section 5.1), because a proxy in front of this
+          // could read "Content-Length : 5" as a different header.
+          throw runtime_error("Whitespace in an HTTP header name.");
+        }
+        break;
+
+      case State::HeaderValueStart:
+        if (!isWhitespace(c)) {
+          mHeader.value.offset = offset;
+          mState = State::HeaderValue;
+          continue;
+        }
+        break;
+
+      case State::HeaderValue: {
+        const auto lineEnd = reinterpret_cast<const uint8_t*>(
+            memchr(data + i, '\r', length - i));
+        if (lineEnd == nullptr) {
+          i = length;
+          continue;
+        }
+
+        i = lineEnd - data;
+        mHeader.value.length = bufferOffset + i - mHeader.value.offset;
+        mHeader.value = trimTrailingWhitespace(mHeader.value);
+        onHeaderParsed();
+        mState = State::HeaderLineEnd;
+        break;
+      }
+
+      case State::HeadersEnd:
+        if (c != '\n') {
+          throw runtime_error("Expected LF after CR in HTTP request.");
+        }
+
+        mState = State::Complete;
+        break;
+
+      case State::Complete:
+        break;
+    }
+
+    i++;
+  }
+
+  if (bufferOffset + i > kMaxHeaderBlockLength) {
+    throw runtime_error("HTTP request headers are too long.");
+  }
+
+  if (i == 0) {
+    mBuffers.pop_back();
+  } else if (i < length) {
+    mBuffers.back() = buffer.slice(0, i);
+  }
+
+  mParsedLength += i;
+
+  return i;
+}
+
+void HttpRequestParser::onHeaderParsed() {
+  if (equalsIgnoringCase(
+          mHeader.name,
+          http::kHttpHeaderNormalized_ContentLength)) {
+    const string value = toString(mHeader.value);
+    uint64_t contentLength = 0;
+    const auto result =
+        from_chars(value.data(), value.data() + value.size(), contentLength);
+    if (value.empty() || result.ec != errc()
+        || result.ptr != value.data() + value.size()) {
+      throw runtime_error("Invalid Content-Length '" + value + "'.");
+    } else if (
+        mContentLength != kNoContentLength && mContentLength != contentLength) {
+      throw runtime_error("Conflicting Content-Length headers.");
+    }
+
+    mContentLength = contentLength;
+  } else if (equalsIgnoringCase(
+                 mHeader.name,
+                 http::kHttpHeaderNormalized_TransferEncoding)) {
+    mHasTransferEncoding = true;
+    mIsChunked = http::isChunkedTransferEncoding(toString(mHeader.value));
+  }
+
+  /*
+   * A request with both could be delimited either way, so requests smuggled
+   * in its body would be seen by this or by a proxy in front of it, but not
+   * both (RFC 9112 section 6.3).
+   */
+  if (mHasTransferEncoding && mContentLength != kNoContentLength) {
+    throw runtime_error(
+        "HTTP request has both Content-Length and Transfer-Encoding.");
+  }
+
+  mHeaders.push_back(mHeader);
+}
+
+json HttpRequestParser::createParameters(
+    const unordered_set<string>* includedHeaders) const {
+  json parameters;
+  parameters[http::kParameter_HttpMethod] = toString(mMethod);
+  parameters[http::kParameter_HttpPath] = toString(mPath);
+  parameters[http::kParameter_HttpVersion] = toString(mVersion);
+
+  json headers = json::object();
+  string name;
+  for (const Header& header : mHeaders) {
+    name.clear();
+    appendSlice(header.name, true, &name);
+
+    if (includedHeaders != nullptr
+        && includedHeaders->find(name) == includedHeaders->end()) {
+      continue;
+    }
+
+    headers[name] = toString(header.value);
+  }
+
+  parameters[http::kParameter_HttpHeaders] = move(headers);
+
+  return parameters;
+}
+
+uint8_t HttpRequestParser::byteAt(size_t offset) const {
+  for (const Buffer& buffer : mBuffers) {
+    if (offset < buffer.length) {
+      return buffer.data.get()[offset];
+    }
+
+    offset -= buffer.length;
+  }
+
+  throw out_of_range("Offset is past the parsed HTTP request.");
+}
+
+HttpRequestParser::Slice HttpRequestParser::trimTrailingWhitespace(
+    Slice slice) const {
+  while (slice.length > 0
+         && isWhitespace(byteAt(slice.offset + slice.length - 1))) {
+    slice.length--;
+  }
+
+  return slice;
+}
+
+bool HttpRequestParser::equalsIgnoringCase(
+    const Slice& slice,
+    string_view lowerCase) const {
+  if (slice.length != lowerCase.length()) {
+    return false;
+  }
+
+  for (size_t i = 0; i < slice.length; i++) {
+    if (toLowerAscii(byteAt(slice.offset + i)) != lowerCase[i]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/*
+ * Most slices are in one buffer. Slices which span buffers are copied a
+ * buffer at a time.
+ */
+void HttpRequestParser::appendSlice(
+    const Slice& slice,
+    bool toLowerCase,
+    string* out) const {
+  size_t offset = slice.offset;
+  size_t remaining = slice.length;
+
+  for (const Buffer& buffer : mBuffers) {
+    if (remaining == 0) {
+      break;
+    } else if (offset >= buffer.length) {
+      offset -= buffer.length;
+      continue;
+    }
+
+    const char* const start =
+        reinterpret_cast<const char*>(buffer.data.get()) + offset;
+    const size_t copyLength = min(remaining, buffer.length - offset);
+
+    if (toLowerCase) {
+      for (size_t i = 0; i < copyLength; i++) {
+        out->push_back(toLowerAscii(static_cast<uint8_t>(start[i])));
+      }
+    } else {
+      out->append(start, copyLength);
+    }
+
+    offset = 0;
+    remaining -= copyLength;
+  }
+}
+
+string HttpRequestParser::toString(const Slice& slice, bool toLowerCase)
+    const {
+  string str;
+  str.reserve(slice.length);
+  appendSlice(slice, toLowerCase, &str);
+
+  return str;
+}
+
+}  // namespace maplang
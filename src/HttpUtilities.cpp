@@ -16,6 +16,8 @@
 
 #include "maplang/HttpUtilities.h"
 
+#include <cctype>
+
 using namespace std;
 
 namespace maplang {
@@ -25,12 +27,16 @@ const string kParameter_HttpVersion = "httpVersion";
 const string kParameter_HttpPath = "httpPath";
 const string kParameter_HttpMethod = "httpMethod";
 const string kParameter_HttpRequestId = "httpRequestId";
+const string kParameter_HttpRequestIndex = "httpRequestIndex";
 const string kParameter_HttpHeaders = "httpHeaders";
 const string kParameter_HttpStatusCode = "httpStatusCode";
 const string kParameter_HttpStatusReason = "httpStatusReason";
+const string kParameter_HttpChunk = "httpChunk";
 
 const string kHttpHeaderNormalized_ContentLength = "content-length";
 const string kHttpHeaderNormalized_ContentType = "content-type";
+const string kHttpHeaderNormalized_TransferEncoding = "transfer-encoding";
+const string kHttpHeaderNormalized_Date = "date";
 
 const int kHttpStatus_Continue = 100;
 const int kHttpStatus_Ok = 200;
@@ -49,5 +55,36 @@ string getDefaultReasonForHttpStatus(int status) {
   }
 }
 
+static bool isSpace(char c) { return c == ' ' || c == '\t'; }
+
+bool isChunkedTransferEncoding(const string& transferEncoding) {
+  static const string kChunked = "chunked";
+
+  size_t end = transferEncoding.size();
+  while (end > 0 && isSpace(transferEncoding[end - 1])) {
+    end--;
+  }
+
+  if (end < kChunked.size()) {
+    return false;
+  }
+
+  const size_t start = end - kChunked.size();
+  for (size_t i = 0; i < kChunked.size(); i++) {
+    if (tolower(static_cast<unsigned char>(transferEncoding[start + i]))
+        != kChunked[i]) {
+      return false;
+    }
+  }
+
+  // "chunked" must be a whole coding, not the end of another one.
+  size_t previous = start;
+  while (previous > 0 && isSpace(transferEncoding[previous - 1])) {
+    previous--;
+  }
+
+  return previous == 0 || transferEncoding[previous - 1] == ',';
+}
+
 }  // namespace http
 }  // namespace maplang
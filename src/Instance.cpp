@@ -40,6 +40,10 @@ void Instance::setType(const string& typeName) {
       typeName,
       mInitParameters);
 
+  if (mSubgraphContext != nullptr) {
+    mImplementation->setSubgraphContext(mSubgraphContext);
+  }
+
   const auto source = mImplementation->asSource();
   const auto packetPusherForISources = mPacketPusherForISources.lock();
   if (source != nullptr && packetPusherForISources != nullptr) {
@@ -0,0 +1,172 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "maplang/ParameterSchema.h"
+
+#include <stdexcept>
+
+using namespace std;
+using json = nlohmann::json;
+
+namespace maplang {
+
+static string unescapeJsonPointerToken(const string& token) {
+  string unescaped;
+  unescaped.reserve(token.length());
+
+  for (size_t i = 0; i < token.length(); i++) {
+    if (token[i] == '~' && i + 1 < token.length()) {
+      if (token[i + 1] == '0') {
+        unescaped.push_back('~');
+        i++;
+        continue;
+      } else if (token[i + 1] == '1') {
+        unescaped.push_back('/');
+        i++;
+        continue;
+      }
+    }
+
+    unescaped.push_back(token[i]);
+  }
+
+  return unescaped;
+}
+
+static bool hasType(const json& value, ParameterSchema::Type type) {
+  switch (type) {
+    case ParameterSchema::Type::Any:
+      return true;
+    case ParameterSchema::Type::String:
+      return value.is_string();
+    case ParameterSchema::Type::Number:
+      return value.is_number();
+    case ParameterSchema::Type::Boolean:
+      return value.is_boolean();
+    case ParameterSchema::Type::Object:
+      return value.is_object();
+    case ParameterSchema::Type::Array:
+      return value.is_array();
+  }
+
+  return false;
+}
+
+static string getTypeName(ParameterSchema::Type type) {
+  switch (type) {
+    case ParameterSchema::Type::Any:
+      return "any type";
+    case ParameterSchema::Type::String:
+      return "a string";
+    case ParameterSchema::Type::Number:
+      return "a number";
+    case ParameterSchema::Type::Boolean:
+      return "a boolean";
+    case ParameterSchema::Type::Object:
+      return "an object";
+    case ParameterSchema::Type::Array:
+      return "an array";
+  }
+
+  return "unknown";
+}
+
+ParameterSlot ParameterSchema::declare(
+    const string& key,
+    Type type,
+    Presence presence) {
+  if (mEntries.size() >= kMaxSlots) {
+    throw runtime_error(
+        "Cannot declare parameter '" + key + "'. A ParameterSchema holds at "
+        + "most " + to_string(kMaxSlots) + " parameters.");
+  }
+
+  Entry entry;
+  entry.key = key;
+  entry.type = type;
+  entry.presence = presence;
+
+  if (!key.empty() && key[0] == '/') {
+    // Look up the first token through the Parameters' inherited layers, and
+    // the rest of the pointer in the value found there.
+    const size_t secondSlash = key.find('/', 1);
+    entry.firstToken = unescapeJsonPointerToken(key.substr(1, secondSlash - 1));
+
+    if (secondSlash != string::npos) {
+      entry.remainingPointer = json::json_pointer(key.substr(secondSlash));
+    }
+  } else {
+    entry.firstToken = key;
+  }
+
+  mEntries.push_back(move(entry));
+
+  return ParameterSlot {mEntries.size() - 1};
+}
+
+ResolvedParameters ParameterSchema::resolve(
+    const Parameters& parameters) const {
+  ResolvedParameters resolved(this);
+
+  for (size_t i = 0; i < mEntries.size(); i++) {
+    const Entry& entry = mEntries[i];
+    const json* value = parameters.findValue(entry.firstToken);
+
+    if (value != nullptr && entry.remainingPointer) {
+      value = value->contains(*entry.remainingPointer)
+                  ? &(*value)[*entry.remainingPointer]
+                  : nullptr;
+    }
+
+    if (value == nullptr) {
+      if (entry.presence == Presence::Required) {
+        throw runtime_error("Missing parameter '" + entry.key + "'.");
+      }
+
+      continue;
+    }
+
+    if (!hasType(*value, entry.type)) {
+      throw runtime_error(
+          "Parameter '" + entry.key + "' must be " + getTypeName(entry.type)
+          + ".");
+    }
+
+    resolved.mValues[i] = value;
+  }
+
+  return resolved;
+}
+
+const string& ParameterSchema::getKey(ParameterSlot slot) const {
+  return mEntries.at(slot.index).key;
+}
+
+string_view ResolvedParameters::getString(ParameterSlot slot) const {
+  const json* const value = get(slot);
+
+  if (value == nullptr) {
+    throw runtime_error(
+        "Missing parameter '" + mSchema->getKey(slot) + "'.");
+  } else if (!value->is_string()) {
+    throw runtime_error(
+        "Parameter '" + mSchema->getKey(slot) + "' must be a string.");
+  }
+
+  return value->get_ref<const string&>();
+}
+
+}  // namespace maplang
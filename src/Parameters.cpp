@@ -0,0 +1,191 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "maplang/Parameters.h"
+
+using namespace std;
+using json = nlohmann::json;
+
+namespace maplang {
+
+/*
+ * Inheritance chains are flattened once they get this long, so lookups stay
+ * cheap and loops in a graph can't grow a chain forever.
+ */
+static constexpr size_t kMaxInheritanceDepth = 16;
+
+static const json kNullJson;
+
+struct Parameters::Layer {
+  // Values set on this layer. Not modified once the layer is shared.
+  json values;
+
+  // Values for keys which are not in |values|.
+  shared_ptr<const Layer> inherited;
+  size_t depth = 1;
+
+  // |values| merged with all inherited values. Created on first use.
+  mutable shared_ptr<const json> flattened;
+};
+
+Parameters::Parameters(const json& value) {
+  if (!value.is_null()) {
+    mLayer = make_shared<Layer>();
+    mLayer->values = value;
+  }
+}
+
+Parameters::Parameters(json&& value) {
+  if (!value.is_null()) {
+    mLayer = make_shared<Layer>();
+    mLayer->values = move(value);
+  }
+}
+
+Parameters::Parameters(json::initializer_list_t init)
+    : mLayer(make_shared<Layer>()) {
+  mLayer->values = json(init);
+}
+
+bool Parameters::isNull() const {
+  return mLayer == nullptr
+         || (mLayer->inherited == nullptr && mLayer->values.is_null());
+}
+
+const json& Parameters::asJson() const {
+  if (mLayer == nullptr) {
+    return kNullJson;
+  } else if (mLayer->inherited == nullptr) {
+    return mLayer->values;
+  }
+
+  auto flattened = atomic_load(&mLayer->flattened);
+  if (flattened != nullptr) {
+    return *flattened;
+  }
+
+  flattened = make_shared<json>(
+      mLayer->values.is_null() ? json::object() : mLayer->values);
+  auto& merged = const_cast<json&>(*flattened);
+
+  for (const Layer* layer = mLayer->inherited.get(); layer != nullptr;
+       layer = layer->inherited.get()) {
+    const auto alreadyFlattened = atomic_load(&layer->flattened);
+    const json& values =
+        alreadyFlattened != nullptr ? *alreadyFlattened : layer->values;
+
+    if (values.is_object()) {
+      // insert() does not overwrite values
+      merged.insert(values.begin(), values.end());
+    }
+
+    if (alreadyFlattened != nullptr) {
+      break;
+    }
+  }
+
+  // Another thread may have flattened this layer at the same time. Keep
+  // whichever was stored first, so references returned earlier stay valid.
+  shared_ptr<const json> expected;
+  if (!atomic_compare_exchange_strong(
+          &mLayer->flattened,
+          &expected,
+          flattened)) {
+    return *expected;
+  }
+
+  return *flattened;
+}
+
+json& Parameters::asMutableJson() {
+  if (mLayer == nullptr) {
+    mLayer = make_shared<Layer>();
+  } else if (mLayer->inherited != nullptr || mLayer.use_count() > 1) {
+    // Other copies may be reading the shared value on other threads.
+    const auto detached = make_shared<Layer>();
+    detached->values = asJson();
+    mLayer = detached;
+  }
+
+  return mLayer->values;
+}
+
+void Parameters::inheritFrom(const Parameters& parent) {
+  if (parent.mLayer == nullptr || sharesValueWith(parent)) {
+    return;
+  } else if (mLayer == nullptr) {
+    mLayer = parent.mLayer;
+    return;
+  } else if (!mLayer->values.is_object() && !mLayer->values.is_null()) {
+    return;
+  }
+
+  if (mLayer->inherited != nullptr || mLayer.use_count() > 1) {
+    asMutableJson();
+  }
+
+  shared_ptr<const Layer> inherited = parent.mLayer;
+  if (inherited->depth >= kMaxInheritanceDepth) {
+    const auto flattenedParent = make_shared<Layer>();
+    flattenedParent->values = parent.asJson();
+    inherited = flattenedParent;
+  }
+
+  mLayer->inherited = inherited;
+  mLayer->depth = inherited->depth + 1;
+}
+
+void Parameters::flatten() {
+  if (mLayer != nullptr && mLayer->inherited != nullptr) {
+    asMutableJson();
+  }
+}
+
+// Only looks at the layer's own values, not inherited ones.
+static const json* findLayerValue(const json& values, string_view key) {
+  if (!values.is_object()) {
+    return nullptr;
+  }
+
+  const auto& object = values.get_ref<const json::object_t&>();
+  const auto it = object.find(key);
+  return it != object.end() ? &it->second : nullptr;
+}
+
+const json* Parameters::findValue(string_view key) const {
+  for (const Layer* layer = mLayer.get(); layer != nullptr;
+       layer = layer->inherited.get()) {
+    const json* const value = findLayerValue(layer->values, key);
+    if (value != nullptr) {
+      return value;
+    }
+  }
+
+  return nullptr;
+}
+
+const json& Parameters::operator[](string_view key) const {
+  if (mLayer != nullptr && !mLayer->values.is_object()
+      && !mLayer->values.is_null()) {
+    // Throws the same type error json does.
+    return mLayer->values[string(key)];
+  }
+
+  const json* const value = findValue(key);
+  return value != nullptr ? *value : kNullJson;
+}
+
+}  // namespace maplang
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "maplang/QueueOverflowPolicy.h"
+
+#include <string>
+
+using namespace std;
+
+namespace maplang {
+
+void to_json(nlohmann::json& j, const QueueOverflowPolicy& policy) {
+  switch (policy) {
+    case QueueOverflowPolicy::BlockProducer:
+      j = "Block Producer";
+      break;
+
+    case QueueOverflowPolicy::DropNewest:
+      j = "Drop Newest";
+      break;
+
+    case QueueOverflowPolicy::DropOldest:
+      j = "Drop Oldest";
+      break;
+
+    case QueueOverflowPolicy::RouteToOverflowChannel:
+      j = "Route To Overflow Channel";
+      break;
+
+    default:
+      throw invalid_argument(
+          "Unknown queue overflow policy: "
+          + to_string(static_cast<uint32_t>(policy)));
+  }
+}
+
+void from_json(const nlohmann::json& j, QueueOverflowPolicy& policy) {
+  const string str = j.get<string>();
+
+  if (str == "Block Producer") {
+    policy = QueueOverflowPolicy::BlockProducer;
+  } else if (str == "Drop Newest") {
+    policy = QueueOverflowPolicy::DropNewest;
+  } else if (str == "Drop Oldest") {
+    policy = QueueOverflowPolicy::DropOldest;
+  } else if (str == "Route To Overflow Channel") {
+    policy = QueueOverflowPolicy::RouteToOverflowChannel;
+  } else {
+    throw invalid_argument("Unknown QueueOverflowPolicy '" + str + "'.");
+  }
+}
+
+}  // namespace maplang
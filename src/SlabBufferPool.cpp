@@ -0,0 +1,212 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "maplang/SlabBufferPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+#include "maplang/concurrentqueue.h"
+
+using namespace std;
+
+namespace maplang {
+
+const vector<size_t> SlabBufferPool::kDefaultSizeClasses =
+    {4 * 1024, 16 * 1024, 64 * 1024};
+
+/*
+ * Slabs are at least this large, so small size classes don't allocate a slab
+ * per buffer.
+ */
+static constexpr size_t kMinSlabSize = 256 * 1024;
+
+class SlabBufferPool::Impl final {
+ public:
+  struct SizeClass final {
+    size_t bufferSize;
+    size_t slotStride;
+    size_t slotsPerSlab;
+
+    // Only used on the owning thread.
+    vector<SlotHeader*> freeSlots;
+
+    moodycamel::ConcurrentQueue<SlotHeader*> remotelyFreedSlots;
+  };
+
+  struct SlabDeleter final {
+    void operator()(uint8_t* slab) const {
+      ::operator delete[](slab, align_val_t(alignof(SlotHeader)));
+    }
+  };
+
+  explicit Impl(const vector<size_t>& sizeClasses) {
+    if (sizeClasses.empty()) {
+      throw runtime_error("A SlabBufferPool needs at least one size class.");
+    }
+
+    vector<size_t> sortedSizeClasses = sizeClasses;
+    sort(sortedSizeClasses.begin(), sortedSizeClasses.end());
+
+    for (const size_t bufferSize : sortedSizeClasses) {
+      if (bufferSize == 0) {
+        throw runtime_error("SlabBufferPool size classes cannot be empty.");
+      }
+
+      auto sizeClass = make_unique<SizeClass>();
+      sizeClass->bufferSize = bufferSize;
+
+      // Keeps each slot's header aligned.
+      const size_t alignment = alignof(SlotHeader);
+      sizeClass->slotStride = sizeof(SlotHeader)
+                              + (bufferSize + alignment - 1) / alignment
+                                    * alignment;
+      sizeClass->slotsPerSlab =
+          max<size_t>(1, kMinSlabSize / sizeClass->slotStride);
+
+      mSizeClasses.push_back(move(sizeClass));
+    }
+  }
+
+  uint8_t* allocate(size_t suggestedSize, size_t* allocatedSize) {
+    if (mOwnerThread == thread::id()) {
+      mOwnerThread = this_thread::get_id();
+    }
+
+    size_t sizeClassIndex = 0;
+    while (sizeClassIndex + 1 < mSizeClasses.size()
+           && mSizeClasses[sizeClassIndex]->bufferSize < suggestedSize) {
+      sizeClassIndex++;
+    }
+
+    SizeClass& sizeClass = *mSizeClasses[sizeClassIndex];
+    if (sizeClass.freeSlots.empty()) {
+      reclaimRemotelyFreedSlots(&sizeClass);
+    }
+
+    if (sizeClass.freeSlots.empty()) {
+      addSlab(&sizeClass, sizeClassIndex);
+    }
+
+    SlotHeader* const slot = sizeClass.freeSlots.back();
+    sizeClass.freeSlots.pop_back();
+
+    mReferences.fetch_add(1, memory_order_relaxed);
+
+    *allocatedSize = sizeClass.bufferSize;
+    return reinterpret_cast<uint8_t*>(slot) + sizeof(SlotHeader);
+  }
+
+  void releaseSlot(SlotHeader* slot) {
+    SizeClass& sizeClass = *mSizeClasses[slot->sizeClassIndex];
+
+    if (this_thread::get_id() == mOwnerThread) {
+      sizeClass.freeSlots.push_back(slot);
+    } else {
+      sizeClass.remotelyFreedSlots.enqueue(slot);
+    }
+
+    release();
+  }
+
+  // The pool and each allocated buffer hold a reference.
+  void release() {
+    if (mReferences.fetch_sub(1, memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+ private:
+  void reclaimRemotelyFreedSlots(SizeClass* sizeClass) {
+    SlotHeader* slots[64];
+    size_t count;
+    while ((count = sizeClass->remotelyFreedSlots.try_dequeue_bulk(
+                slots,
+                size(slots)))
+           > 0) {
+      sizeClass->freeSlots.insert(
+          sizeClass->freeSlots.end(),
+          slots,
+          slots + count);
+    }
+  }
+
+  void addSlab(SizeClass* sizeClass, size_t sizeClassIndex) {
+    const size_t slabSize = sizeClass->slotStride * sizeClass->slotsPerSlab;
+    auto slab = unique_ptr<uint8_t[], SlabDeleter>(
+        new (align_val_t(alignof(SlotHeader))) uint8_t[slabSize]);
+
+    for (size_t i = 0; i < sizeClass->slotsPerSlab; i++) {
+      auto slot =
+          reinterpret_cast<SlotHeader*>(slab.get() + i * sizeClass->slotStride);
+      new (&slot->bufferHeader) BufferHeader {nullptr, {0}, false};
+      slot->impl = this;
+      slot->sizeClassIndex = sizeClassIndex;
+
+      sizeClass->freeSlots.push_back(slot);
+    }
+
+    mSlabs.push_back(move(slab));
+  }
+
+ private:
+  vector<unique_ptr<SizeClass>> mSizeClasses;
+  vector<unique_ptr<uint8_t[], SlabDeleter>> mSlabs;
+  thread::id mOwnerThread;
+  atomic<size_t> mReferences {1};
+};
+
+SlabBufferPool::SlabBufferPool(const vector<size_t>& sizeClasses)
+    : mImpl(new Impl(sizeClasses)) {}
+
+SlabBufferPool::~SlabBufferPool() { mImpl->release(); }
+
+BufferPtr SlabBufferPool::share(uint8_t* data) {
+  SlotHeader* const slot = getSlot(data);
+  slot->onRelease = nullptr;
+
+  return shareSlot(slot, data);
+}
+
+BufferPtr SlabBufferPool::shareSlot(SlotHeader* slot, uint8_t* data) {
+  BufferHeader& bufferHeader = slot->bufferHeader;
+  bufferHeader.release = &SlabBufferPool::releaseSlot;
+  bufferHeader.references.store(1, memory_order_relaxed);
+  bufferHeader.threadConfined = false;
+
+  return BufferPtr::adopt(&bufferHeader, data);
+}
+
+uint8_t* SlabBufferPool::allocate(
+    size_t suggestedSize,
+    size_t* allocatedSize) {
+  return mImpl->allocate(suggestedSize, allocatedSize);
+}
+
+void SlabBufferPool::releaseSlot(BufferHeader* bufferHeader) {
+  auto slot = reinterpret_cast<SlotHeader*>(bufferHeader);
+  if (slot->onRelease != nullptr) {
+    slot->onRelease(slot);
+  }
+
+  slot->impl->releaseSlot(slot);
+}
+
+}  // namespace maplang
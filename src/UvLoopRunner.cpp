@@ -34,7 +34,9 @@ static shared_ptr<uv_loop_t> createUvLoop() {
           return;
         }
 
-        uv_stop(loop);
+        // Handles closed after the loop stopped finish closing here, so
+        // their close callbacks can free them.
+        uv_run(loop, UV_RUN_NOWAIT);
         uv_loop_close(loop);
         free(loop);
       });
@@ -59,8 +61,6 @@ static shared_ptr<uv_loop_t> createUvLoop() {
   return uvLoop;
 }
 
-static void onAsync(uv_async_t* async) {}
-
 UvLoopRunner::UvLoopRunner() {
   bool started = false;
   condition_variable startedCv;
@@ -74,6 +74,7 @@ UvLoopRunner::UvLoopRunner() {
       mUvLoop = createUvLoop();
 
       int status = uv_async_init(mUvLoop.get(), &mUvAsync, onAsync);
+      mUvAsync.data = this;
       if (status != 0) {
         static constexpr size_t kErrorMessageBufLen = 128;
         char errorMessage[kErrorMessageBufLen];
@@ -110,10 +111,44 @@ UvLoopRunner::UvLoopRunner() {
 UvLoopRunner::~UvLoopRunner() {
   drain();
   uv_close(reinterpret_cast<uv_handle_t*>(&mUvAsync), nullptr);
+
+  // Once the loop has stopped, nothing else runs it. mUvAsync finishes
+  // closing here, while it still exists, along with other handles closed
+  // since the loop stopped.
+  lock_guard<mutex> lock(mMutex);
+  if (mStopped) {
+    uv_run(mUvLoop.get(), UV_RUN_NOWAIT);
+  }
 }
 
 shared_ptr<uv_loop_t> UvLoopRunner::getLoop() const { return mUvLoop; }
 
+void UvLoopRunner::post(function<void()>&& task) {
+  {
+    lock_guard<mutex> lock(mTasksMutex);
+    mTasks.push_back(move(task));
+  }
+
+  uv_async_send(&mUvAsync);
+}
+
+void UvLoopRunner::onAsync(uv_async_t* async) {
+  auto runner = reinterpret_cast<UvLoopRunner*>(async->data);
+  runner->runTasks();
+}
+
+void UvLoopRunner::runTasks() {
+  vector<function<void()>> tasks;
+  {
+    lock_guard<mutex> lock(mTasksMutex);
+    tasks.swap(mTasks);
+  }
+
+  for (const auto& task : tasks) {
+    task();
+  }
+}
+
 void UvLoopRunner::drain() {
   uv_unref(reinterpret_cast<uv_handle_t*>(&mUvAsync));
 }
@@ -16,9 +16,23 @@
 
 #include "nodes/ContextualNode.h"
 
+#include <uv.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <functional>
+#include <future>
+#include <list>
+#include <optional>
 #include <sstream>
+#include <string_view>
 
+#include "FlatStringMap.h"
 #include "logging.h"
+#include "maplang/ParameterSchema.h"
+#include "maplang/UvLoopRunner.h"
+#include "maplang/concurrentqueue.h"
 
 using namespace std;
 using namespace nlohmann;
@@ -30,6 +44,99 @@ static const string kPartitionName_ContextRemover = "Context Remover";
 
 static const string kInitDataParameter_Key = "key";
 static const string kInitDataParameter_Type = "type";
+static const string kInitDataParameter_Shards = "shards";
+static const string kInitDataParameter_IdleTimeoutMs = "idleTimeoutMs";
+static const string kInitDataParameter_MaxInstances = "maxInstances";
+static const string kInitDataParameter_MaxPooledInstances =
+    "maxPooledInstances";
+
+static constexpr size_t kDefaultMaxPooledInstances = 64;
+
+static const string kChannel_ContextEvicted = "Context Evicted";
+
+// Idle instances are looked for at most this far apart.
+static constexpr uint64_t kMaxIdleCheckIntervalMs = 1000;
+
+using ContextLookupDigits = array<char, 24>;
+
+/*
+ * Context keys are strings or integers (e.g. a TcpConnectionId). Integers are
+ * looked up by their decimal string, which is written to |digits|. The
+ * returned lookup refers to |keyValue| or |digits|, so getting it doesn't
+ * allocate.
+ */
+static string_view getContextLookup(
+    const json& keyValue,
+    const string& keyName,
+    ContextLookupDigits* digits) {
+  if (keyValue.is_string()) {
+    return keyValue.get_ref<const string&>();
+  }
+
+  to_chars_result result;
+  if (keyValue.is_number_unsigned()) {
+    result = to_chars(
+        digits->data(),
+        digits->data() + digits->size(),
+        keyValue.get<uint64_t>());
+  } else if (keyValue.is_number_integer()) {
+    result = to_chars(
+        digits->data(),
+        digits->data() + digits->size(),
+        keyValue.get<int64_t>());
+  } else {
+    throw runtime_error(
+        "Parameter '" + keyName + "' must be a string or an integer.");
+  }
+
+  return string_view(digits->data(), result.ptr - digits->data());
+}
+
+/*
+ * The parameter which holds the context key: a top-level key, or a JSON
+ * pointer if it starts with '/'. The router, the remover and evictions all
+ * read and write the key through this, so they agree on where it is.
+ */
+class ContextKeyParameter final {
+ public:
+  explicit ContextKeyParameter(const string& key)
+      : mKey(key),
+        mSlot(mSchema.declare(
+            key,
+            ParameterSchema::Type::Any,
+            ParameterSchema::Presence::Required)) {
+    if (!key.empty() && key[0] == '/') {
+      mPointer = json::json_pointer(key);
+    }
+  }
+
+  const string& getKey() const { return mKey; }
+
+  // Throws if the key is missing. The result points into |parameters|.
+  const json& get(const Parameters& parameters) const {
+    return *mSchema.resolve(parameters).get(mSlot);
+  }
+
+  // Sets the key in |parameters| where get() finds it.
+  void set(Parameters* parameters, const json& value) const {
+    if (mPointer) {
+      (*parameters)[*mPointer] = value;
+    } else {
+      (*parameters)[mKey] = value;
+    }
+  }
+
+ private:
+  const string mKey;
+  ParameterSchema mSchema;
+  const ParameterSlot mSlot;
+  optional<json::json_pointer> mPointer;
+};
+
+// Selects the shard, and is reused for the lookup in the shard's table.
+static size_t hashContextLookup(string_view contextLookup) {
+  return FlatStringMap<int>::hashKey(contextLookup);
+}
 
 class IContextRouter {
  public:
@@ -39,7 +146,14 @@ class IContextRouter {
   virtual void addNode(
       const string& contextLookup,
       const shared_ptr<IImplementation>& node) = 0;
-  virtual bool removeNode(const string& contextLookup) = 0;
+
+  /**
+   * Calls |onRemoved| if there was a node for |contextLookup|. It can be
+   * called later, on another thread.
+   */
+  virtual void removeNode(
+      const string& contextLookup,
+      function<void()>&& onRemoved) = 0;
 };
 
 class IRouterInstanceCreator {
@@ -55,6 +169,21 @@ class IRouterInstanceCreator {
 
 class SingleNodeRouter;
 
+/*
+ * When instances are evicted without a packet to the Context Remover, and how
+ * many removed IResettable instances are kept for reuse. Zero disables each
+ * limit.
+ */
+struct ContextNodeTableSettings final {
+  uint64_t idleTimeoutMs = 0;
+  size_t maxInstances = 0;
+  size_t maxPooledInstances = 0;
+
+  bool isEvictionEnabled() const {
+    return idleTimeoutMs > 0 || maxInstances > 0;
+  }
+};
+
 class ContextualNode::Impl
     : public IRouterInstanceCreator,
       public enable_shared_from_this<ContextualNode::Impl> {
@@ -69,6 +198,8 @@ class ContextualNode::Impl
   const json mInitParameters;
   const string mType;
   const string mKey;
+  const size_t mShardCount;
+  const ContextNodeTableSettings mTableSettings;
 
   const Factories mFactories;
   shared_ptr<IContextRouter> mContextRouter;
@@ -104,7 +235,8 @@ class CohesiveGroupRouter
   void addNode(
       const string& contextLookup,
       const shared_ptr<IImplementation>& node) override;
-  bool removeNode(const string& contextLookup) override;
+  void removeNode(const string& contextLookup, function<void()>&& onRemoved)
+      override;
   void createNewInstance(const string& forNewContextLookup) override;
 
   IPathable* asPathable() override { return nullptr; }
@@ -125,6 +257,485 @@ class CohesiveGroupRouter
   unordered_map<string, shared_ptr<IContextRouter>> mNodeRouters;
 };
 
+class LoopSubgraphContext final : public ISubgraphContext {
+ public:
+  explicit LoopSubgraphContext(const shared_ptr<uv_loop_t>& uvLoop)
+      : mUvLoop(uvLoop) {}
+
+  shared_ptr<uv_loop_t> getUvLoop() const override { return mUvLoop; }
+
+ private:
+  const shared_ptr<uv_loop_t> mUvLoop;
+};
+
+/*
+ * The instances of a SingleNodeRouter, or of one of its shards, by context
+ * lookup.
+ *
+ * With eviction enabled, instances are kept in least-recently-used order.
+ * Instances idle for longer than "idleTimeoutMs" are evicted by a timer on
+ * the table's loop, and the least recently used instances are evicted when
+ * there are more than "maxInstances". Each eviction sends a packet with the
+ * instance's key on the "Context Evicted" channel.
+ *
+ * Removed and evicted instances which are IResettable are reset and pooled,
+ * and new contexts take an instance from the pool before creating one.
+ *
+ * Only used on its loop's thread.
+ */
+class ContextNodeTable final
+    : public enable_shared_from_this<ContextNodeTable> {
+ public:
+  struct Entry final {
+    shared_ptr<IImplementation> node;
+
+    // Only set when eviction is enabled.
+    Parameters lastReceivedParameters;
+    shared_ptr<IPacketPusher> lastPacketPusher;
+    uint64_t lastActivityMs = 0;
+    list<string>::iterator leastRecentlyUsedPosition;
+  };
+
+  ContextNodeTable(
+      const string& key,
+      const ContextNodeTableSettings& tableSettings)
+      : mKeyParameter(key), mTableSettings(tableSettings) {}
+
+  void setUvLoop(const shared_ptr<uv_loop_t>& uvLoop) { mUvLoop = uvLoop; }
+
+  // The entry is valid until the next add() or remove().
+  Entry* find(string_view contextLookup, size_t contextHash) {
+    return mEntries.find(contextLookup, contextHash);
+  }
+
+  void add(
+      string_view contextLookup,
+      size_t contextHash,
+      const shared_ptr<IImplementation>& node) {
+    auto [entry, inserted] = mEntries.insert(contextLookup, contextHash);
+    entry->node = node;
+
+    if (inserted && mTableSettings.isEvictionEnabled()) {
+      mLeastRecentlyUsed.emplace_front(contextLookup);
+      entry->leastRecentlyUsedPosition = mLeastRecentlyUsed.begin();
+    }
+  }
+
+  // Returns false if there was no node for |contextLookup|.
+  bool remove(string_view contextLookup, size_t contextHash) {
+    Entry* const entry = mEntries.find(contextLookup, contextHash);
+    if (entry == nullptr) {
+      return false;
+    }
+
+    if (mTableSettings.isEvictionEnabled()) {
+      mLeastRecentlyUsed.erase(entry->leastRecentlyUsedPosition);
+    }
+
+    shared_ptr<IImplementation> node = move(entry->node);
+    mEntries.erase(contextLookup, contextHash);
+    recycle(move(node));
+
+    return true;
+  }
+
+  // Returns null if the pool is empty.
+  shared_ptr<IImplementation> takePooledInstance() {
+    if (mPooledInstances.empty()) {
+      return nullptr;
+    }
+
+    shared_ptr<IImplementation> node = move(mPooledInstances.back());
+    mPooledInstances.pop_back();
+
+    return node;
+  }
+
+  /*
+   * Called before delivering a packet to |entry|'s node. |entry| becomes the
+   * most recently used, so it is not evicted here, but it can move.
+   */
+  void recordActivity(
+      Entry* entry,
+      const Parameters& receivedParameters,
+      const shared_ptr<IPacketPusher>& packetPusher) {
+    if (!mTableSettings.isEvictionEnabled()) {
+      return;
+    }
+
+    entry->lastReceivedParameters = receivedParameters;
+    entry->lastPacketPusher = packetPusher;
+    // Without a loop (no subgraph context yet) there is no idle eviction to
+    // time, only the least recently used order.
+    entry->lastActivityMs = mUvLoop != nullptr ? uv_now(mUvLoop.get()) : 0;
+    mLeastRecentlyUsed.splice(
+        mLeastRecentlyUsed.begin(),
+        mLeastRecentlyUsed,
+        entry->leastRecentlyUsedPosition);
+
+    if (mTableSettings.maxInstances > 0) {
+      while (mEntries.size() > mTableSettings.maxInstances) {
+        evictLeastRecentlyUsed();
+      }
+    }
+
+    if (mTableSettings.idleTimeoutMs > 0 && !mIdleTimerStarted
+        && mUvLoop != nullptr) {
+      startIdleTimer();
+    }
+  }
+
+  // Called before the loop exits, so the timer isn't left on it.
+  void closeIdleTimer() {
+    if (mIdleTimer == nullptr) {
+      return;
+    }
+
+    uv_close(
+        reinterpret_cast<uv_handle_t*>(&mIdleTimer->handle),
+        [](uv_handle_t* closedHandle) {
+          delete reinterpret_cast<IdleTimer*>(closedHandle->data);
+        });
+    mIdleTimer = nullptr;
+  }
+
+  template <class Function>
+  void forEachNode(Function&& function) {
+    mEntries.forEach([&function](string_view, Entry& entry) {
+      function(entry.node);
+    });
+  }
+
+ private:
+  /*
+   * Owned by the loop. The table can go away on another thread, so the timer
+   * closes itself the next time it fires after that.
+   */
+  struct IdleTimer final {
+    uv_timer_t handle;
+    weak_ptr<ContextNodeTable> table;
+  };
+
+  void startIdleTimer() {
+    auto idleTimer = new IdleTimer();
+    idleTimer->table = weak_from_this();
+
+    const int status = uv_timer_init(mUvLoop.get(), &idleTimer->handle);
+    if (status != 0) {
+      delete idleTimer;
+      throw runtime_error(
+          "Failed to initialize idle timer: " + string(uv_strerror(status)));
+    }
+
+    idleTimer->handle.data = idleTimer;
+
+    const uint64_t checkIntervalMs = clamp<uint64_t>(
+        mTableSettings.idleTimeoutMs / 2,
+        1,
+        kMaxIdleCheckIntervalMs);
+    uv_timer_start(
+        &idleTimer->handle,
+        onIdleTimer,
+        checkIntervalMs,
+        checkIntervalMs);
+    uv_unref(reinterpret_cast<uv_handle_t*>(&idleTimer->handle));
+
+    mIdleTimer = idleTimer;
+    mIdleTimerStarted = true;
+
+    // Activity from before there was a loop counts from now.
+    const uint64_t nowMs = uv_now(mUvLoop.get());
+    mEntries.forEach([nowMs](string_view, Entry& entry) {
+      if (entry.lastActivityMs == 0) {
+        entry.lastActivityMs = nowMs;
+      }
+    });
+  }
+
+  static void onIdleTimer(uv_timer_t* handle) {
+    auto idleTimer = reinterpret_cast<IdleTimer*>(handle->data);
+    const auto table = idleTimer->table.lock();
+    if (table == nullptr) {
+      uv_close(
+          reinterpret_cast<uv_handle_t*>(handle),
+          [](uv_handle_t* closedHandle) {
+            delete reinterpret_cast<IdleTimer*>(closedHandle->data);
+          });
+      return;
+    }
+
+    table->evictIdleNodes();
+  }
+
+  void evictIdleNodes() {
+    if (mUvLoop == nullptr) {
+      return;
+    }
+
+    const uint64_t nowMs = uv_now(mUvLoop.get());
+
+    // Least recently used is also least recently active.
+    while (!mLeastRecentlyUsed.empty()) {
+      const string& oldestLookup = mLeastRecentlyUsed.back();
+      const Entry& oldest =
+          *mEntries.find(oldestLookup, hashContextLookup(oldestLookup));
+      if (nowMs - oldest.lastActivityMs < mTableSettings.idleTimeoutMs) {
+        break;
+      }
+
+      evictLeastRecentlyUsed();
+    }
+  }
+
+  void evictLeastRecentlyUsed() {
+    const string evictedLookup = move(mLeastRecentlyUsed.back());
+    const size_t evictedHash = hashContextLookup(evictedLookup);
+    Entry evicted = move(*mEntries.find(evictedLookup, evictedHash));
+
+    mLeastRecentlyUsed.pop_back();
+    mEntries.erase(evictedLookup, evictedHash);
+
+    if (evicted.lastPacketPusher != nullptr) {
+      Packet evictedPacket;
+      mKeyParameter.set(
+          &evictedPacket.parameters,
+          mKeyParameter.get(evicted.lastReceivedParameters));
+      evicted.lastPacketPusher->pushPacketInheritingFrom(
+          move(evictedPacket),
+          evicted.lastReceivedParameters,
+          kChannel_ContextEvicted);
+    }
+
+    recycle(move(evicted.node));
+  }
+
+  // Instances which can't be pooled are destroyed.
+  void recycle(shared_ptr<IImplementation>&& node) {
+    if (mPooledInstances.size() >= mTableSettings.maxPooledInstances) {
+      return;
+    }
+
+    IResettable* const resettable = node->asResettable();
+    if (resettable == nullptr) {
+      return;
+    }
+
+    resettable->reset();
+    mPooledInstances.push_back(move(node));
+  }
+
+ private:
+  const ContextKeyParameter mKeyParameter;
+  const ContextNodeTableSettings mTableSettings;
+  shared_ptr<uv_loop_t> mUvLoop;
+  bool mIdleTimerStarted = false;
+  IdleTimer* mIdleTimer = nullptr;
+
+  FlatStringMap<Entry> mEntries;
+  list<string> mLeastRecentlyUsed;  // Most recently used first.
+  vector<shared_ptr<IImplementation>> mPooledInstances;
+};
+
+/*
+ * The packet pusher of a shard's instances. The router's node receives the
+ * packets of every shard, so instances inherit the parameters of the packet
+ * their shard delivered last instead of the node's. Only used on the shard's
+ * thread.
+ */
+class ShardPacketPusher final : public IPacketPusher {
+ public:
+  void setDelivery(
+      const shared_ptr<IPacketPusher>& packetPusher,
+      const Parameters& receivedParameters) {
+    mWrappedPusher = packetPusher;
+    mReceivedParameters = receivedParameters;
+  }
+
+  void pushPacket(const Packet& packet, const string& channelName) override {
+    Packet copy = packet;
+    pushPacket(move(copy), channelName);
+  }
+
+  void pushPacket(Packet&& packet, const string& channelName) override {
+    if (mWrappedPusher == nullptr) {
+      return;
+    }
+
+    mWrappedPusher->pushPacketInheritingFrom(
+        move(packet),
+        mReceivedParameters,
+        channelName);
+  }
+
+ private:
+  shared_ptr<IPacketPusher> mWrappedPusher;
+  Parameters mReceivedParameters;
+};
+
+/*
+ * A packet or removal for a context on a shard.
+ */
+struct ContextShardCommand {
+  enum class Type {
+    HandlePacket,
+    RemoveNode,
+  };
+
+  Type type;
+  string contextLookup;
+  size_t contextHash;
+  Packet packet;
+  shared_ptr<IPacketPusher> packetPusher;
+  function<void()> onRemoved;
+};
+
+/*
+ * With "shards" set, a SingleNodeRouter spreads contexts over that many
+ * shards by the hash of their context lookup. A shard runs on its own loop,
+ * and creates, runs and removes the instances of its contexts there.
+ */
+class ContextShard final {
+ public:
+  ContextShard(
+      const Factories& factories,
+      const weak_ptr<IRouterInstanceCreator>& instanceCreator,
+      const string& key,
+      const ContextNodeTableSettings& tableSettings)
+      : mUvLoopRunner(factories.uvLoopRunnerFactory->createUvLoopRunner()),
+        mSubgraphContext(
+            make_shared<LoopSubgraphContext>(mUvLoopRunner->getLoop())),
+        mInstanceCreator(instanceCreator),
+        mPacketPusher(make_shared<ShardPacketPusher>()),
+        mNodes(make_shared<ContextNodeTable>(key, tableSettings)) {
+    mNodes->setUvLoop(mUvLoopRunner->getLoop());
+    memset(&mCommandAsync, 0, sizeof(mCommandAsync));
+
+    // Handles are initialized on the loop which runs them.
+    promise<void> started;
+    mUvLoopRunner->post([this, &started] {
+      const int status = uv_async_init(
+          mUvLoopRunner->getLoop().get(),
+          &mCommandAsync,
+          onCommandsWrapper);
+      if (status != 0) {
+        started.set_exception(make_exception_ptr(runtime_error(
+            "Failed to initialize async event: "
+            + string(uv_strerror(status)))));
+        return;
+      }
+
+      mCommandAsync.data = this;
+      uv_unref(reinterpret_cast<uv_handle_t*>(&mCommandAsync));
+      started.set_value();
+    });
+
+    started.get_future().get();
+  }
+
+  /*
+   * The shard's nodes and handles are closed on its loop, and this returns
+   * once the loop has exited. Called on any thread but the shard's.
+   */
+  ~ContextShard() {
+    mUvLoopRunner->post([this] {
+      uv_close(reinterpret_cast<uv_handle_t*>(&mCommandAsync), nullptr);
+      mNodes->closeIdleTimer();
+      mNodes.reset();
+      mUvLoopRunner->drain();
+    });
+
+    mUvLoopRunner->waitForExit();
+  }
+
+  // Called on any thread.
+  void post(ContextShardCommand&& command) {
+    mCommands.enqueue(move(command));
+    uv_async_send(&mCommandAsync);
+  }
+
+  // Called on the shard's thread, from createNewInstance().
+  void addNode(
+      const string& contextLookup,
+      const shared_ptr<IImplementation>& node) {
+    mNodes->add(contextLookup, hashContextLookup(contextLookup), node);
+
+    node->setSubgraphContext(mSubgraphContext);
+
+    auto source = node->asSource();
+    if (source) {
+      source->setPacketPusher(mPacketPusher);
+    }
+  }
+
+ private:
+  static void onCommandsWrapper(uv_async_t* handle) {
+    auto shard = reinterpret_cast<ContextShard*>(handle->data);
+    shard->onCommands();
+  }
+
+  void onCommands() {
+    ContextShardCommand command;
+    while (mCommands.try_dequeue(command)) {
+      switch (command.type) {
+        case ContextShardCommand::Type::HandlePacket:
+          handlePacket(command);
+          break;
+
+        case ContextShardCommand::Type::RemoveNode:
+          if (mNodes->remove(command.contextLookup, command.contextHash)) {
+            command.onRemoved();
+          }
+          break;
+      }
+    }
+  }
+
+  void handlePacket(const ContextShardCommand& command) {
+    ContextNodeTable::Entry* entry =
+        mNodes->find(command.contextLookup, command.contextHash);
+    if (entry == nullptr) {
+      const auto pooledInstance = mNodes->takePooledInstance();
+      if (pooledInstance != nullptr) {
+        addNode(command.contextLookup, pooledInstance);
+      } else {
+        const auto instanceCreator = mInstanceCreator.lock();
+        if (instanceCreator == nullptr) {
+          loge("Instance creator went away.\n");
+          return;
+        }
+
+        // Calls our addNode().
+        instanceCreator->createNewInstance(command.contextLookup);
+      }
+
+      entry = mNodes->find(command.contextLookup, command.contextHash);
+      if (entry == nullptr) {
+        return;
+      }
+    }
+
+    const auto node = entry->node;
+    mNodes->recordActivity(
+        entry,
+        command.packet.parameters,
+        command.packetPusher);
+
+    mPacketPusher->setDelivery(command.packetPusher, command.packet.parameters);
+    node->asPathable()->handlePacket(
+        PathablePacket(command.packet, mPacketPusher));
+  }
+
+ private:
+  const shared_ptr<UvLoopRunner> mUvLoopRunner;
+  const shared_ptr<ISubgraphContext> mSubgraphContext;
+  const weak_ptr<IRouterInstanceCreator> mInstanceCreator;
+  const shared_ptr<ShardPacketPusher> mPacketPusher;
+  uv_async_t mCommandAsync;
+  moodycamel::ConcurrentQueue<ContextShardCommand> mCommands;
+
+  shared_ptr<ContextNodeTable> mNodes;
+};
+
 class SingleNodeRouter : public IImplementation,
                          public ISource,
                          public IPathable,
@@ -135,11 +746,15 @@ class SingleNodeRouter : public IImplementation,
   SingleNodeRouter(
       const weak_ptr<IRouterInstanceCreator>& instanceCreator,
       const shared_ptr<IImplementation>& templateNode,
-      const string& key)
+      const string& key,
+      const ContextNodeTableSettings& tableSettings = {},
+      vector<unique_ptr<ContextShard>>&& shards = {})
       : mInstanceCreator(instanceCreator),
         mThisAsSource(templateNode->asSource() ? this : nullptr),
         mThisAsPathable(templateNode->asPathable() ? this : nullptr),
-        mKey(key) {}
+        mKeyParameter(key),
+        mNodes(make_shared<ContextNodeTable>(key, tableSettings)),
+        mShards(move(shards)) {}
 
   ~SingleNodeRouter() override = default;
 
@@ -148,8 +763,13 @@ class SingleNodeRouter : public IImplementation,
   void addNode(
       const string& contextLookup,
       const shared_ptr<IImplementation>& node) override {
-    mNodes[contextLookup] = node;
-    mReverseNodeLookup[node.get()] = contextLookup;
+    const size_t contextHash = hashContextLookup(contextLookup);
+    if (!mShards.empty()) {
+      getShard(contextHash)->addNode(contextLookup, node);
+      return;
+    }
+
+    mNodes->add(contextLookup, contextHash, node);
 
     node->setSubgraphContext(shared_from_this());
 
@@ -161,45 +781,82 @@ class SingleNodeRouter : public IImplementation,
 
   void handlePacket(const PathablePacket& incomingPathablePacket) override {
     const Packet& incomingPacket = incomingPathablePacket.packet;
-    const auto contextLookup = incomingPacket.parameters[mKey].get<string>();
-    shared_ptr<IImplementation> node;
-    auto it = mNodes.find(contextLookup);
-    if (it != mNodes.end()) {
-      node = it->second;
-    } else {
-      const auto instanceCreator = mInstanceCreator.lock();
-      if (instanceCreator == nullptr) {
-        loge("Instance creator went away.\n");
-        return;
+
+    // Hashed once, and finding an existing instance doesn't allocate.
+    const string_view contextLookup = getContextLookup(
+        mKeyParameter.get(incomingPacket.parameters),
+        mKeyParameter.getKey(),
+        &mContextLookupDigits);
+    const size_t contextHash = hashContextLookup(contextLookup);
+
+    if (!mShards.empty()) {
+      ContextShardCommand command;
+      command.type = ContextShardCommand::Type::HandlePacket;
+      command.contextLookup = contextLookup;
+      command.contextHash = contextHash;
+      command.packet = incomingPacket;
+      command.packetPusher = incomingPathablePacket.packetPusher;
+
+      getShard(contextHash)->post(move(command));
+      return;
+    }
+
+    ContextNodeTable::Entry* entry = mNodes->find(contextLookup, contextHash);
+    if (entry == nullptr) {
+      const string newContextLookup(contextLookup);
+      const auto pooledInstance = mNodes->takePooledInstance();
+      if (pooledInstance != nullptr) {
+        addNode(newContextLookup, pooledInstance);
+      } else {
+        const auto instanceCreator = mInstanceCreator.lock();
+        if (instanceCreator == nullptr) {
+          loge("Instance creator went away.\n");
+          return;
+        }
+
+        // calls our addInstance(). For groups, calls all group subnode's
+        // addInstance().
+        instanceCreator->createNewInstance(newContextLookup);
       }
 
-      // calls our addInstance(). For groups, calls all group subnode's
-      // addInstance().
-      instanceCreator->createNewInstance(contextLookup);
-      node = mNodes[contextLookup];
+      entry = mNodes->find(contextLookup, contextHash);
+      if (entry == nullptr) {
+        return;
+      }
     }
 
+    const auto node = entry->node;
+    mNodes->recordActivity(
+        entry,
+        incomingPacket.parameters,
+        incomingPathablePacket.packetPusher);
+
     node->asPathable()->handlePacket(incomingPathablePacket);
   }
 
   void setSubgraphContext(
       const shared_ptr<ISubgraphContext>& context) override {
     mOriginalSubgraphContext = context;
+    mNodes->setUvLoop(context != nullptr ? context->getUvLoop() : nullptr);
   }
 
-  bool removeNode(const string& contextLookup) override {
-    auto nodeIt = mNodes.find(contextLookup);
-    if (nodeIt == mNodes.end()) {
-      return false;
+  void removeNode(const string& contextLookup, function<void()>&& onRemoved)
+      override {
+    const size_t contextHash = hashContextLookup(contextLookup);
+    if (!mShards.empty()) {
+      ContextShardCommand command;
+      command.type = ContextShardCommand::Type::RemoveNode;
+      command.contextLookup = contextLookup;
+      command.contextHash = contextHash;
+      command.onRemoved = move(onRemoved);
+
+      getShard(contextHash)->post(move(command));
+      return;
     }
 
-    const auto node = nodeIt->second;
-    auto reverseLookupIt = mReverseNodeLookup.find(node.get());
-
-    mNodes.erase(nodeIt);
-    mReverseNodeLookup.erase(reverseLookupIt);
-
-    return true;
+    if (mNodes->remove(contextLookup, contextHash)) {
+      onRemoved();
+    }
   }
 
   shared_ptr<uv_loop_t> getUvLoop() const override {
@@ -212,24 +869,46 @@ class SingleNodeRouter : public IImplementation,
 
   void setPacketPusher(const shared_ptr<IPacketPusher>& pusher) override;
 
+ private:
+  ContextShard* getShard(size_t contextHash) const {
+    return mShards[contextHash % mShards.size()].get();
+  }
+
  private:
   const weak_ptr<IRouterInstanceCreator> mInstanceCreator;
   IPathable* const mThisAsPathable;
   ISource* const mThisAsSource;
-  const string mKey;
+  const ContextKeyParameter mKeyParameter;
+  ContextLookupDigits mContextLookupDigits;
 
   shared_ptr<ISubgraphContext> mOriginalSubgraphContext;
   shared_ptr<IPacketPusher> mPacketPusher;
 
-  unordered_map<string, shared_ptr<IImplementation>> mNodes;
-  unordered_map<IImplementation*, string> mReverseNodeLookup;
+  const shared_ptr<ContextNodeTable> mNodes;
+
+  // Empty unless the ContextualNode has "shards". Shards own their nodes.
+  vector<unique_ptr<ContextShard>> mShards;
 };
 
 static shared_ptr<IContextRouter> createContextRouter(
     const weak_ptr<IRouterInstanceCreator>& subinstanceCreator,
     const shared_ptr<IImplementation>& templateNode,
-    const string& key) {
+    const string& key,
+    const Factories& factories,
+    size_t shardCount,
+    const ContextNodeTableSettings& tableSettings) {
   if (templateNode->asGroup() != nullptr) {
+    if (shardCount > 0) {
+      throw runtime_error(
+          "'" + kInitDataParameter_Shards
+          + "' is not supported when the contextual type is a group.");
+    } else if (tableSettings.isEvictionEnabled()) {
+      throw runtime_error(
+          "'" + kInitDataParameter_IdleTimeoutMs + "' and '"
+          + kInitDataParameter_MaxInstances
+          + "' are not supported when the contextual type is a group.");
+    }
+
     auto templateGroup = templateNode->asGroup();
     auto router = make_shared<CohesiveGroupRouter>(
         subinstanceCreator,
@@ -239,7 +918,30 @@ static shared_ptr<IContextRouter> createContextRouter(
 
     return router;
   } else {
-    return make_shared<SingleNodeRouter>(subinstanceCreator, templateNode, key);
+    // Each shard gets an equal part of the instance limits.
+    ContextNodeTableSettings shardTableSettings = tableSettings;
+    if (shardCount > 0) {
+      shardTableSettings.maxInstances =
+          (tableSettings.maxInstances + shardCount - 1) / shardCount;
+      shardTableSettings.maxPooledInstances =
+          (tableSettings.maxPooledInstances + shardCount - 1) / shardCount;
+    }
+
+    vector<unique_ptr<ContextShard>> shards;
+    for (size_t i = 0; i < shardCount; i++) {
+      shards.push_back(make_unique<ContextShard>(
+          factories,
+          subinstanceCreator,
+          key,
+          shardTableSettings));
+    }
+
+    return make_shared<SingleNodeRouter>(
+        subinstanceCreator,
+        templateNode,
+        key,
+        tableSettings,
+        move(shards));
   }
 }
 
@@ -260,6 +962,16 @@ class ContextualPacketPusher : public IPacketPusher {
     mWrappedPusher->pushPacket(move(packet), channelName);
   }
 
+  void pushPacketInheritingFrom(
+      Packet&& packet,
+      const Parameters& receivedParameters,
+      const string& channelName) override {
+    mWrappedPusher->pushPacketInheritingFrom(
+        move(packet),
+        receivedParameters,
+        channelName);
+  }
+
  private:
   const shared_ptr<IPacketPusher> mWrappedPusher;
   SingleNodeRouter* const mContextRouter;
@@ -268,15 +980,18 @@ class ContextualPacketPusher : public IPacketPusher {
 
 void SingleNodeRouter::setPacketPusher(
     const shared_ptr<IPacketPusher>& pusher) {
-  mPacketPusher = make_shared<ContextualPacketPusher>(pusher, this, mKey);
+  mPacketPusher = make_shared<ContextualPacketPusher>(
+      pusher,
+      this,
+      mKeyParameter.getKey());
 
-  for (auto& pair : mNodes) {
-    auto source = pair.second->asSource();
+  mNodes->forEachNode([&pusher](const shared_ptr<IImplementation>& node) {
+    auto source = node->asSource();
 
     if (source) {
       source->setPacketPusher(pusher);
     }
-  }
+  });
 }
 
 class ContextRemover : public IImplementation, public IPathable {
@@ -284,7 +999,8 @@ class ContextRemover : public IImplementation, public IPathable {
   ContextRemover(
       const weak_ptr<IContextRouter>& contextRouter,
       const string& key)
-      : mContextRouter(contextRouter), mKey(key) {}
+      : mContextRouter(contextRouter),
+        mKeyParameter(make_shared<ContextKeyParameter>(key)) {}
 
   void handlePacket(const PathablePacket& incomingPathablePacket) override {
     const Packet& incomingPacket = incomingPathablePacket.packet;
@@ -293,16 +1009,28 @@ class ContextRemover : public IImplementation, public IPathable {
       return;
     }
 
-    string nodeKey = incomingPacket.parameters[mKey].get<string>();
-    if (!contextRouter->removeNode(nodeKey)) {
-      return;
-    }
-
-    Packet removedHandleKeyPacket;
-    removedHandleKeyPacket.parameters[mKey] = incomingPacket.parameters[mKey];
-    incomingPathablePacket.packetPusher->pushPacket(
-        move(removedHandleKeyPacket),
-        "Removed Key");
+    ContextLookupDigits digits;
+    const string nodeKey(getContextLookup(
+        mKeyParameter->get(incomingPacket.parameters),
+        mKeyParameter->getKey(),
+        &digits));
+
+    // Sharded routers remove the node on its shard's thread, so this can run
+    // after handlePacket() returns.
+    contextRouter->removeNode(
+        nodeKey,
+        [packetPusher = incomingPathablePacket.packetPusher,
+         receivedParameters = incomingPacket.parameters,
+         keyParameter = mKeyParameter]() {
+          Packet removedHandleKeyPacket;
+          keyParameter->set(
+              &removedHandleKeyPacket.parameters,
+              keyParameter->get(receivedParameters));
+          packetPusher->pushPacketInheritingFrom(
+              move(removedHandleKeyPacket),
+              receivedParameters,
+              "Removed Key");
+        });
   }
 
   IPathable* asPathable() override { return this; }
@@ -311,7 +1039,9 @@ class ContextRemover : public IImplementation, public IPathable {
 
  private:
   const weak_ptr<IContextRouter> mContextRouter;
-  const string mKey;
+
+  // Shared with removals which complete on a shard's thread.
+  const shared_ptr<const ContextKeyParameter> mKeyParameter;
 };
 
 CohesiveGroupRouter::CohesiveGroupRouter(
@@ -400,19 +1130,21 @@ void CohesiveGroupRouter::addNode(
   }
 }
 
-bool CohesiveGroupRouter::removeNode(const string& contextLookup) {
+void CohesiveGroupRouter::removeNode(
+    const string& contextLookup,
+    function<void()>&& onRemoved) {
   auto it = mNodeRouters.find(contextLookup);
   if (it == mNodeRouters.end()) {
-    return false;
+    return;
   }
 
   for (const auto& nodePair : mNodeRouters) {
     const auto& routerNode = nodePair.second;
-    routerNode->removeNode(contextLookup);
+    routerNode->removeNode(contextLookup, [] {});
   }
 
   mNodeRouters.erase(it);
-  return true;
+  onRemoved();
 }
 
 void CohesiveGroupRouter::createNewInstance(const string& forNewContextLookup) {
@@ -469,6 +1201,44 @@ static string getNonEmptyStringOrThrow(
   return stringValue;
 }
 
+// Returns |defaultValue| if |key| is missing.
+static size_t getUnsignedOrThrow(
+    const nlohmann::json& initParameters,
+    const string& key,
+    size_t defaultValue = 0) {
+  if (!initParameters.contains(key)) {
+    return defaultValue;
+  }
+
+  const nlohmann::json& value = initParameters[key];
+  if (!value.is_number_integer() || value.get<int64_t>() < 0) {
+    ostringstream errorStream;
+    errorStream << "'" << key
+                << "' must be a non-negative integer in 'initParameters'. "
+                   "Actual type: "
+                << value.type_name();
+
+    throw runtime_error(errorStream.str());
+  }
+
+  return value.get<size_t>();
+}
+
+static ContextNodeTableSettings getTableSettingsOrThrow(
+    const nlohmann::json& initParameters) {
+  ContextNodeTableSettings tableSettings;
+  tableSettings.idleTimeoutMs =
+      getUnsignedOrThrow(initParameters, kInitDataParameter_IdleTimeoutMs);
+  tableSettings.maxInstances =
+      getUnsignedOrThrow(initParameters, kInitDataParameter_MaxInstances);
+  tableSettings.maxPooledInstances = getUnsignedOrThrow(
+      initParameters,
+      kInitDataParameter_MaxPooledInstances,
+      kDefaultMaxPooledInstances);
+
+  return tableSettings;
+}
+
 ContextualNode::Impl::Impl(
     const Factories& factories,
     const json& initParameters)
@@ -480,7 +1250,10 @@ ContextualNode::Impl::Impl(
       mKey(getNonEmptyStringOrThrow(
           initParameters,
           "initParameters",
-          kInitDataParameter_Key)) {}
+          kInitDataParameter_Key)),
+      mShardCount(
+          getUnsignedOrThrow(initParameters, kInitDataParameter_Shards)),
+      mTableSettings(getTableSettingsOrThrow(initParameters)) {}
 
 ContextualNode::Impl::~Impl() {}
 
@@ -489,7 +1262,13 @@ void ContextualNode::Impl::initialize() {
       mFactories.implementationFactory->createImplementation(
           mType,
           mInitParameters);
-  mContextRouter = createContextRouter(shared_from_this(), templateNode, mKey);
+  mContextRouter = createContextRouter(
+      shared_from_this(),
+      templateNode,
+      mKey,
+      mFactories,
+      mShardCount,
+      mTableSettings);
   mContextRemover = make_shared<ContextRemover>(mContextRouter, mKey);
 
   mNodeMap[kPartitionName_ContextRouter] = mContextRouter->asINode();
@@ -16,6 +16,8 @@
 
 #include "nodes/HttpRequestExtractor.h"
 
+#include <algorithm>
+#include <cctype>
 #include <memory>
 
 #include "maplang/Errors.h"
@@ -30,11 +32,40 @@ static const string kChannel_BodyData = "Body Data";
 static const string kChannel_RequestEnded = "Request Ended";
 static const string kChannel_NewRequest = "New Request";
 
+static const string kInitParameter_Headers = "headers";
+
+static optional<unordered_set<string>> getIncludedHeaders(
+    const json& initParameters) {
+  if (!initParameters.contains(kInitParameter_Headers)) {
+    return {};
+  }
+
+  const json& headers = initParameters[kInitParameter_Headers];
+  if (!headers.is_array()) {
+    throw runtime_error(
+        "'" + kInitParameter_Headers + "' must be an array of header names.");
+  }
+
+  unordered_set<string> includedHeaders;
+  for (const json& header : headers) {
+    string name = header.get<string>();
+    transform(name.begin(), name.end(), name.begin(), [](unsigned char c) {
+      return tolower(c);
+    });
+
+    includedHeaders.insert(move(name));
+  }
+
+  return includedHeaders;
+}
+
 HttpRequestExtractor::HttpRequestExtractor(
     const Factories& factories,
     const nlohmann::json& initParameters)
-    : mFactories(factories), mInitParameters(initParameters) {
-  reset();
+    : mFactories(factories), mInitParameters(initParameters),
+      mIncludedHeaders(getIncludedHeaders(initParameters)) {
+  resetRequest();
+  resetConnection();
 }
 
 HttpRequestExtractor::~HttpRequestExtractor() {
@@ -42,144 +73,149 @@ HttpRequestExtractor::~HttpRequestExtractor() {
 }
 
 void HttpRequestExtractor::handlePacket(const PathablePacket& incomingPacket) {
+  if (mConnectionFailed) {
+    return;
+  }
+
   try {
     mLastPayloadsPacketPusher = incomingPacket.packetPusher;
-
-    if (mSentHeaders) {
-      /*
-       * Won't know if it's the last one when Content-Length isn't set, but that
-       * means a new connection is required for the next request. Because this
-       * node is usually used inside of a ContextualNode, another instance of
-       * this class will handle the next request.
-       */
-      bool knownLastBufferInRequest = false;
-      const Buffer& incomingBuffer = incomingPacket.packet.buffers[0];
-      Packet bodyPacket = createBodyPacket(incomingPacket.packet.buffers[0]);
-      if (mBodyLength != SIZE_MAX) {
-        const size_t remainingBodyLength = mBodyLength - mSentBodyDataByteCount;
-        knownLastBufferInRequest = incomingBuffer.length <= remainingBodyLength;
-
-        if (knownLastBufferInRequest) {
-          bodyPacket.buffers[0].length = remainingBodyLength;
+    const auto& packetPusher = incomingPacket.packetPusher;
+
+    /*
+     * A persistent connection sends its requests one after another, and a
+     * buffer can end one request and start the next (or several, when they
+     * are pipelined).
+     */
+    Buffer remaining = incomingPacket.packet.buffers[0];
+    while (remaining.length > 0) {
+      if (!mSentHeaders) {
+        const size_t headerByteCount = mRequestParser.parse(remaining);
+        remaining = remaining.slice(headerByteCount);
+
+        if (!mRequestParser.isComplete()) {
+          return;
         }
-      }
 
-      incomingPacket.packetPusher->pushPacket(
-          move(bodyPacket),
-          kChannel_BodyData);
+        startRequest(packetPusher);
+        continue;
+      }
 
-      if (knownLastBufferInRequest) {
-        sendEndOfRequestPacketIfRequestPending(incomingPacket.packetPusher);
-        reset();
+      if (mRequestParser.isChunked()) {
+        const size_t bodyByteCount =
+            sendChunkedBodyData(remaining, packetPusher);
+        remaining = remaining.slice(bodyByteCount);
+        continue;
       }
 
-      return;
-    }
+      const size_t bodyByteCount =
+          min(remaining.length, mBodyLength - mSentBodyDataByteCount);
 
-    const size_t bufferSizeBeforeAppending = mHeaderData.size();
-    mHeaderData.append(incomingPacket.packet.buffers[0]);
+      packetPusher->pushPacket(
+          createBodyPacket(remaining.slice(0, bodyByteCount)),
+          kChannel_BodyData);
 
-    static constexpr char kDoubleCrLf[] = "\r\n\r\n";
-    static constexpr size_t kDoubleCrLfLength = sizeof(kDoubleCrLf) - 1;
-    const size_t headersEnd =
-        mHeaderData.firstIndexOf(kDoubleCrLf, kDoubleCrLfLength);
-    if (headersEnd == MemoryStream::kNotFound) {
-      return;
-    }
+      mSentBodyDataByteCount += bodyByteCount;
+      remaining = remaining.slice(bodyByteCount);
 
-    // Send a packet containing the request headers (no body data).
-    Packet headerPacket =
-        createHeaderPacket(mHeaderData.subStream(0, headersEnd));
-    size_t contentLength = SIZE_MAX;
-    const json& httpHeaders =
-        headerPacket.parameters[http::kParameter_HttpHeaders];
-    if (httpHeaders.contains(http::kHttpHeaderNormalized_ContentLength)) {
-      contentLength = headerPacket
-                          .parameters[http::kParameter_HttpHeaders]
-                                     [http::kHttpHeaderNormalized_ContentLength]
-                          .get<uint64_t>();
+      if (mSentBodyDataByteCount == mBodyLength) {
+        endRequest(packetPusher);
+      }
     }
+  } catch (const exception& ex) {
+    sendErrorPacket(incomingPacket.packetPusher, ex);
 
-    incomingPacket.packetPusher->pushPacket(
-        move(headerPacket),
-        kChannel_NewRequest);
-    mSentHeaders = true;
-
-    // If the incoming packet has part of the body, send body data as a separate
-    // packet.
-    const size_t bodyStart = headersEnd + kDoubleCrLfLength;
-    const size_t availableBodyLength = mHeaderData.size() - bodyStart;
-    if (availableBodyLength > 0) {
-      const size_t offsetOfBodyInLastBuffer =
-          bodyStart - bufferSizeBeforeAppending;
+    /*
+     * Where the next request starts is unknown, so the rest of the
+     * connection's bytes are dropped until it's reset (e.g. when it closes).
+     */
+    endRequest(incomingPacket.packetPusher);
+    mConnectionFailed = true;
+  }
+}
 
-      Buffer bodyBuffer = incomingPacket.packet.buffers[0].slice(offsetOfBodyInLastBuffer);
+/*
+ * A request's body is chunked, Content-Length bytes long, or empty without
+ * either. Other transfer codings can't be delimited, so they're rejected.
+ */
+void HttpRequestExtractor::startRequest(
+    const shared_ptr<IPacketPusher>& packetPusher) {
+  const uint64_t contentLength = mRequestParser.getContentLength();
+  if (mRequestParser.isChunked()) {
+    mBodyLength = SIZE_MAX;
+  } else if (mRequestParser.hasTransferEncoding()) {
+    throw runtime_error("Unsupported Transfer-Encoding.");
+  } else if (contentLength != HttpRequestParser::kNoContentLength) {
+    mBodyLength = contentLength;
+  } else {
+    mBodyLength = 0;
+  }
 
-      incomingPacket.packetPusher->pushPacket(
-          createBodyPacket(bodyBuffer),
-          kChannel_BodyData);
+  mRequestId = mConnectionId + "-" + to_string(mRequestIndex);
 
-      mSentBodyDataByteCount += bodyBuffer.length;
-    }
+  // Send a packet containing the request headers (no body data).
+  packetPusher->pushPacket(createHeaderPacket(), kChannel_NewRequest);
+  mSentHeaders = true;
+  mRequestIndex++;
 
-    mHeaderData.clear();
-  } catch (const exception& ex) {
-    sendErrorPacket(incomingPacket.packetPusher, ex);
+  if (mBodyLength == 0) {
+    endRequest(packetPusher);
   }
 }
 
-Packet HttpRequestExtractor::createHeaderPacket(
-    const MemoryStream& memoryStream) const {
-  MemoryStream firstLine;
-  MemoryStream headersStream;
-
-  size_t firstNonCrLfIndex = memoryStream.firstIndexNotOfAnyInSet("\r\n", 2);
-  MemoryStream trimmedStream = memoryStream.subStream(firstNonCrLfIndex);
-  memoryStream.split(
-      "\r\n",
-      2,
-      [&firstLine, &headersStream](size_t index, MemoryStream&& stream) {
-        if (index == 0) {
-          firstLine = move(stream);
-        } else {
-          headersStream = move(stream);
-        }
-
-        return true;
-      });
-
-  json parameters;
+// Returns how many bytes of |buffer| were part of the chunked body.
+size_t HttpRequestExtractor::sendChunkedBodyData(
+    const Buffer& buffer,
+    const shared_ptr<IPacketPusher>& packetPusher) {
+  Buffer bodyData;
+  const size_t decodedByteCount = mChunkedDecoder.decode(buffer, &bodyData);
 
-  parameters[http::kParameter_HttpHeaders] = parseHeaders(headersStream);
-  firstLine.split(' ', [&parameters](size_t index, MemoryStream&& token) {
-    ostringstream outStream;
-    outStream << token;
-    string tokenString = outStream.str();
+  if (bodyData.length > 0) {
+    packetPusher->pushPacket(createBodyPacket(bodyData), kChannel_BodyData);
+    mSentBodyDataByteCount += bodyData.length;
+  }
 
-    if (index == 0) {
-      parameters[http::kParameter_HttpMethod] = tokenString;
-    } else if (index == 1) {
-      parameters[http::kParameter_HttpPath] = tokenString;
-    } else if (index == 2) {
-      parameters[http::kParameter_HttpVersion] = tokenString;
-    }
+  if (mChunkedDecoder.isComplete()) {
+    endRequest(packetPusher);
+  }
 
-    return true;
-  });
+  return decodedByteCount;
+}
 
-  parameters[http::kParameter_HttpRequestId] = mRequestId;
+void HttpRequestExtractor::endRequest(
+    const shared_ptr<IPacketPusher>& packetPusher) {
+  sendEndOfRequestPacketIfRequestPending(packetPusher);
+  resetRequest();
+}
 
+Packet HttpRequestExtractor::createHeaderPacket() const {
   Packet headerPacket;
-  headerPacket.parameters = parameters;
+  headerPacket.parameters = mRequestParser.createParameters(
+      mIncludedHeaders ? &*mIncludedHeaders : nullptr);
+  headerPacket.parameters[http::kParameter_HttpRequestId] = mRequestId;
+  headerPacket.parameters[http::kParameter_HttpRequestIndex] = mRequestIndex;
 
   return headerPacket;
 }
 
 void HttpRequestExtractor::reset() {
+  sendEndOfRequestPacketIfRequestPending(mLastPayloadsPacketPusher);
+  mLastPayloadsPacketPusher.reset();
+  resetRequest();
+  resetConnection();
+}
+
+void HttpRequestExtractor::resetConnection() {
+  mConnectionId = to_string(mUniformDistribution(mRandomDevice));
+  mRequestIndex = 0;
+  mConnectionFailed = false;
+}
+
+void HttpRequestExtractor::resetRequest() {
   mSentHeaders = false;
-  mHeaderData.clear();
-  mRequestId = to_string(mUniformDistribution(mRandomDevice));
-  mBodyLength = SIZE_MAX;
+  mRequestParser.reset();
+  mChunkedDecoder.reset();
+  mRequestId.clear();
+  mBodyLength = 0;
   mSentBodyDataByteCount = 0;
 }
 
@@ -191,45 +227,6 @@ Packet HttpRequestExtractor::createBodyPacket(const Buffer& bodyBuffer) const {
   return bodyPacket;
 }
 
-static string toLower(const string& str) {
-  ostringstream out;
-  size_t length = str.length();
-  for (size_t i = 0; i < length; i++) {
-    out.put(tolower(str[i]));
-  }
-
-  return out.str();
-}
-
-json HttpRequestExtractor::parseHeaders(const MemoryStream& headers) {
-  json parsedHeaders;
-  headers.split(
-      "\r\n",
-      2,
-      [&parsedHeaders](size_t lineIndex, MemoryStream&& headerLine) {
-        static constexpr size_t maxTokens = 2;
-        ostringstream key;
-        ostringstream value;
-        headerLine.split(
-            ':',
-            [&key, &value](size_t kvIndex, MemoryStream&& keyOrValue) {
-              if (kvIndex == 0) {
-                key << keyOrValue.trim();
-              } else {
-                value << keyOrValue.trim();
-              }
-
-              return true;
-            },
-            maxTokens);
-
-        parsedHeaders[toLower(key.str())] = value.str();
-        return true;  // keep iterating until the end
-      });
-
-  return parsedHeaders;
-}
-
 void HttpRequestExtractor::sendEndOfRequestPacketIfRequestPending(
     const shared_ptr<IPacketPusher>& packetPusher) {
   if (!mSentHeaders) {
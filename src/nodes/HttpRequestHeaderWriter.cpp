@@ -16,8 +16,7 @@
 
 #include "nodes/HttpRequestHeaderWriter.h"
 
-#include <sstream>
-
+#include "HttpHeaderSerializer.h"
 #include "logging.h"
 #include "maplang/HttpUtilities.h"
 
@@ -33,52 +32,42 @@ HttpRequestHeaderWriter::HttpRequestHeaderWriter(
     const nlohmann::json& initParameters)
     : mFactories(factories), mInitParameters(initParameters) {}
 
+// The body isn't copied. It's sent after the serialized headers' buffer.
 void HttpRequestHeaderWriter::handlePacket(
     const PathablePacket& pathablePacket) {
   const auto& packet = pathablePacket.packet;
   const auto& packetPusher = pathablePacket.packetPusher;
+  const Buffer body = packet.buffers.empty() ? Buffer() : packet.buffers[0];
 
-  stringstream httpBytes;
-  const auto method =
-      packet.parameters[http::kParameter_HttpMethod].get<string>();
-  const auto path = packet.parameters[http::kParameter_HttpPath].get<string>();
-
-  static const char* const CRLF = "\r\n";
-  httpBytes << method << ' ' << path << " HTTP/1.1" << CRLF;
+  HttpHeaderSerializer serializer;
+  serializer.addRequestLine(
+      packet.parameters[http::kParameter_HttpMethod].get_ref<const string&>(),
+      packet.parameters[http::kParameter_HttpPath].get_ref<const string&>());
 
-  json httpHeaders = packet.parameters[http::kParameter_HttpHeaders];
-
-  if (!packet.buffers.empty() && packet.buffers[0].length > 0) {
-    const size_t contentLength = packet.buffers[0].length;
-    httpHeaders[http::kHttpHeaderNormalized_ContentLength] =
-        to_string(contentLength);
-  } else if (httpHeaders.contains(http::kHttpHeaderNormalized_ContentLength)) {
-    httpHeaders.erase(http::kHttpHeaderNormalized_ContentLength);
-  }
+  const json& httpHeaders = packet.parameters[http::kParameter_HttpHeaders];
 
   const auto httpHeadersEnd = httpHeaders.end();
   for (auto it = httpHeaders.begin(); it != httpHeadersEnd; it++) {
-    if (it.key().empty()) {
+    if (it.key().empty()
+        || it.key() == http::kHttpHeaderNormalized_ContentLength) {
       continue;
     }
 
-    httpBytes << it.key() << ": " << it.value().get<string>() << CRLF;
+    serializer.addHeader(it.key(), it.value().get_ref<const string&>());
   }
-  httpBytes << CRLF;
 
-  Packet httpBytesPacket;
+  if (body.length > 0) {
+    serializer.addContentLength(body.length);
+  }
 
-  if (!packet.buffers.empty()) {
-    const Buffer& buffer = packet.buffers[0];
-    httpBytes.write((const char*)buffer.data.get(), buffer.length);
+  serializer.endHeaders();
 
-    httpBytes.seekg(0, ios::end);
-    const size_t bufferLength = httpBytes.tellg();
-    httpBytes.seekg(0, ios::beg);
+  Packet httpBytesPacket;
+  httpBytesPacket.buffers.push_back(
+      serializer.serialize(*mFactories.bufferFactory));
 
-    Buffer bodyBuffer = mFactories.bufferFactory->Create(bufferLength);
-    httpBytes.read(reinterpret_cast<char*>(bodyBuffer.data.get()), bufferLength);
-    httpBytesPacket.buffers.push_back(bodyBuffer);
+  if (body.length > 0) {
+    httpBytesPacket.buffers.push_back(body);
   }
 
   packetPusher->pushPacket(move(httpBytesPacket), kChannel_HttpData);
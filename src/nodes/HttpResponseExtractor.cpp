@@ -16,6 +16,7 @@
 
 #include "nodes/HttpResponseExtractor.h"
 
+#include <algorithm>
 #include <memory>
 
 #include "maplang/Errors.h"
@@ -52,25 +53,7 @@ void HttpResponseExtractor::handlePacket(const PathablePacket& pathablePacket) {
 
   try {
     if (mReceivedHeaders) {
-      bool knownLastBufferInRequest = false;
-      const Buffer& incomingBuffer = incomingPacket.buffers[0];
-      Packet bodyPacket = createBodyPacket(incomingPacket.buffers[0]);
-      if (mBodyLength != SIZE_MAX) {
-        const size_t remainingBodyLength = mBodyLength - mSentBodyDataByteCount;
-        knownLastBufferInRequest = incomingBuffer.length <= remainingBodyLength;
-
-        if (knownLastBufferInRequest) {
-          bodyPacket.buffers[0].length = remainingBodyLength;
-        }
-      }
-
-      mPacketPusher->pushPacket(move(bodyPacket), kChannel_BodyData);
-
-      if (knownLastBufferInRequest) {
-        sendEndOfRequestPacketIfRequestPending();
-        reset();
-      }
-
+      sendBodyData(incomingPacket.buffers[0]);
       return;
     }
 
@@ -88,41 +71,78 @@ void HttpResponseExtractor::handlePacket(const PathablePacket& pathablePacket) {
     // Send a packet containing the request headers (no body data).
     Packet headerPacket =
         createHeaderPacket(mHeaderData.subStream(0, headersEnd));
-    size_t contentLength = SIZE_MAX;
-    if (headerPacket.parameters[http::kParameter_HttpHeaders].contains(
-            "content-length")) {
-      contentLength = headerPacket
-                          .parameters[http::kParameter_HttpHeaders]
-                                     [http::kHttpHeaderNormalized_ContentLength]
-                          .get<size_t>();
-    }
+    setBodyLength(headerPacket.parameters[http::kParameter_HttpHeaders]);
 
     mPacketPusher->pushPacket(
         move(headerPacket),
         kChannel_ReponseHeadersReceived);
     mReceivedHeaders = true;
+    mHeaderData.clear();
 
     // If the incoming packet has part of the body, send body data as a separate
     // packet.
     const size_t bodyStart = headersEnd + kDoubleCrLfLength;
-    const size_t availableBodyLength = mHeaderData.size() - bodyStart;
-    if (availableBodyLength > 0) {
-      const size_t offsetOfBodyInLastBuffer =
-          bodyStart - bufferSizeBeforeAppending;
-      Buffer bodyBuffer =
-          incomingPacket.buffers[0].slice(offsetOfBodyInLastBuffer);
-      Packet bodyPacket = createBodyPacket(bodyBuffer);
-
-      mPacketPusher->pushPacket(move(bodyPacket), kChannel_BodyData);
-      mSentBodyDataByteCount += bodyBuffer.length;
+    const size_t offsetOfBodyInLastBuffer =
+        bodyStart - bufferSizeBeforeAppending;
+
+    if (mBodyLength == 0 && !mIsChunked) {
+      sendEndOfRequestPacketIfRequestPending();
+      reset();
+      return;
     }
 
-    mHeaderData.clear();
+    sendBodyData(incomingPacket.buffers[0].slice(offsetOfBodyInLastBuffer));
   } catch (const exception& ex) {
     sendErrorPacket(pathablePacket.packetPusher, ex);
   }
 }
 
+/*
+ * A chunked body ends with its last chunk, and other bodies after
+ * Content-Length bytes. Without either, the body lasts until the connection
+ * closes.
+ */
+void HttpResponseExtractor::setBodyLength(const json& headers) {
+  if (headers.contains(http::kHttpHeaderNormalized_TransferEncoding)) {
+    mIsChunked = http::isChunkedTransferEncoding(
+        headers[http::kHttpHeaderNormalized_TransferEncoding].get<string>());
+  } else if (headers.contains(http::kHttpHeaderNormalized_ContentLength)) {
+    mBodyLength = stoull(
+        headers[http::kHttpHeaderNormalized_ContentLength].get<string>());
+  }
+}
+
+void HttpResponseExtractor::sendBodyData(const Buffer& buffer) {
+  Buffer remaining = buffer;
+  while (remaining.length > 0) {
+    Buffer bodyData;
+    if (mIsChunked) {
+      const size_t decodedByteCount =
+          mChunkedDecoder.decode(remaining, &bodyData);
+      remaining = remaining.slice(decodedByteCount);
+    } else {
+      const size_t bodyByteCount =
+          min(remaining.length, mBodyLength - mSentBodyDataByteCount);
+      bodyData = remaining.slice(0, bodyByteCount);
+      remaining = remaining.slice(bodyByteCount);
+    }
+
+    if (bodyData.length > 0) {
+      mPacketPusher->pushPacket(createBodyPacket(bodyData), kChannel_BodyData);
+      mSentBodyDataByteCount += bodyData.length;
+    }
+
+    if (mChunkedDecoder.isComplete()
+        || mSentBodyDataByteCount == mBodyLength) {
+      sendEndOfRequestPacketIfRequestPending();
+      reset();
+
+      // Bytes after the end of the response are not part of it.
+      return;
+    }
+  }
+}
+
 Packet HttpResponseExtractor::createHeaderPacket(
     const MemoryStream& memoryStream) const {
   MemoryStream firstLine;
@@ -174,6 +194,8 @@ void HttpResponseExtractor::reset() {
   mReceivedHeaders = false;
   mHeaderData.clear();
   mRequestId = to_string(mUniformDistribution(mRandomDevice));
+  mChunkedDecoder.reset();
+  mIsChunked = false;
   mBodyLength = SIZE_MAX;
   mSentBodyDataByteCount = 0;
 }
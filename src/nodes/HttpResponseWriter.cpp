@@ -16,9 +16,18 @@
 
 #include "nodes/HttpResponseWriter.h"
 
-#include <sstream>
+#include <uv.h>
 
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <list>
+#include <string_view>
+#include <unordered_map>
+
+#include "HttpHeaderSerializer.h"
 #include "logging.h"
+#include "maplang/Errors.h"
 #include "maplang/HttpUtilities.h"
 
 using namespace std;
@@ -28,66 +37,445 @@ namespace maplang {
 
 static const char* const kChannel_HttpData = "Http Data";
 
+static const string kInitParameter_DateHeader = "dateHeader";
+static const string kInitParameter_MaxCachedResponses = "maxCachedResponses";
+
+static constexpr uint64_t kDateUpdateIntervalMs = 1000;
+
+/*
+ * The Date header's value, formatted by a timer on the writer's loop just
+ * after each second starts. Read on any thread.
+ */
+class HttpResponseWriter::DateHeader final
+    : public enable_shared_from_this<DateHeader> {
+ public:
+  struct Value final {
+    string date;
+    time_t second;
+  };
+
+  DateHeader() { update(); }
+
+  shared_ptr<const Value> get() const { return atomic_load(&mValue); }
+
+  // Only the first loop's timer is started.
+  void startTimer(const shared_ptr<uv_loop_t>& uvLoop) {
+    if (uvLoop == nullptr || mTimerStarted.exchange(true)) {
+      return;
+    }
+
+    auto timer = new Timer();
+    timer->dateHeader = weak_from_this();
+
+    const int status = uv_timer_init(uvLoop.get(), &timer->handle);
+    if (status != 0) {
+      delete timer;
+      throw runtime_error(
+          "Failed to initialize date timer: " + string(uv_strerror(status)));
+    }
+
+    timer->handle.data = timer;
+
+    const uint64_t msIntoSecond =
+        chrono::duration_cast<chrono::milliseconds>(
+            chrono::system_clock::now().time_since_epoch())
+            .count()
+        % kDateUpdateIntervalMs;
+    uv_timer_start(
+        &timer->handle,
+        onTimer,
+        kDateUpdateIntervalMs - msIntoSecond,
+        kDateUpdateIntervalMs);
+    uv_unref(reinterpret_cast<uv_handle_t*>(&timer->handle));
+  }
+
+ private:
+  // Owned by the loop. Closes itself once the DateHeader is gone.
+  struct Timer final {
+    uv_timer_t handle;
+    weak_ptr<DateHeader> dateHeader;
+  };
+
+  static void onTimer(uv_timer_t* handle) {
+    auto timer = reinterpret_cast<Timer*>(handle->data);
+    const auto dateHeader = timer->dateHeader.lock();
+    if (dateHeader == nullptr) {
+      uv_close(
+          reinterpret_cast<uv_handle_t*>(handle),
+          [](uv_handle_t* closedHandle) {
+            delete reinterpret_cast<Timer*>(closedHandle->data);
+          });
+      return;
+    }
+
+    dateHeader->update();
+  }
+
+  void update() {
+    const time_t now = time(nullptr);
+    tm utcTime;
+    gmtime_r(&now, &utcTime);
+
+    char date[64];
+    const size_t dateLength = strftime(
+        date,
+        sizeof(date),
+        "%a, %d %b %Y %H:%M:%S GMT",
+        &utcTime);
+
+    shared_ptr<const Value> value =
+        make_shared<Value>(Value {string(date, dateLength), now});
+    atomic_store(&mValue, move(value));
+  }
+
+ private:
+  shared_ptr<const Value> mValue;
+  atomic<bool> mTimerStarted {false};
+};
+
+static size_t combineHash(size_t hash, size_t value) {
+  return hash ^ (value + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2));
+}
+
+static size_t hashString(const string& value) {
+  return hash<string_view>()(value);
+}
+
+/*
+ * Serialized headers of recent responses, keyed by a hash of the status, the
+ * httpHeaders' contents and the body's length (the body isn't in them). A hit
+ * compares the contents, so equal headers hit whether or not they're shared.
+ * The least recently used response is evicted when the cache is full.
+ *
+ * Only used on the writer's thread.
+ */
+class HttpResponseWriter::ResponseCache final {
+ public:
+  // Refers to a packet's values.
+  struct Response final {
+    const json& httpHeaders;
+    uint64_t statusCode;
+    const json* statusReason;
+    size_t bodyLength;
+
+    size_t hash() const {
+      size_t hash = combineHash(statusCode, bodyLength);
+      if (statusReason != nullptr && statusReason->is_string()) {
+        hash = combineHash(
+            hash,
+            hashString(statusReason->get_ref<const string&>()));
+      }
+
+      const auto httpHeadersEnd = httpHeaders.end();
+      for (auto it = httpHeaders.begin(); it != httpHeadersEnd; it++) {
+        hash = combineHash(hash, hashString(it.key()));
+        if (it.value().is_string()) {
+          hash = combineHash(
+              hash,
+              hashString(it.value().get_ref<const string&>()));
+        }
+      }
+
+      return hash;
+    }
+  };
+
+  explicit ResponseCache(size_t maxEntries) : mMaxEntries(maxEntries) {}
+
+  /*
+   * An empty buffer if |response|, which hashes to |hash|, isn't cached with
+   * the date from |dateSecond|.
+   */
+  Buffer find(const Response& response, size_t hash, time_t dateSecond) {
+    const auto it = mEntries.find(hash);
+    if (it == mEntries.end() || it->second.dateSecond != dateSecond
+        || !it->second.matches(response)) {
+      return Buffer();
+    }
+
+    Entry& entry = it->second;
+    mLeastRecentlyUsed.splice(
+        mLeastRecentlyUsed.begin(),
+        mLeastRecentlyUsed,
+        entry.leastRecentlyUsedPosition);
+
+    return entry.headerBuffer;
+  }
+
+  void insert(
+      const Response& response,
+      size_t hash,
+      time_t dateSecond,
+      const Buffer& headerBuffer) {
+    auto it = mEntries.find(hash);
+    if (it == mEntries.end()) {
+      if (mEntries.size() >= mMaxEntries) {
+        mEntries.erase(mLeastRecentlyUsed.back());
+        mLeastRecentlyUsed.pop_back();
+      }
+
+      mLeastRecentlyUsed.push_front(hash);
+      it = mEntries.emplace(hash, Entry()).first;
+      it->second.leastRecentlyUsedPosition = mLeastRecentlyUsed.begin();
+    } else {
+      mLeastRecentlyUsed.splice(
+          mLeastRecentlyUsed.begin(),
+          mLeastRecentlyUsed,
+          it->second.leastRecentlyUsedPosition);
+    }
+
+    // Replaces headers with an older date, or another response with the same
+    // hash.
+    Entry& entry = it->second;
+    entry.httpHeaders = response.httpHeaders;
+    entry.statusCode = response.statusCode;
+    entry.statusReason =
+        response.statusReason != nullptr ? *response.statusReason : json();
+    entry.bodyLength = response.bodyLength;
+    entry.dateSecond = dateSecond;
+    entry.headerBuffer = headerBuffer;
+  }
+
+ private:
+  struct Entry final {
+    json httpHeaders;
+    uint64_t statusCode = 0;
+    json statusReason;
+    size_t bodyLength = 0;
+    time_t dateSecond = 0;
+    Buffer headerBuffer;
+    list<size_t>::iterator leastRecentlyUsedPosition;
+
+    bool matches(const Response& response) const {
+      const bool hasStatusReason = response.statusReason != nullptr
+                                       ? statusReason == *response.statusReason
+                                       : statusReason.is_null();
+
+      return statusCode == response.statusCode
+             && bodyLength == response.bodyLength && hasStatusReason
+             && httpHeaders == response.httpHeaders;
+    }
+  };
+
+  const size_t mMaxEntries;
+  unordered_map<size_t, Entry> mEntries;
+  list<size_t> mLeastRecentlyUsed;  // Most recently used first.
+};
+
+static bool getBoolOrThrow(const json& initParameters, const string& key) {
+  if (!initParameters.contains(key)) {
+    return false;
+  }
+
+  const json& value = initParameters[key];
+  if (!value.is_boolean()) {
+    throw runtime_error("'" + key + "' must be a boolean.");
+  }
+
+  return value.get<bool>();
+}
+
+static size_t getUnsignedOrThrow(
+    const json& initParameters,
+    const string& key) {
+  if (!initParameters.contains(key)) {
+    return 0;
+  }
+
+  const json& value = initParameters[key];
+  if (!value.is_number_integer() || value.get<int64_t>() < 0) {
+    throw runtime_error("'" + key + "' must be a non-negative integer.");
+  }
+
+  return value.get<size_t>();
+}
+
 HttpResponseWriter::HttpResponseWriter(
     const Factories& factories,
     const nlohmann::json& initParameters)
-    : mFactories(factories), mInitParameters(initParameters) {}
+    : mFactories(factories), mInitParameters(initParameters),
+      mLineEnd(string("\r\n")) {
+  if (getBoolOrThrow(initParameters, kInitParameter_DateHeader)) {
+    mDateHeader = make_shared<DateHeader>();
+  }
+
+  const size_t maxCachedResponses =
+      getUnsignedOrThrow(initParameters, kInitParameter_MaxCachedResponses);
+  if (maxCachedResponses > 0) {
+    mResponseCache = make_shared<ResponseCache>(maxCachedResponses);
+  }
+}
 
+void HttpResponseWriter::setSubgraphContext(
+    const shared_ptr<ISubgraphContext>& context) {
+  if (mDateHeader != nullptr && context != nullptr) {
+    mDateHeader->startTimer(context->getUvLoop());
+  }
+}
+
+static bool isChunked(const json& httpHeaders) {
+  const auto it =
+      httpHeaders.find(http::kHttpHeaderNormalized_TransferEncoding);
+
+  return it != httpHeaders.end()
+         && http::isChunkedTransferEncoding(it->get_ref<const string&>());
+}
+
+// A packet without an httpStatusCode must say it continues a chunked body.
+static bool isNextChunk(const Parameters& parameters) {
+  if (parameters.contains(http::kParameter_HttpChunk)) {
+    const json& httpChunk = parameters[http::kParameter_HttpChunk];
+    return httpChunk.is_boolean() && httpChunk.get<bool>();
+  }
+
+  if (parameters.contains(http::kParameter_HttpHeaders)) {
+    const json& httpHeaders = parameters[http::kParameter_HttpHeaders];
+    return httpHeaders.is_object() && isChunked(httpHeaders);
+  }
+
+  return false;
+}
+
+/*
+ * A packet with an httpStatusCode starts a response. When its headers have
+ * "Transfer-Encoding: chunked", its body is the first chunk, and the body of
+ * each following packet is the next chunk, until a packet without a body ends
+ * the response. These packets have no httpStatusCode, and have either
+ * "httpChunk": true or the chunked httpHeaders of the response. Other packets
+ * without an httpStatusCode are errors.
+ *
+ * The body isn't copied. The headers are serialized into their own buffer,
+ * which is sent before the body's.
+ */
 void HttpResponseWriter::handlePacket(const PathablePacket& pathablePacket) {
   const auto& packet = pathablePacket.packet;
   const auto& packetPusher = pathablePacket.packetPusher;
+  const Buffer body = packet.buffers.empty() ? Buffer() : packet.buffers[0];
 
-  stringstream httpBytes;
-  auto statusCode =
-      packet.parameters[http::kParameter_HttpStatusCode].get<uint64_t>();
-  string statusReason;
-  if (packet.parameters.contains(http::kParameter_HttpStatusReason)) {
-    statusReason =
-        packet.parameters[http::kParameter_HttpStatusReason].get<string>();
+  if (!packet.parameters.contains(http::kParameter_HttpStatusCode)) {
+    if (!isNextChunk(packet.parameters)) {
+      sendErrorPacket(
+          packetPusher,
+          "Missing httpStatusCode",
+          "A response needs an httpStatusCode. Chunks of a chunked response "
+          "need \"" + http::kParameter_HttpChunk
+              + "\": true or a chunked Transfer-Encoding header.");
+      return;
+    }
+
+    HttpHeaderSerializer serializer;
+    serializer.addChunkSize(body.length);
+    if (body.length == 0) {
+      serializer.addLineEnd();
+    }
+
+    packetPusher->pushPacket(
+        createHttpDataPacket(
+            serializer.serialize(*mFactories.bufferFactory),
+            body,
+            true),
+        kChannel_HttpData);
+    return;
+  }
+
+  const json& httpHeaders = packet.parameters[http::kParameter_HttpHeaders];
+  const bool chunked = isChunked(httpHeaders);
+
+  shared_ptr<const DateHeader::Value> date;
+  if (mDateHeader != nullptr
+      && !httpHeaders.contains(http::kHttpHeaderNormalized_Date)) {
+    date = mDateHeader->get();
+  }
+
+  const string* const dateString = date != nullptr ? &date->date : nullptr;
+  const time_t dateSecond = date != nullptr ? date->second : 0;
+
+  Buffer headerBuffer;
+  if (mResponseCache == nullptr || httpHeaders.is_null()) {
+    headerBuffer = createHeaderBuffer(packet, httpHeaders, chunked, dateString);
   } else {
-    statusReason = http::getDefaultReasonForHttpStatus(statusCode);
+    const ResponseCache::Response response {
+        httpHeaders,
+        packet.parameters[http::kParameter_HttpStatusCode].get<uint64_t>(),
+        packet.parameters.findValue(http::kParameter_HttpStatusReason),
+        body.length};
+    const size_t responseHash = response.hash();
+
+    headerBuffer = mResponseCache->find(response, responseHash, dateSecond);
+    if (headerBuffer.length == 0) {
+      headerBuffer =
+          createHeaderBuffer(packet, httpHeaders, chunked, dateString);
+      mResponseCache->insert(response, responseHash, dateSecond, headerBuffer);
+    }
   }
 
-  static const char* const CRLF = "\r\n";
-  httpBytes << "HTTP/1.1 " << statusCode << " " << statusReason << CRLF;
+  packetPusher->pushPacket(
+      createHttpDataPacket(headerBuffer, body, chunked),
+      kChannel_HttpData);
+}
 
-  json httpHeaders = packet.parameters[http::kParameter_HttpHeaders];
+Buffer HttpResponseWriter::createHeaderBuffer(
+    const Packet& packet,
+    const json& httpHeaders,
+    bool isChunked,
+    const string* date) const {
+  const Buffer body = packet.buffers.empty() ? Buffer() : packet.buffers[0];
+  HttpHeaderSerializer serializer;
 
-  if (!packet.buffers.empty() && packet.buffers[0].length > 0) {
-    const size_t contentLength = packet.buffers[0].length;
-    httpHeaders[http::kHttpHeaderNormalized_ContentLength] =
-        to_string(contentLength);
-  } else if (httpHeaders.contains(http::kHttpHeaderNormalized_ContentLength)) {
-    httpHeaders.erase(http::kHttpHeaderNormalized_ContentLength);
+  const auto statusCode =
+      packet.parameters[http::kParameter_HttpStatusCode].get<uint64_t>();
+  if (packet.parameters.contains(http::kParameter_HttpStatusReason)) {
+    serializer.addStatusLine(
+        statusCode,
+        packet.parameters[http::kParameter_HttpStatusReason]
+            .get_ref<const string&>());
+  } else {
+    serializer.addStatusLine(statusCode);
   }
 
   const auto httpHeadersEnd = httpHeaders.end();
   for (auto it = httpHeaders.begin(); it != httpHeadersEnd; it++) {
-    if (it.key().empty()) {
+    if (it.key().empty()
+        || it.key() == http::kHttpHeaderNormalized_ContentLength) {
       continue;
     }
 
-    httpBytes << it.key() << ": " << it.value().get<string>() << CRLF;
+    serializer.addHeader(it.key(), it.value().get_ref<const string&>());
   }
-  httpBytes << CRLF;
 
-  Packet httpBytesPacket;
+  if (date != nullptr) {
+    serializer.addHeader(http::kHttpHeaderNormalized_Date, *date);
+  }
 
-  if (!packet.buffers.empty()) {
-    const Buffer& buffer = packet.buffers[0];
-    httpBytes.write((const char*)buffer.data.get(), buffer.length);
+  if (!isChunked && body.length > 0) {
+    serializer.addContentLength(body.length);
+  }
 
-    httpBytes.seekg(0, ios::end);
-    const size_t bufferLength = httpBytes.tellg();
-    httpBytes.seekg(0, ios::beg);
+  serializer.endHeaders();
 
-    Buffer bodyBuffer = mFactories.bufferFactory->Create(bufferLength);
-    httpBytes.read(reinterpret_cast<char*>(bodyBuffer.data.get()), bufferLength);
+  if (isChunked && body.length > 0) {
+    serializer.addChunkSize(body.length);
+  }
+
+  return serializer.serialize(*mFactories.bufferFactory);
+}
 
-    httpBytesPacket.buffers.push_back(bodyBuffer);
+Packet HttpResponseWriter::createHttpDataPacket(
+    const Buffer& headerBuffer,
+    const Buffer& body,
+    bool isChunk) const {
+  Packet httpDataPacket;
+  httpDataPacket.buffers.push_back(headerBuffer);
+
+  if (body.length > 0) {
+    httpDataPacket.buffers.push_back(body);
+
+    if (isChunk) {
+      httpDataPacket.buffers.push_back(mLineEnd);
+    }
   }
 
-  packetPusher->pushPacket(move(httpBytesPacket), kChannel_HttpData);
+  return httpDataPacket;
 }
 
 }  // namespace maplang
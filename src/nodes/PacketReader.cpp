@@ -92,8 +92,10 @@ Packet PacketReader::readPacket(const MemoryStream& stream) const {
   offset += parametersLength;
 
   auto parameterStream = stream.subStream(sizeof(parametersLength));
-  Buffer parameterBuffer =
-      mFactories.bufferFactory->Create(parametersLength + 1);
+  // Only used on this thread, while parsing.
+  Buffer parameterBuffer(
+      BufferPtr::makeThreadConfined(parametersLength + 1),
+      parametersLength + 1);
 
   parameterStream.read(
       2 * sizeof(uint64_t),
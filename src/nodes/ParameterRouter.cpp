@@ -39,29 +39,42 @@ ParameterRouter::ParameterRouter(
         + "' be a string in Parameter Router");
   }
 
-  mRoutingKey = json_pointer<basic_json<>>(
-      initParameters[kInitParameter_RoutingKey].get<string>());
+  mRoutingKeySlot = mParameterSchema.declare(
+      key.get<string>(),
+      ParameterSchema::Type::String,
+      ParameterSchema::Presence::Required);
 }
 
 void ParameterRouter::handlePacket(const PathablePacket& pathablePacket) {
-  const json& parameters = pathablePacket.packet.parameters;
+  const ResolvedParameters parameters =
+      mParameterSchema.resolve(pathablePacket.packet.parameters);
+  const string_view channelValue = parameters.getString(mRoutingKeySlot);
+  const string* const channel = findOrCacheChannel(channelValue);
 
-  if (!parameters.contains(mRoutingKey)) {
-    throw runtime_error(
-        "Packet must contain key '" + mRoutingKey.to_string()
-        + "' in Parameter Router");
+  if (channel != nullptr) {
+    pathablePacket.packetPusher->pushPacket(pathablePacket.packet, *channel);
+  } else {
+    pathablePacket.packetPusher->pushPacket(
+        pathablePacket.packet,
+        string(channelValue));
   }
+}
 
-  const json& channelValue = parameters[mRoutingKey];
-
-  if (!channelValue.is_string() && !channelValue.is_primitive()) {
-    throw runtime_error(
-        "Value of '" + mRoutingKey.to_string() + "' must be a simple type.");
+const string* ParameterRouter::findOrCacheChannel(string_view channelValue) {
+  // Routing values usually repeat, so keep a string per channel instead of
+  // creating one for every packet.
+  for (const string& channel : mChannels) {
+    if (channel == channelValue) {
+      return &channel;
+    }
   }
 
-  const string channel = channelValue.get<string>();
+  if (mChannels.size() >= kMaxCachedChannels) {
+    return nullptr;
+  }
 
-  pathablePacket.packetPusher->pushPacket(pathablePacket.packet, channel);
+  mChannels.emplace_back(channelValue);
+  return &mChannels.back();
 }
 
 }  // namespace maplang
@@ -19,13 +19,19 @@
 #include <uv.h>
 
 #include <atomic>
-#include <list>
+#include <functional>
+#include <future>
+#include <memory>
 #include <mutex>
 #include <sstream>
+#include <vector>
 
-#include "Cleanup.h"
 #include "maplang/Errors.h"
+#include "maplang/IUvLoopRunnerFactory.h"
 #include "maplang/ObjectPool.h"
+#include "maplang/ParameterSchema.h"
+#include "maplang/SlabBufferPool.h"
+#include "maplang/concurrentqueue.h"
 
 using namespace std;
 using namespace nlohmann;
@@ -38,9 +44,10 @@ static const string kChannel_NewIncomingConnection = "New Incoming Connection";
 static const string kChannel_ConnectionEstablished = "Connection Established";
 static const string kChannel_ConnectionClosed = "Connection Closed";
 static const string kChannel_SenderShutdown = "Sender Shutdown";
-static const string kChannel_DataQueued = "Data Queued";
 static const string kChannel_LocallyDisconnected = "Locally Disconnected";
 static const string kChannel_RemotelyDisconnected = "Remotely Disconnected";
+static const string kChannel_WriteQueueFull = "Write Queue Full";
+static const string kChannel_WriteQueueDrained = "Write Queue Drained";
 
 static const string kParameter_TcpConnectionId = "TcpConnectionId";
 static const string kParameter_Address = "Address";
@@ -52,8 +59,29 @@ static const string kParameter_RemotePort = "RemotePort";
 static const string kParameter_Backlog = "NewConnectionBacklog";
 static const string kParameter_NoDelay = "NoDelay";
 static const string kParameter_ClosedReason = "Closed Reason";
+static const string kParameter_WriteQueueSize = "WriteQueueSize";
+static const string kParameter_TcpShard = "TcpShard";
+
+static const string kInitParameter_WriteQueueHighWaterMark =
+    "writeQueueHighWaterMark";
+static const string kInitParameter_WriteQueueLowWaterMark =
+    "writeQueueLowWaterMark";
+static const string kInitParameter_WriteQueueFullPolicy =
+    "writeQueueFullPolicy";
+static const string kInitParameter_ReceiveBudget = "receiveBudget";
+static const string kInitParameter_ListenerShards = "listenerShards";
+
+static const string kWriteQueueFullPolicy_Signal = "Signal";
+static const string kWriteQueueFullPolicy_Drop = "Drop";
+static const string kWriteQueueFullPolicy_Disconnect = "Disconnect";
+
+static constexpr size_t kDefaultWriteQueueHighWaterMark = 1024 * 1024;
+static constexpr size_t kDefaultWriteQueueLowWaterMark = 256 * 1024;
+
+static const json kEmptyObject = json::object();
 
 static const string kClosedReason_StreamEnded = "Stream Ended";
+static const string kClosedReason_WriteQueueFull = "Write queue full.";
 
 static const string kNodeName_Sender = "Sender";
 static const string kNodeName_Receiver = "Receiver";
@@ -62,24 +90,215 @@ static const string kNodeName_AsyncEvents = "Async Events";
 static const string kNodeName_Connector = "Connector";
 static const string kNodeName_Disconnector = "Disconnector";
 static const string kNodeName_ShutdownSender = "Shutdown Sender";
+static const string kNodeName_PauseReceiving = "Pause Receiving";
+static const string kNodeName_ResumeReceiving = "Resume Receiving";
+
+/*
+ * The TcpConnectionId parameter. The low 24 bits are the index of the
+ * connection's slot in its shard's connection table, the next 8 bits are the
+ * shard, and the high 32 bits are the slot's generation, which changes when
+ * the slot is reused. Looking up a connection is an array index, and ids of
+ * closed connections are never found.
+ */
+using TcpConnectionId = uint64_t;
+static constexpr TcpConnectionId kNoConnectionId = 0;
+
+static constexpr uint32_t kConnectionIndexBits = 24;
+static constexpr uint32_t kMaxConnectionsPerShard = 1 << kConnectionIndexBits;
+static constexpr uint32_t kMaxListenerShards = 256;
+
+static TcpConnectionId
+makeConnectionId(uint32_t generation, uint32_t shard, uint32_t index) {
+  return (static_cast<uint64_t>(generation) << 32)
+         | (shard << kConnectionIndexBits) | index;
+}
+
+static uint32_t getConnectionIndex(TcpConnectionId connectionId) {
+  return connectionId & (kMaxConnectionsPerShard - 1);
+}
+
+static uint32_t getConnectionShard(TcpConnectionId connectionId) {
+  return (connectionId >> kConnectionIndexBits) & (kMaxListenerShards - 1);
+}
+
+static uint32_t getConnectionGeneration(TcpConnectionId connectionId) {
+  return connectionId >> 32;
+}
+
+class ReceiveBudgetNotifier;
+
+/*
+ * Receive buffers which are still referenced downstream. Shared with the
+ * buffers' deleters, which can run on any thread and after the connection
+ * is closed.
+ */
+struct InFlightReceiveBuffers final {
+  TcpConnectionId connectionId = kNoConnectionId;
+  atomic<size_t> bytes {0};
+
+  // Set while reading is paused because |bytes| exceeded the receive budget.
+  atomic<bool> overBudget {false};
+
+  shared_ptr<ReceiveBudgetNotifier> notifier;
+};
+
+/*
+ * Tells the loop which connections' receive buffers were released under the
+ * receive budget. Buffers can be released on any thread, also after the
+ * UvTcpImpl is gone, so the notifier and its async handle are owned by the
+ * loop. close() stops calls to the UvTcpImpl, and the notifier is released
+ * when the handle has closed.
+ */
+class ReceiveBudgetNotifier final {
+ public:
+  using OnUnderBudget =
+      function<void(const shared_ptr<InFlightReceiveBuffers>& inFlight)>;
+
+  // Called on the loop's thread.
+  static shared_ptr<ReceiveBudgetNotifier> create(
+      uv_loop_t* uvLoop,
+      size_t receiveBudget,
+      OnUnderBudget&& onUnderBudget) {
+    const auto notifier = shared_ptr<ReceiveBudgetNotifier>(
+        new ReceiveBudgetNotifier(receiveBudget, move(onUnderBudget)));
+
+    memset(&notifier->mAsync, 0, sizeof(notifier->mAsync));
+    const int status = uv_async_init(uvLoop, &notifier->mAsync, onAsyncWrapper);
+    if (status != 0) {
+      throw runtime_error(
+          "Failed to initialize async event: " + string(uv_strerror(status)));
+    }
+
+    notifier->mAsync.data = notifier.get();
+
+    // Only used while connections are open, which keep the loop alive.
+    uv_unref(reinterpret_cast<uv_handle_t*>(&notifier->mAsync));
+    notifier->mSelf = notifier;
+
+    return notifier;
+  }
+
+  const size_t receiveBudget;
+
+  // Called on the thread which releases a buffer.
+  void onReceiveBufferReleased(
+      const shared_ptr<InFlightReceiveBuffers>& inFlight,
+      size_t bufferSize) {
+    const size_t remainingBytes = inFlight->bytes -= bufferSize;
+
+    if (remainingBytes > receiveBudget / 2 || !inFlight->overBudget
+        || !inFlight->overBudget.exchange(false)) {
+      return;
+    }
+
+    lock_guard<recursive_mutex> lock(mMutex);
+    if (!mOnUnderBudget) {
+      return;
+    }
+
+    mConnectionsUnderBudget.push_back(inFlight);
+    uv_async_send(&mAsync);
+  }
+
+  /*
+   * Called on the loop's thread, or once nothing runs the loop. OnUnderBudget
+   * is not called once this returns. If the loop has stopped, the handle
+   * finishes closing when the loop is destroyed.
+   */
+  void close() {
+    lock_guard<recursive_mutex> lock(mMutex);
+    mOnUnderBudget = nullptr;
+    mConnectionsUnderBudget.clear();
+    uv_close(reinterpret_cast<uv_handle_t*>(&mAsync), onClosed);
+  }
+
+ private:
+  ReceiveBudgetNotifier(size_t receiveBudget, OnUnderBudget&& onUnderBudget)
+      : receiveBudget(receiveBudget), mOnUnderBudget(move(onUnderBudget)) {}
+
+  static void onAsyncWrapper(uv_async_t* handle) {
+    auto notifier = reinterpret_cast<ReceiveBudgetNotifier*>(handle->data);
+    notifier->onAsync();
+  }
+
+  static void onClosed(uv_handle_t* closedHandle) {
+    auto notifier = reinterpret_cast<ReceiveBudgetNotifier*>(closedHandle->data);
+    const auto self = move(notifier->mSelf);
+  }
+
+  void onAsync() {
+    // Recursive, because a buffer can be released while OnUnderBudget runs.
+    lock_guard<recursive_mutex> lock(mMutex);
+    if (!mOnUnderBudget) {
+      return;
+    }
+
+    vector<shared_ptr<InFlightReceiveBuffers>> connectionsUnderBudget;
+    connectionsUnderBudget.swap(mConnectionsUnderBudget);
+    for (const auto& inFlight : connectionsUnderBudget) {
+      mOnUnderBudget(inFlight);
+    }
+  }
+
+ private:
+  recursive_mutex mMutex;
+  OnUnderBudget mOnUnderBudget;
+  vector<shared_ptr<InFlightReceiveBuffers>> mConnectionsUnderBudget;
+  uv_async_t mAsync;
+
+  // Released when mAsync is closed.
+  shared_ptr<ReceiveBudgetNotifier> mSelf;
+};
 
 struct UvTcpConnection final {
-  shared_ptr<uv_tcp_t> uvSocket;
-  string connectionId;
+  // uvSocket.data points to this connection.
+  uv_tcp_t uvSocket;
+
+  // Null once the UvTcpImpl is gone. The connection then frees itself when
+  // it's closed.
+  UvTcpImpl* tcpImpl = nullptr;
+  TcpConnectionId connectionId = kNoConnectionId;
+
+  // The connection id and addresses. Set once the connection is established,
+  // and shared by every packet sent for this connection.
+  Parameters parameters;
+  bool established = false;
   string closedReason;
-  string localAddress;
-  uint16_t localPort;
-  string remoteAddress;
-  uint16_t remotePort;
+
+  // Set when the write queue reaches the high water mark, and cleared when it
+  // drains to the low water mark.
+  bool writeQueueFull = false;
+
+  bool receiving = false;
+  bool receivingPausedByRequest = false;
+  shared_ptr<InFlightReceiveBuffers> inFlightReceiveBuffers;
+};
+
+struct ConnectionSlot final {
+  uint32_t generation = 1;
+  unique_ptr<UvTcpConnection> connection;
+};
+
+enum class WriteQueueFullPolicy {
+  // Only send "Write Queue Full" and "Write Queue Drained" events.
+  Signal,
+
+  // Also drop data sent while the write queue is full.
+  Drop,
+
+  // Disconnect when the write queue becomes full.
+  Disconnect,
 };
 
 static void sendUvErrorPacket(
     const string& message,
     int status,
-    const string& connectionId,
+    TcpConnectionId connectionId,
     const shared_ptr<IPacketPusher>& pusher) {
   Packet packet;
-  packet.parameters[kParameter_TcpConnectionId] = connectionId;
+  if (connectionId != kNoConnectionId) {
+    packet.parameters[kParameter_TcpConnectionId] = connectionId;
+  }
 
   static constexpr size_t kErrorNameLength = 128;
   char errorName[kErrorNameLength];
@@ -109,11 +328,10 @@ static int getSocketAddressAndPort(
     char ip6AddrString[INET6_ADDRSTRLEN];
     status = uv_ip6_name(ip6Sock, ip6AddrString, sizeof(ip6AddrString));
     if (status != 0) {
-      const string connectionId = "";
       sendUvErrorPacket(
           "Could not create IPv6 address string.",
           status,
-          connectionId,
+          kNoConnectionId,
           pusherForErrors);
       return status;
     }
@@ -126,27 +344,25 @@ static int getSocketAddressAndPort(
     char ip4AddrString[INET_ADDRSTRLEN];
     status = uv_ip4_name(ip4Sock, ip4AddrString, sizeof(ip4AddrString));
     if (status != 0) {
-      const string connectionId = "";
       sendUvErrorPacket(
           "Could not create IPv4 address string.",
           status,
-          connectionId,
+          kNoConnectionId,
           pusherForErrors);
       return status;
     }
 
     address = ip4AddrString;
   } else {
-    const string connectionId = "";
     ostringstream errorMessageStream;
     errorMessageStream << "Unexpected address family " << sock->ss_family
                        << ".";
     sendUvErrorPacket(
         errorMessageStream.str(),
         EINVAL,
-        connectionId,
+        kNoConnectionId,
         pusherForErrors);
-    return status;
+    return EINVAL;
   }
 
   const string ipv4Wrapper = "::ffff:";
@@ -174,11 +390,10 @@ static int getLocalUvAddressAndPort(
       reinterpret_cast<sockaddr*>(&populatedSocket),
       &socketSize);
   if (status != 0) {
-    const string connectionId = "";
     sendUvErrorPacket(
         "Could not get local address/port.",
         status,
-        connectionId,
+        kNoConnectionId,
         packetPusher);
     return status;
   }
@@ -209,11 +424,10 @@ static int getRemoteUvAddressAndPort(
       reinterpret_cast<sockaddr*>(&populatedSocket),
       &socketSize);
   if (status != 0) {
-    const string connectionId = "";
     sendUvErrorPacket(
         "Could not get remote address/port.",
         status,
-        connectionId,
+        kNoConnectionId,
         packetPusher);
     return status;
   }
@@ -230,11 +444,13 @@ static int getRemoteUvAddressAndPort(
   return 0;
 }
 
-static constexpr size_t kBufferSizeInPool = 64 * 1024;
 
 struct ExtendedUvWriteT {
   uv_write_t uvWriteRequest;
-  Buffer buffer;
+
+  // Keeps the packet's buffers alive until the write completes.
+  vector<Buffer> buffers;
+  vector<uv_buf_t> uvBuffers;
 };
 
 struct ExtendedShutdownT {
@@ -242,50 +458,146 @@ struct ExtendedShutdownT {
   shared_ptr<IPacketPusher> packetPusher;
 };
 
-struct ConnectInfo {
-  UvTcpImpl* tcpImpl;
+struct ExtendedConnectT {
+  uv_connect_t uvConnectRequest;
+  shared_ptr<IPacketPusher> packetPusher;
+};
+
+/*
+ * A packet sent to an interface, which is handled on another shard's loop.
+ */
+struct ShardCommand {
+  enum class Type {
+    Listen,
+    SendData,
+    Disconnect,
+    ShutdownSender,
+    PauseReceiving,
+    ResumeReceiving,
+  };
+
+  Type type;
+  Packet packet;
   shared_ptr<IPacketPusher> packetPusher;
 };
 
+/*
+ * Opens a socket which other shards can bind to the same address and port.
+ * The kernel spreads incoming connections across them.
+ */
+static int openReusePortSocket(uv_tcp_t* tcp, int addressFamily) {
+#ifdef SO_REUSEPORT
+  const int fd = socket(addressFamily, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -errno;
+  }
+
+  const int enable = 1;
+  if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) != 0) {
+    const int error = -errno;
+    close(fd);
+    return error;
+  }
+
+  const int status = uv_tcp_open(tcp, fd);
+  if (status != 0) {
+    close(fd);
+  }
+
+  return status;
+#else
+  return UV_ENOTSUP;
+#endif
+}
+
 class UvTcpImpl final {
  public:
-  UvTcpImpl(const Factories& factories, const nlohmann::json& initParameters)
+  UvTcpImpl(
+      const Factories& factories,
+      const nlohmann::json& initParameters,
+      uint32_t shardIndex = 0)
       : mFactories(factories), mInitParameters(initParameters),
-        mBufferPool(
-            [] { return new uint8_t[kBufferSizeInPool]; },
-            [](uint8_t* buf) { delete[] buf; }),
         mUvWriteTPool(
             [] { return new ExtendedUvWriteT(); },
-            [](ExtendedUvWriteT* writeReq) {
-              writeReq->buffer.data.reset();
-              writeReq->buffer.length = 0;
-            }) {
-    call_once(initAtomicConnectionIndexOnce, []() {
-      atomicConnectionIndex.store(0);
-    });
+            [](ExtendedUvWriteT* writeReq) { delete writeReq; }),
+        mConnectionIdSlot(mConnectionSchema.declare(
+            kParameter_TcpConnectionId,
+            ParameterSchema::Type::Number,
+            ParameterSchema::Presence::Required)),
+        mShardIndex(shardIndex) {
+    const json& flowControlParameters =
+        mInitParameters.is_object() ? mInitParameters : kEmptyObject;
+    mWriteQueueHighWaterMark = flowControlParameters.value(
+        kInitParameter_WriteQueueHighWaterMark,
+        kDefaultWriteQueueHighWaterMark);
+    mWriteQueueLowWaterMark = flowControlParameters.value(
+        kInitParameter_WriteQueueLowWaterMark,
+        min(kDefaultWriteQueueLowWaterMark, mWriteQueueHighWaterMark));
+
+    if (mWriteQueueLowWaterMark > mWriteQueueHighWaterMark) {
+      throw runtime_error(
+          "'" + kInitParameter_WriteQueueLowWaterMark
+          + "' must not be greater than '"
+          + kInitParameter_WriteQueueHighWaterMark + "'.");
+    }
+
+    mReceiveBudget =
+        flowControlParameters.value(kInitParameter_ReceiveBudget, size_t(0));
+
+    mShardCount =
+        flowControlParameters.value(kInitParameter_ListenerShards, uint32_t(1));
+    if (mShardCount < 1 || mShardCount > kMaxListenerShards) {
+      throw runtime_error(
+          "'" + kInitParameter_ListenerShards + "' must be between 1 and "
+          + to_string(kMaxListenerShards) + ".");
+    }
+
+    const string policy = flowControlParameters.value(
+        kInitParameter_WriteQueueFullPolicy,
+        kWriteQueueFullPolicy_Signal);
+    if (policy == kWriteQueueFullPolicy_Signal) {
+      mWriteQueueFullPolicy = WriteQueueFullPolicy::Signal;
+    } else if (policy == kWriteQueueFullPolicy_Drop) {
+      mWriteQueueFullPolicy = WriteQueueFullPolicy::Drop;
+    } else if (policy == kWriteQueueFullPolicy_Disconnect) {
+      mWriteQueueFullPolicy = WriteQueueFullPolicy::Disconnect;
+    } else {
+      throw runtime_error(
+          "Unknown '" + kInitParameter_WriteQueueFullPolicy + "' '" + policy
+          + "'. Expected '" + kWriteQueueFullPolicy_Signal + "', '"
+          + kWriteQueueFullPolicy_Drop + "' or '"
+          + kWriteQueueFullPolicy_Disconnect + "'.");
+    }
   }
 
-  ~UvTcpImpl() {}
+  ~UvTcpImpl() {
+    for (const auto& shard : mShards) {
+      shard->stopShard();
+    }
+
+    // The other shards closed theirs on their own loops.
+    if (mShardIndex == 0) {
+      closeHandles();
+    }
+  }
 
   void connect(const PathablePacket& pathablePacket) {
     const auto packet = pathablePacket.packet;
 
     if (!packet.parameters.contains(kParameter_Port)) {
-      const string connectionId = "";
       sendUvErrorPacket(
           "Missing parameter '" + kParameter_Port + "'.",
           EINVAL,
-          connectionId,
+          kNoConnectionId,
           pathablePacket.packetPusher);
       return;
     }
 
     if (!packet.parameters.contains(kParameter_Address)) {
-      const string connectionId = "";
       sendUvErrorPacket(
           "Missing parameter '" + kParameter_Address + "'.",
           EINVAL,
-          connectionId,
+          kNoConnectionId,
           pathablePacket.packetPusher);
       return;
     }
@@ -311,70 +623,49 @@ class UvTcpImpl final {
           reinterpret_cast<sockaddr_in*>(&addr));
 
       if (status != 0) {
-        const string connectionId = "";
         sendUvErrorPacket(
             "Could not parse address '" + address + "' port " + to_string(port)
                 + ".",
             status,
-            connectionId,
+            kNoConnectionId,
             pathablePacket.packetPusher);
         return;
       }
     }
 
-    uv_tcp_t* uvSocket =
-        reinterpret_cast<uv_tcp_t*>(calloc(1, sizeof(uv_tcp_t)));
-    if (!uvSocket) {
-      throw bad_alloc();
-    }
-
-    Cleanup uvSocketCleanup([uvSocket]() { free(uvSocket); });
-
-    status = uv_tcp_init(mUvLoop.get(), uvSocket);
-    if (status != 0) {
-      const string connectionId = "";
+    UvTcpConnection* const connection = createConnection(&status);
+    if (connection == nullptr) {
       sendUvErrorPacket(
           "Could not initialize TCP client.",
           status,
-          connectionId,
+          kNoConnectionId,
           pathablePacket.packetPusher);
       return;
     }
 
     if (noDelay) {
-      uv_tcp_nodelay(uvSocket, true);
+      uv_tcp_nodelay(&connection->uvSocket, true);
     }
 
-    uv_connect_t* connect =
-        reinterpret_cast<uv_connect_t*>(calloc(1, sizeof(uv_connect_t)));
-    if (!connect) {
-      throw bad_alloc();
-    }
-
-    Cleanup connectCleanup([connect]() { free(connect); });
-
-    ConnectInfo* connectInfo = new ConnectInfo();
-    connectInfo->tcpImpl = this;
-    connectInfo->packetPusher = pathablePacket.packetPusher;
-    connect->data = connectInfo;
+    auto connect = new ExtendedConnectT();
+    connect->packetPusher = pathablePacket.packetPusher;
 
     status = uv_tcp_connect(
-        connect,
-        uvSocket,
+        &connect->uvConnectRequest,
+        &connection->uvSocket,
         reinterpret_cast<const sockaddr*>(&addr),
         onOutgoingConnectionEstablishedWrapper);
     if (status != 0) {
-      const string connectionId = "";
+      delete connect;
+      closeConnection(connection, "Connection failed.");
+
       sendUvErrorPacket(
           "Connection failed.",
           status,
-          connectionId,
+          kNoConnectionId,
           pathablePacket.packetPusher);
       return;
     }
-
-    uvSocketCleanup.cancelCleanup();
-    connectCleanup.cancelCleanup();
   }
 
   void listen(const PathablePacket& pathablePacket) {
@@ -383,16 +674,19 @@ class UvTcpImpl final {
 
     const bool alreadyListening = !mListeningAddressPortPair.empty();
     if (alreadyListening) {
-      sendUvErrorPacket("Already listening.", EINVAL, "", packetPusher);
+      sendUvErrorPacket(
+          "Already listening.",
+          EINVAL,
+          kNoConnectionId,
+          packetPusher);
       return;
     }
 
     if (!packet.parameters.contains(kParameter_Port)) {
-      const string connectionId = "";
       sendUvErrorPacket(
           "Missing parameter '" + kParameter_Port + "'.",
           EINVAL,
-          connectionId,
+          kNoConnectionId,
           packetPusher);
       return;
     }
@@ -428,42 +722,52 @@ class UvTcpImpl final {
           reinterpret_cast<sockaddr_in*>(&addr));
 
       if (status != 0) {
-        const string connectionId = "";
         sendUvErrorPacket(
             "Could not parse address '" + address + "' port " + to_string(port)
                 + ".",
             status,
-            connectionId,
+            kNoConnectionId,
+            packetPusher);
+        return;
+      }
+    }
+
+    if (mShardCount > 1) {
+      status = openReusePortSocket(mTcpServer, addr.ss_family);
+      if (status != 0) {
+        sendUvErrorPacket(
+            "Could not create a listening socket for shard "
+                + to_string(mShardIndex) + ".",
+            status,
+            kNoConnectionId,
             packetPusher);
         return;
       }
     }
 
     status =
-        uv_tcp_bind(&mTcpServer, reinterpret_cast<const sockaddr*>(&addr), 0);
+        uv_tcp_bind(mTcpServer, reinterpret_cast<const sockaddr*>(&addr), 0);
     if (status != 0) {
-      const string connectionId = "";
       sendUvErrorPacket(
           "Could not bind to address '" + address + "' port " + to_string(port)
               + ".",
           status,
-          connectionId,
+          kNoConnectionId,
           packetPusher);
       return;
     }
 
-    mTcpServer.data = this;
+    mTcpServer->data = this;
     status = uv_listen(
-        reinterpret_cast<uv_stream_t*>(&mTcpServer),
+        reinterpret_cast<uv_stream_t*>(mTcpServer),
         backlog,
         onNewIncomingConnectionWrapper);
     if (status != 0) {
-      const string connectionId = "";
       sendUvErrorPacket(
           "Could not listen on address '" + address + "' port "
               + to_string(port) + ".",
           status,
-          connectionId,
+          kNoConnectionId,
           packetPusher);
       return;
     }
@@ -471,7 +775,7 @@ class UvTcpImpl final {
     string boundAddress;
     uint16_t boundPort;
     status = getLocalUvAddressAndPort(
-        &mTcpServer,
+        mTcpServer,
         packetPusher,
         &boundAddress,
         &boundPort);
@@ -481,6 +785,24 @@ class UvTcpImpl final {
 
     mListeningAddressPortPair = boundAddress + ":" + to_string(boundPort);
 
+    if (mShardIndex != 0) {
+      return;
+    }
+
+    if (mShardCount > 1) {
+      // Port 0 binds to any port, so the other shards bind to the one chosen
+      // here.
+      startShards();
+
+      Packet shardListenPacket = packet;
+      shardListenPacket.parameters[kParameter_Port] = boundPort;
+      for (const auto& shard : mShards) {
+        shard->postCommand(
+            ShardCommand::Type::Listen,
+            PathablePacket(shardListenPacket, packetPusher));
+      }
+    }
+
     Packet listenSuccessPacket;
     listenSuccessPacket.parameters[kParameter_LocalPort] = boundPort;
     listenSuccessPacket.parameters[kParameter_LocalAddress] = boundAddress;
@@ -490,78 +812,44 @@ class UvTcpImpl final {
   }
 
   static void onOutgoingConnectionEstablishedWrapper(
-      uv_connect_t* client,
+      uv_connect_t* connect,
       int status) {
-    auto connectInfo = reinterpret_cast<ConnectInfo*>(client->data);
-    const auto tcpImpl = connectInfo->tcpImpl;
-    const auto packetPusher = connectInfo->packetPusher;
-    delete connectInfo;
+    auto connection = reinterpret_cast<UvTcpConnection*>(connect->handle->data);
+    if (connection->tcpImpl == nullptr) {
+      delete reinterpret_cast<ExtendedConnectT*>(connect);
+      return;
+    }
 
-    tcpImpl->onOutgoingConnectionEstablished(packetPusher, client, status);
+    connection->tcpImpl->onOutgoingConnectionEstablished(
+        connection,
+        reinterpret_cast<ExtendedConnectT*>(connect),
+        status);
   }
 
   void onOutgoingConnectionEstablished(
-      const shared_ptr<IPacketPusher>& packetPusher,
-      uv_connect_t* connect,
+      UvTcpConnection* connection,
+      ExtendedConnectT* connect,
       int status) {
-    UvTcpConnection connection;
-    connection.uvSocket = shared_ptr<uv_tcp_t>(
-        reinterpret_cast<uv_tcp_t*>(connect->handle),
-        [connect](uv_tcp_t* tcp) {
-          uv_close(
-              reinterpret_cast<uv_handle_t*>(tcp),
-              onConnectionRemovedWrapper);
-
-          free(tcp);
-          free(connect);
-        });
+    const shared_ptr<IPacketPusher> packetPusher = connect->packetPusher;
+    delete connect;
 
     if (status != 0) {
       sendUvErrorPacket(
           "Outgoing connection failed.",
           status,
-          "",
+          kNoConnectionId,
           packetPusher);
-      free(connect);
+      closeConnection(connection, "Connection failed.");
       return;
     }
 
-    string remoteAddress;
-    uint16_t remotePort = 0;
-    status = getRemoteUvAddressAndPort(
-        connection.uvSocket.get(),
-        packetPusher,
-        &remoteAddress,
-        &remotePort);
+    status = establishConnection(connection, packetPusher);
     if (status != 0) {
       return;  // error packet already sent
     }
 
-    string localAddress;
-    uint16_t localPort = 0;
-    status = getLocalUvAddressAndPort(
-        connection.uvSocket.get(),
-        packetPusher,
-        &localAddress,
-        &localPort);
-    if (status != 0) {
-      return;  // error packet already sent
-    }
-
-    connection.connectionId =
-        remoteAddress + ":" + to_string(remotePort) + " "
-        + to_string(atomic_fetch_add(&atomicConnectionIndex, 1ULL));
-    connection.localAddress = localAddress;
-    connection.localPort = localPort;
-    connection.remoteAddress = remoteAddress;
-    connection.remotePort = remotePort;
-
-    mConnections[connection.connectionId] = connection;
-    mUvClientToConnection[connection.uvSocket.get()] =
-        &mConnections[connection.connectionId];
-
     Packet connectedPacket;
-    setConnectionParameters(connection, &connectedPacket.parameters);
+    connectedPacket.parameters = connection->parameters;
     packetPusher->pushPacket(
         move(connectedPacket),
         kChannel_ConnectionEstablished);
@@ -574,88 +862,48 @@ class UvTcpImpl final {
 
   void onNewIncomingConnection(uv_stream_t* server, int status) {
     if (status < 0) {
-      const string connectionId = "";
       sendUvErrorPacket(
           "New connection failed.",
           status,
-          connectionId,
+          kNoConnectionId,
+          mAsyncEventsPacketPusher);
+      return;
+    }
+
+    UvTcpConnection* const connection = createConnection(&status);
+    if (connection == nullptr) {
+      sendUvErrorPacket(
+          "Failed to initialize incoming connection.",
+          status,
+          kNoConnectionId,
           mAsyncEventsPacketPusher);
       return;
     }
 
-    auto client = make_shared<uv_tcp_t>();
-    uv_tcp_init(mUvLoop.get(), client.get());
-    client->data = this;
-    status = uv_accept(server, reinterpret_cast<uv_stream_t*>(client.get()));
+    status = uv_accept(
+        server,
+        reinterpret_cast<uv_stream_t*>(&connection->uvSocket));
     if (status != 0) {
-      const string connectionId = "";
       sendUvErrorPacket(
           "Failed to accept connection.",
           status,
-          connectionId,
+          kNoConnectionId,
           mAsyncEventsPacketPusher);
+      closeConnection(connection, "Failed to accept connection.");
       return;
     }
 
     if (mIncomingConnectionsNoDelay) {
-      uv_tcp_nodelay(client.get(), true);
+      uv_tcp_nodelay(&connection->uvSocket, true);
     }
 
-    string remoteAddress;
-    uint16_t remotePort = 0;
-    status = getRemoteUvAddressAndPort(
-        client.get(),
-        mAsyncEventsPacketPusher,
-        &remoteAddress,
-        &remotePort);
-    if (status != 0) {
-      return;  // error packet already sent
-    }
-
-    string localAddress;
-    uint16_t localPort = 0;
-    status = getLocalUvAddressAndPort(
-        client.get(),
-        mAsyncEventsPacketPusher,
-        &localAddress,
-        &localPort);
+    status = establishConnection(connection, mAsyncEventsPacketPusher);
     if (status != 0) {
       return;  // error packet already sent
     }
 
-    const string connectionId =
-        remoteAddress + ":" + to_string(remotePort) + " "
-        + to_string(atomic_fetch_add(&atomicConnectionIndex, 1ULL));
-
-    UvTcpConnection connection;
-    connection.uvSocket = client;
-    connection.connectionId = connectionId;
-    connection.localAddress = localAddress;
-    connection.localPort = localPort;
-    connection.remoteAddress = remoteAddress;
-    connection.remotePort = remotePort;
-
-    mConnections[connectionId] = connection;
-    mUvClientToConnection[client.get()] = &mConnections[connectionId];
-
-    status = uv_read_start(
-        reinterpret_cast<uv_stream_t*>(client.get()),
-        allocateBufferWrapper,
-        dataReceivedWrapper);
-    if (status != 0) {
-      sendUvErrorPacket(
-          "Failed to start reading from incoming connection.",
-          status,
-          connectionId,
-          mAsyncEventsPacketPusher);
-      uv_close(
-          reinterpret_cast<uv_handle_t*>(client.get()),
-          onConnectionRemovedWrapper);
-      return;
-    }
-
     Packet newConnectionPacket;
-    setConnectionParameters(connection, &newConnectionPacket.parameters);
+    newConnectionPacket.parameters = connection->parameters;
 
     mAsyncEventsPacketPusher->pushPacket(
         move(newConnectionPacket),
@@ -664,26 +912,35 @@ class UvTcpImpl final {
 
   static void
   dataReceivedWrapper(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf) {
-    auto tcpImpl = reinterpret_cast<UvTcpImpl*>(stream->data);
-
-    tcpImpl->dataReceived(stream, nread, buf);
+    auto connection = reinterpret_cast<UvTcpConnection*>(stream->data);
+    connection->tcpImpl->dataReceived(connection, nread, buf);
   }
 
-  void dataReceived(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf) {
-    UvTcpConnection* const connection = mUvClientToConnection[stream];
+  void dataReceived(
+      UvTcpConnection* connection,
+      ssize_t nread,
+      const uv_buf_t* buf) {
+    const bool countInFlight = nread > 0 && mReceiveBudget > 0;
 
     Buffer buffer;
-    if (buf->base) {
-      buffer.data = shared_ptr<uint8_t>(
+    if (buf->base && countInFlight) {
+      const auto inFlight = connection->inFlightReceiveBuffers;
+      const size_t bufferSize = buf->len;
+      inFlight->bytes += bufferSize;
+
+      // Doesn't refer to this, because it can run after this is gone.
+      buffer.data = SlabBufferPool::share(
           reinterpret_cast<uint8_t*>(buf->base),
-          [this](uint8_t* rawBuffer) { mBufferPool.returnToPool(rawBuffer); });
+          [inFlight, bufferSize] {
+            inFlight->notifier->onReceiveBufferReleased(inFlight, bufferSize);
+          });
+    } else if (buf->base) {
+      buffer.data =
+          SlabBufferPool::share(reinterpret_cast<uint8_t*>(buf->base));
     }
 
     if (nread == UV_EOF) {
-      connection->closedReason = "End of stream";
-      uv_close(
-          reinterpret_cast<uv_handle_t*>(connection->uvSocket.get()),
-          onConnectionRemovedWrapper);
+      closeConnection(connection, "End of stream");
       return;
     } else if (nread < 0) {
       sendUvErrorPacket(
@@ -691,6 +948,7 @@ class UvTcpImpl final {
           nread,
           connection->connectionId,
           mDataReceivedPacketPusher);
+      closeConnection(connection, "Receive error.");
       return;
     }
 
@@ -698,8 +956,9 @@ class UvTcpImpl final {
       return;
     }
 
+    // Shares the connection's parameters instead of copying them.
     Packet dataReceivedPacket;
-    setConnectionParameters(*connection, &dataReceivedPacket.parameters);
+    dataReceivedPacket.parameters = connection->parameters;
 
     buffer.length = nread;
     dataReceivedPacket.buffers.push_back(move(buffer));
@@ -707,91 +966,220 @@ class UvTcpImpl final {
     mDataReceivedPacketPusher->pushPacket(
         move(dataReceivedPacket),
         kChannel_DataReceived);
+
+    if (countInFlight) {
+      checkReceiveBudget(connection);
+    }
+  }
+
+  void pauseReceiving(const PathablePacket& pathablePacket) {
+    if (forwardToShards(ShardCommand::Type::PauseReceiving, pathablePacket)) {
+      return;
+    }
+
+    UvTcpConnection* const connection =
+        findConnection(pathablePacket.packet.parameters);
+    if (connection == nullptr) {
+      return;
+    }
+
+    connection->receivingPausedByRequest = true;
+    stopReceiving(connection);
+  }
+
+  void resumeReceiving(const PathablePacket& pathablePacket) {
+    if (forwardToShards(ShardCommand::Type::ResumeReceiving, pathablePacket)) {
+      return;
+    }
+
+    UvTcpConnection* const connection =
+        findConnection(pathablePacket.packet.parameters);
+    if (connection == nullptr) {
+      return;
+    }
+
+    connection->receivingPausedByRequest = false;
+    if (connection->inFlightReceiveBuffers->overBudget) {
+      return;
+    }
+
+    const int status = startReceiving(connection);
+    if (status != 0) {
+      sendUvErrorPacket(
+          "Failed to resume receiving.",
+          status,
+          connection->connectionId,
+          pathablePacket.packetPusher);
+    }
   }
 
   void sendData(const PathablePacket& pathablePacket) {
+    if (forwardToShards(ShardCommand::Type::SendData, pathablePacket)) {
+      return;
+    }
+
     const auto& packet = pathablePacket.packet;
+    UvTcpConnection* const connectionPtr = findConnection(packet.parameters);
+    if (connectionPtr == nullptr) {
+      sendErrorPacket(
+          pathablePacket.packetPusher,
+          "Unknown connection",
+          "Cannot send data to unknown connection "
+              + packet.parameters[kParameter_TcpConnectionId].dump() + ".");
+      return;
+    }
+
+    UvTcpConnection& connection = *connectionPtr;
+    const auto uvStream = reinterpret_cast<uv_stream_t*>(&connection.uvSocket);
+
+    if (uv_is_closing(reinterpret_cast<uv_handle_t*>(uvStream))) {
+      return;
+    } else if (
+        connection.writeQueueFull
+        && mWriteQueueFullPolicy == WriteQueueFullPolicy::Drop) {
+      return;
+    }
 
-    UvTcpConnection& connection =
-        mConnections[packet.parameters[kParameter_TcpConnectionId]
-                         .get<string>()];
-    const Buffer& buffer = packet.buffers[0];
     ExtendedUvWriteT* writeRequest = mUvWriteTPool.get();
-    writeRequest->buffer = buffer;
-    writeRequest->uvWriteRequest.data = this;
 
-    uv_buf_t uvBuffer =
-        uv_buf_init(reinterpret_cast<char*>(buffer.data.get()), buffer.length);
-    uv_write(
+    // All of the packet's buffers go out in a single vectored write, so
+    // upstream nodes don't need to copy them into one contiguous buffer. The
+    // vectors keep their capacity when the request is returned to the pool.
+    for (const Buffer& buffer : packet.buffers) {
+      if (buffer.length == 0) {
+        continue;
+      }
+
+      writeRequest->buffers.push_back(buffer);
+      writeRequest->uvBuffers.push_back(uv_buf_init(
+          reinterpret_cast<char*>(buffer.data.get()),
+          buffer.length));
+    }
+
+    if (writeRequest->uvBuffers.empty()) {
+      mUvWriteTPool.returnToPool(writeRequest);
+      return;
+    }
+
+    const int status = uv_write(
         reinterpret_cast<uv_write_t*>(writeRequest),
-        reinterpret_cast<uv_stream_t*>(connection.uvSocket.get()),
-        &uvBuffer,
-        1,
+        uvStream,
+        writeRequest->uvBuffers.data(),
+        writeRequest->uvBuffers.size(),
         onDataSentWrapper);
+
+    if (status != 0) {
+      // onDataSent() is not called when the write can't be queued.
+      writeRequest->buffers.clear();
+      writeRequest->uvBuffers.clear();
+      mUvWriteTPool.returnToPool(writeRequest);
+
+      sendUvErrorPacket(
+          "Could not send data.",
+          status,
+          connection.connectionId,
+          pathablePacket.packetPusher);
+      return;
+    }
+
+    // uv_write() writes what it can immediately, and queues the rest.
+    const size_t writeQueueSize = uv_stream_get_write_queue_size(uvStream);
+    if (!connection.writeQueueFull
+        && writeQueueSize >= mWriteQueueHighWaterMark) {
+      onWriteQueueFull(&connection, writeQueueSize);
+    }
   }
 
   static void onDataSentWrapper(uv_write_t* req, int status) {
-    auto tcpImpl = reinterpret_cast<UvTcpImpl*>(req->data);
-    tcpImpl->onDataSent(req, status);
+    auto connection = reinterpret_cast<UvTcpConnection*>(req->handle->data);
+    if (connection->tcpImpl == nullptr) {
+      delete reinterpret_cast<ExtendedUvWriteT*>(req);
+      return;
+    }
+
+    connection->tcpImpl->onDataSent(connection, req, status);
   }
 
-  void onDataSent(uv_write_t* req, int status) {
+  void onDataSent(UvTcpConnection* connection, uv_write_t* req, int status) {
     auto extendedRequest = reinterpret_cast<ExtendedUvWriteT*>(req);
-    extendedRequest->buffer.data.reset();
-    extendedRequest->buffer.length = 0;
+    extendedRequest->buffers.clear();
+    extendedRequest->uvBuffers.clear();
 
+    uv_stream_t* const uvStream = req->handle;
     mUvWriteTPool.returnToPool(extendedRequest);
+
+    const size_t writeQueueSize = uv_stream_get_write_queue_size(uvStream);
+    if (connection->writeQueueFull
+        && writeQueueSize <= mWriteQueueLowWaterMark
+        && !uv_is_closing(reinterpret_cast<uv_handle_t*>(uvStream))) {
+      connection->writeQueueFull = false;
+
+      Packet drainedPacket;
+      drainedPacket.parameters[kParameter_WriteQueueSize] = writeQueueSize;
+      drainedPacket.parameters.inheritFrom(connection->parameters);
+      mAsyncEventsPacketPusher->pushPacket(
+          move(drainedPacket),
+          kChannel_WriteQueueDrained);
+    }
   }
 
-  void disconnect(const PathablePacket& pathablePacket) {
-    const auto& packet = pathablePacket.packet;
+  void onWriteQueueFull(UvTcpConnection* connection, size_t writeQueueSize) {
+    connection->writeQueueFull = true;
+
+    Packet fullPacket;
+    fullPacket.parameters[kParameter_WriteQueueSize] = writeQueueSize;
+    fullPacket.parameters.inheritFrom(connection->parameters);
+    mAsyncEventsPacketPusher->pushPacket(
+        move(fullPacket),
+        kChannel_WriteQueueFull);
+
+    if (mWriteQueueFullPolicy == WriteQueueFullPolicy::Disconnect) {
+      // Pending writes are cancelled, which releases their buffers.
+      closeConnection(connection, kClosedReason_WriteQueueFull);
+    }
+  }
 
-    const string connectionId = packet.parameters[kParameter_TcpConnectionId];
-    const auto it = mConnections.find(connectionId);
-    if (it == mConnections.end()) {
+  void disconnect(const PathablePacket& pathablePacket) {
+    if (forwardToShards(ShardCommand::Type::Disconnect, pathablePacket)) {
       return;
     }
 
-    UvTcpConnection& connection = it->second;
-    connection.closedReason = "Local side requested disconnect.";
+    UvTcpConnection* const connection =
+        findConnection(pathablePacket.packet.parameters);
+    if (connection == nullptr) {
+      return;
+    }
 
-    const shared_ptr<uv_tcp_s> uvSocket = connection.uvSocket;
-    uv_close(
-        reinterpret_cast<uv_handle_t*>(uvSocket.get()),
-        onConnectionRemovedWrapper);
+    closeConnection(connection, "Local side requested disconnect.");
   }
 
   void shutdownSender(const PathablePacket& incomingPathablePacket) {
-    const Packet& incomingPacket = incomingPathablePacket.packet;
-    const string connectionId =
-        incomingPacket.parameters[kParameter_TcpConnectionId];
-    const auto it = mConnections.find(connectionId);
-    if (it == mConnections.end()) {
+    if (forwardToShards(
+            ShardCommand::Type::ShutdownSender,
+            incomingPathablePacket)) {
       return;
     }
 
-    UvTcpConnection& connection = it->second;
-    connection.closedReason = "Local side requested disconnect.";
-
-    const shared_ptr<uv_tcp_s> uvSocket = connection.uvSocket;
-    auto shutdown = reinterpret_cast<ExtendedShutdownT*>(
-        calloc(1, sizeof(ExtendedShutdownT)));
-    if (!shutdown) {
-      throw bad_alloc();
+    UvTcpConnection* const connection =
+        findConnection(incomingPathablePacket.packet.parameters);
+    if (connection == nullptr) {
+      return;
     }
 
+    auto shutdown = new ExtendedShutdownT();
     shutdown->packetPusher = incomingPathablePacket.packetPusher;
 
     int status = uv_shutdown(
-        reinterpret_cast<uv_shutdown_t*>(shutdown),
-        reinterpret_cast<uv_stream_t*>(connection.uvSocket.get()),
+        &shutdown->uvShutdownRequest,
+        reinterpret_cast<uv_stream_t*>(&connection->uvSocket),
         onSenderShutdownWrapper);
 
     if (status != 0) {
+      delete shutdown;
       sendUvErrorPacket(
           "Failed to shutdown sender",
           status,
-          connection.connectionId,
+          connection->connectionId,
           incomingPathablePacket.packetPusher);
       return;
     }
@@ -803,15 +1191,46 @@ class UvTcpImpl final {
     }
 
     mUvLoop = uvLoop;
-    int status = uv_tcp_init(mUvLoop.get(), &mTcpServer);
+
+    if (mReceiveBudget > 0) {
+      mReceiveBudgetNotifier = ReceiveBudgetNotifier::create(
+          mUvLoop.get(),
+          mReceiveBudget,
+          [this](const shared_ptr<InFlightReceiveBuffers>& inFlight) {
+            onConnectionUnderBudget(inFlight);
+          });
+    }
+
+    // Only the other shards receive commands, from shard 0.
+    if (mShardIndex != 0) {
+      memset(&mShardCommandAsync, 0, sizeof(mShardCommandAsync));
+      const int status = uv_async_init(
+          mUvLoop.get(),
+          &mShardCommandAsync,
+          onShardCommandsWrapper);
+      if (status != 0) {
+        throw runtime_error(
+            "Failed to initialize async event: "
+            + string(uv_strerror(status)));
+      }
+
+      mShardCommandAsync.data = this;
+      uv_unref(reinterpret_cast<uv_handle_t*>(&mShardCommandAsync));
+    }
+
+    auto tcpServer = new uv_tcp_t();
+    const int status = uv_tcp_init(mUvLoop.get(), tcpServer);
     if (status != 0) {
-      const string connectionId = "";
+      delete tcpServer;
       sendUvErrorPacket(
           "Could not initialize server's TCP socket.",
           status,
-          connectionId,
+          kNoConnectionId,
           mAsyncEventsPacketPusher);
+      return;
     }
+
+    mTcpServer = tcpServer;
   }
 
   void setReceiverPacketPusher(const shared_ptr<IPacketPusher>& packetPusher) {
@@ -824,123 +1243,499 @@ class UvTcpImpl final {
   }
 
  private:
-  static std::atomic<uint64_t> atomicConnectionIndex;
-  static once_flag initAtomicConnectionIndexOnce;
-
   shared_ptr<uv_loop_t> mUvLoop;
-  uv_tcp_t mTcpServer;
+  // Null until the loop is set. Freed when it's closed.
+  uv_tcp_t* mTcpServer = nullptr;
   string mListeningAddressPortPair;
 
   bool mIncomingConnectionsNoDelay = false;
   shared_ptr<IPacketPusher> mDataReceivedPacketPusher;
   shared_ptr<IPacketPusher> mAsyncEventsPacketPusher;
 
-  unordered_map<string, UvTcpConnection> mConnections;
-  unordered_map<const void*, UvTcpConnection*> mUvClientToConnection;
+  vector<ConnectionSlot> mConnectionSlots;
+  vector<uint32_t> mFreeConnectionSlots;
 
   const Factories mFactories;
   const nlohmann::json mInitParameters;
-  ObjectPool<uint8_t> mBufferPool;
+  SlabBufferPool mReceiveBufferPool;
   ObjectPool<ExtendedUvWriteT> mUvWriteTPool;
 
+  ParameterSchema mConnectionSchema;
+  const ParameterSlot mConnectionIdSlot;
+
+  size_t mWriteQueueHighWaterMark;
+  size_t mWriteQueueLowWaterMark;
+  WriteQueueFullPolicy mWriteQueueFullPolicy;
+
+  // Reading from a connection pauses when this many bytes of its receive
+  // buffers are in flight downstream, and resumes when half of them have
+  // been released. 0 disables the budget.
+  size_t mReceiveBudget;
+  shared_ptr<ReceiveBudgetNotifier> mReceiveBudgetNotifier;
+
+  /*
+   * With listenerShards > 1, shard 0 runs on the group's loop and owns the
+   * other shards. Each shard accepts and reads connections on its own loop
+   * and SO_REUSEPORT socket, and has its own connection table. Packets for a
+   * connection on another shard are posted to that shard's loop.
+   *
+   * Downstream nodes are not pinned to shards. Every shard pushes packets
+   * through the group's packet pushers, so they are handled on the thread
+   * groups of the nodes they are sent to.
+   */
+  const uint32_t mShardIndex;
+  uint32_t mShardCount;
+  vector<shared_ptr<UvTcpImpl>> mShards;
+  shared_ptr<UvLoopRunner> mShardUvLoopRunner;
+  uv_async_t mShardCommandAsync;
+  moodycamel::ConcurrentQueue<ShardCommand> mShardCommands;
+
  private:
-  void setConnectionParameters(
-      const UvTcpConnection& connection,
-      json* parameters) const {
-    (*parameters)[kParameter_TcpConnectionId] = connection.connectionId;
-    (*parameters)[kParameter_LocalAddress] = connection.localAddress;
-    (*parameters)[kParameter_LocalPort] = connection.localPort;
-    (*parameters)[kParameter_RemoteAddress] = connection.remoteAddress;
-    (*parameters)[kParameter_RemotePort] = connection.remotePort;
+  void startShards() {
+    if (!mShards.empty()) {
+      return;
+    }
+
+    for (uint32_t shardIndex = 1; shardIndex < mShardCount; shardIndex++) {
+      const auto shard =
+          make_shared<UvTcpImpl>(mFactories, mInitParameters, shardIndex);
+      shard->mDataReceivedPacketPusher = mDataReceivedPacketPusher;
+      shard->mAsyncEventsPacketPusher = mAsyncEventsPacketPusher;
+      shard->mShardUvLoopRunner =
+          mFactories.uvLoopRunnerFactory->createUvLoopRunner();
+
+      // Handles are initialized on the loop which runs them.
+      promise<void> shardStarted;
+      shard->mShardUvLoopRunner->post([&shard, &shardStarted] {
+        try {
+          shard->setUvLoop(shard->mShardUvLoopRunner->getLoop());
+          shardStarted.set_value();
+        } catch (...) {
+          shardStarted.set_exception(current_exception());
+        }
+      });
+      shardStarted.get_future().get();
+
+      mShards.push_back(shard);
+    }
   }
 
-  static void allocateBufferWrapper(
-      uv_handle_t* handle,
-      size_t suggestedSize,
-      uv_buf_t* buf) {
-    auto serverImpl = reinterpret_cast<UvTcpImpl*>(handle->data);
-    serverImpl->allocateBuffer(handle, suggestedSize, buf);
+  /*
+   * Closes the shard's handles on its loop, and returns once the loop has
+   * exited, so nothing on it refers to this any more. Called on any thread
+   * but the shard's.
+   */
+  void stopShard() {
+    mShardUvLoopRunner->post([this] {
+      closeShardHandles();
+      mShardUvLoopRunner->drain();
+    });
+
+    mShardUvLoopRunner->waitForExit();
+  }
+
+  void closeShardHandles() {
+    closeHandles();
+
+    uv_close(reinterpret_cast<uv_handle_t*>(&mShardCommandAsync), nullptr);
+  }
+
+  /*
+   * Closes the server, the connections and the receive budget notifier,
+   * without sending packets for the connections. They're freed when they
+   * finish closing, which can be after this is gone, so they stop calling it
+   * now. Called on the loop's thread, or once nothing runs the loop.
+   */
+  void closeHandles() {
+    for (ConnectionSlot& slot : mConnectionSlots) {
+      UvTcpConnection* const connection = slot.connection.release();
+      if (connection == nullptr) {
+        continue;
+      }
+
+      connection->tcpImpl = nullptr;
+
+      const auto uvHandle =
+          reinterpret_cast<uv_handle_t*>(&connection->uvSocket);
+      if (!uv_is_closing(uvHandle)) {
+        uv_close(uvHandle, onConnectionClosedWrapper);
+      }
+    }
+
+    mConnectionSlots.clear();
+    mFreeConnectionSlots.clear();
+
+    if (mTcpServer != nullptr) {
+      uv_close(
+          reinterpret_cast<uv_handle_t*>(mTcpServer),
+          [](uv_handle_t* closedHandle) {
+            delete reinterpret_cast<uv_tcp_t*>(closedHandle);
+          });
+      mTcpServer = nullptr;
+    }
+
+    if (mReceiveBudgetNotifier != nullptr) {
+      mReceiveBudgetNotifier->close();
+      mReceiveBudgetNotifier = nullptr;
+    }
+  }
+
+  /*
+   * Returns true if the packet is for a connection on another shard, after
+   * posting it to that shard.
+   */
+  bool forwardToShards(
+      ShardCommand::Type type,
+      const PathablePacket& pathablePacket) {
+    if (mShards.empty()) {
+      return false;
+    }
+
+    const ResolvedParameters resolved =
+        mConnectionSchema.resolve(pathablePacket.packet.parameters);
+    const json* const connectionId = resolved.get(mConnectionIdSlot);
+    if (!connectionId->is_number_integer()) {
+      return false;
+    }
+
+    const uint32_t shardIndex =
+        getConnectionShard(connectionId->get<TcpConnectionId>());
+    if (shardIndex == mShardIndex || shardIndex > mShards.size()) {
+      return false;
+    }
+
+    mShards[shardIndex - 1]->postCommand(type, pathablePacket);
+    return true;
   }
 
-  void
-  allocateBuffer(uv_handle_t* handle, size_t suggestedSize, uv_buf_t* buf) {
-    buf->base = reinterpret_cast<char*>(mBufferPool.get());
-    buf->len = kBufferSizeInPool;
+  // Called on any thread.
+  void postCommand(ShardCommand::Type type, const PathablePacket& pathablePacket) {
+    ShardCommand command;
+    command.type = type;
+    command.packet = pathablePacket.packet;
+    command.packetPusher = pathablePacket.packetPusher;
+
+    mShardCommands.enqueue(move(command));
+    uv_async_send(&mShardCommandAsync);
   }
 
-  static void onConnectionRemovedWrapper(uv_handle_t* handle) {
+  static void onShardCommandsWrapper(uv_async_t* handle) {
     auto tcpImpl = reinterpret_cast<UvTcpImpl*>(handle->data);
-    tcpImpl->onConnectionRemoved(handle);
+    tcpImpl->onShardCommands();
+  }
+
+  void onShardCommands() {
+    ShardCommand command;
+    while (mShardCommands.try_dequeue(command)) {
+      const PathablePacket pathablePacket(command.packet, command.packetPusher);
+
+      switch (command.type) {
+        case ShardCommand::Type::Listen:
+          listen(pathablePacket);
+          break;
+        case ShardCommand::Type::SendData:
+          sendData(pathablePacket);
+          break;
+        case ShardCommand::Type::Disconnect:
+          disconnect(pathablePacket);
+          break;
+        case ShardCommand::Type::ShutdownSender:
+          shutdownSender(pathablePacket);
+          break;
+        case ShardCommand::Type::PauseReceiving:
+          pauseReceiving(pathablePacket);
+          break;
+        case ShardCommand::Type::ResumeReceiving:
+          resumeReceiving(pathablePacket);
+          break;
+      }
+    }
+  }
+
+  UvTcpConnection* createConnection(int* status) {
+    uint32_t index;
+    if (!mFreeConnectionSlots.empty()) {
+      index = mFreeConnectionSlots.back();
+      mFreeConnectionSlots.pop_back();
+    } else if (mConnectionSlots.size() < kMaxConnectionsPerShard) {
+      index = mConnectionSlots.size();
+      mConnectionSlots.emplace_back();
+    } else {
+      *status = UV_EMFILE;
+      return nullptr;
+    }
+
+    ConnectionSlot& slot = mConnectionSlots[index];
+    slot.connection = make_unique<UvTcpConnection>();
+
+    UvTcpConnection* const connection = slot.connection.get();
+    connection->tcpImpl = this;
+    connection->connectionId =
+        makeConnectionId(slot.generation, mShardIndex, index);
+    connection->inFlightReceiveBuffers = make_shared<InFlightReceiveBuffers>();
+    connection->inFlightReceiveBuffers->connectionId = connection->connectionId;
+    connection->inFlightReceiveBuffers->notifier = mReceiveBudgetNotifier;
+
+    *status = uv_tcp_init(mUvLoop.get(), &connection->uvSocket);
+    if (*status != 0) {
+      releaseConnection(connection);
+      return nullptr;
+    }
+
+    connection->uvSocket.data = connection;
+
+    return connection;
+  }
+
+  void releaseConnection(UvTcpConnection* connection) {
+    const uint32_t index = getConnectionIndex(connection->connectionId);
+    ConnectionSlot& slot = mConnectionSlots[index];
+
+    // Generation 0 is skipped so kNoConnectionId is never a valid id.
+    slot.generation = slot.generation == UINT32_MAX ? 1 : slot.generation + 1;
+    slot.connection.reset();
+    mFreeConnectionSlots.push_back(index);
+  }
+
+  UvTcpConnection* findConnection(TcpConnectionId connectionId) {
+    const uint32_t index = getConnectionIndex(connectionId);
+    if (getConnectionShard(connectionId) != mShardIndex
+        || index >= mConnectionSlots.size()) {
+      return nullptr;
+    }
+
+    const ConnectionSlot& slot = mConnectionSlots[index];
+    if (slot.generation != getConnectionGeneration(connectionId)) {
+      return nullptr;
+    }
+
+    return slot.connection.get();
+  }
+
+  UvTcpConnection* findConnection(const Parameters& parameters) {
+    const ResolvedParameters resolved = mConnectionSchema.resolve(parameters);
+    const json* const connectionId = resolved.get(mConnectionIdSlot);
+    if (!connectionId->is_number_integer()) {
+      return nullptr;
+    }
+
+    return findConnection(connectionId->get<TcpConnectionId>());
+  }
+
+  /*
+   * Sets the connection's parameters and starts receiving. Closes the
+   * connection and sends an error packet on failure.
+   */
+  int establishConnection(
+      UvTcpConnection* connection,
+      const shared_ptr<IPacketPusher>& pusherForErrors) {
+    string remoteAddress;
+    uint16_t remotePort = 0;
+    int status = getRemoteUvAddressAndPort(
+        &connection->uvSocket,
+        pusherForErrors,
+        &remoteAddress,
+        &remotePort);
+    if (status != 0) {
+      closeConnection(connection, "Could not get remote address.");
+      return status;
+    }
+
+    string localAddress;
+    uint16_t localPort = 0;
+    status = getLocalUvAddressAndPort(
+        &connection->uvSocket,
+        pusherForErrors,
+        &localAddress,
+        &localPort);
+    if (status != 0) {
+      closeConnection(connection, "Could not get local address.");
+      return status;
+    }
+
+    json connectionParameters = {
+        {kParameter_TcpConnectionId, connection->connectionId},
+        {kParameter_LocalAddress, localAddress},
+        {kParameter_LocalPort, localPort},
+        {kParameter_RemoteAddress, remoteAddress},
+        {kParameter_RemotePort, remotePort},
+    };
+
+    if (mShardCount > 1) {
+      connectionParameters[kParameter_TcpShard] = mShardIndex;
+    }
+
+    connection->parameters = move(connectionParameters);
+
+    status = startReceiving(connection);
+    if (status != 0) {
+      sendUvErrorPacket(
+          "Failed to start receiving.",
+          status,
+          connection->connectionId,
+          pusherForErrors);
+      closeConnection(connection, "Failed to start receiving.");
+      return status;
+    }
+
+    connection->established = true;
+
+    return 0;
   }
 
-  void onConnectionRemoved(uv_handle_t* handle) {
-    auto lookupByPointerIt = mUvClientToConnection.find(handle);
-    if (lookupByPointerIt == mUvClientToConnection.end()) {
+  void closeConnection(UvTcpConnection* connection, const string& reason) {
+    const auto uvHandle = reinterpret_cast<uv_handle_t*>(&connection->uvSocket);
+    if (uv_is_closing(uvHandle)) {
       return;
     }
 
-    const string connectionId = lookupByPointerIt->second->connectionId;
-    mUvClientToConnection.erase(lookupByPointerIt);
+    connection->closedReason = reason;
+    uv_close(uvHandle, onConnectionClosedWrapper);
+  }
 
-    auto connectionIt = mConnections.find(connectionId);
-    UvTcpConnection connection;
-    if (connectionIt != mConnections.end()) {
-      connection = connectionIt->second;
-      mConnections.erase(connectionIt);
+  int startReceiving(UvTcpConnection* connection) {
+    if (connection->receiving) {
+      return 0;
     }
 
-    Packet closedPacket;
-    setConnectionParameters(connection, &closedPacket.parameters);
-    closedPacket.parameters[kParameter_ClosedReason] = connection.closedReason;
-    mAsyncEventsPacketPusher->pushPacket(
-        move(closedPacket),
-        kChannel_ConnectionClosed);
+    const int status = uv_read_start(
+        reinterpret_cast<uv_stream_t*>(&connection->uvSocket),
+        allocateBufferWrapper,
+        dataReceivedWrapper);
+    connection->receiving = status == 0;
+
+    return status;
   }
 
-  static void onSenderShutdownWrapper(uv_shutdown_t* shutdown, int status) {
-    auto tcpImpl = reinterpret_cast<UvTcpImpl*>(shutdown->data);
-    tcpImpl->onSenderShutdown(shutdown, status);
+  void stopReceiving(UvTcpConnection* connection) {
+    if (!connection->receiving) {
+      return;
+    }
+
+    uv_read_stop(reinterpret_cast<uv_stream_t*>(&connection->uvSocket));
+    connection->receiving = false;
   }
 
-  void onSenderShutdown(uv_shutdown_t* shutdown, int status) {
-    ExtendedShutdownT* extendedShutdown =
-        reinterpret_cast<ExtendedShutdownT*>(shutdown);
-    Cleanup shutdownTCleanup([extendedShutdown]() { free(extendedShutdown); });
+  void checkReceiveBudget(UvTcpConnection* connection) {
+    const auto& inFlight = connection->inFlightReceiveBuffers;
+    if (inFlight->bytes < mReceiveBudget || !connection->receiving) {
+      return;
+    }
+
+    stopReceiving(connection);
+    inFlight->overBudget = true;
 
-    auto lookupByPointerIt = mUvClientToConnection.find(shutdown->handle);
-    if (lookupByPointerIt == mUvClientToConnection.end()) {
+    // Buffers may have been released on another thread before overBudget was
+    // set, in which case nothing else will resume reading.
+    if (inFlight->bytes <= mReceiveBudget / 2
+        && inFlight->overBudget.exchange(false)) {
+      resumeReceivingUnderBudget(connection);
+    }
+  }
+
+  // Called by mReceiveBudgetNotifier on the loop's thread.
+  void onConnectionUnderBudget(
+      const shared_ptr<InFlightReceiveBuffers>& inFlight) {
+    UvTcpConnection* const connection = findConnection(inFlight->connectionId);
+    if (connection == nullptr
+        || connection->inFlightReceiveBuffers != inFlight) {
       return;
     }
 
-    const string connectionId = lookupByPointerIt->second->connectionId;
-    mUvClientToConnection.erase(lookupByPointerIt);
+    resumeReceivingUnderBudget(connection);
+  }
 
+  void resumeReceivingUnderBudget(UvTcpConnection* connection) {
+    const auto uvHandle =
+        reinterpret_cast<uv_handle_t*>(&connection->uvSocket);
+    if (connection->receivingPausedByRequest || uv_is_closing(uvHandle)) {
+      return;
+    }
+
+    const int status = startReceiving(connection);
     if (status != 0) {
       sendUvErrorPacket(
-          "Failed to shutdown sender.",
+          "Failed to resume receiving.",
           status,
-          connectionId,
-          extendedShutdown->packetPusher);
+          connection->connectionId,
+          mAsyncEventsPacketPusher);
+    }
+  }
+
+  static void allocateBufferWrapper(
+      uv_handle_t* handle,
+      size_t suggestedSize,
+      uv_buf_t* buf) {
+    auto connection = reinterpret_cast<UvTcpConnection*>(handle->data);
+    connection->tcpImpl->allocateBuffer(suggestedSize, buf);
+  }
+
+  void allocateBuffer(size_t suggestedSize, uv_buf_t* buf) {
+    size_t allocatedSize;
+    buf->base = reinterpret_cast<char*>(
+        mReceiveBufferPool.allocate(suggestedSize, &allocatedSize));
+    buf->len = allocatedSize;
+  }
+
+  static void onConnectionClosedWrapper(uv_handle_t* handle) {
+    auto connection = reinterpret_cast<UvTcpConnection*>(handle->data);
+    if (connection->tcpImpl == nullptr) {
+      delete connection;
       return;
     }
 
-    auto connectionIt = mConnections.find(connectionId);
-    UvTcpConnection connection;
-    if (connectionIt != mConnections.end()) {
-      connection = connectionIt->second;
-      mConnections.erase(connectionIt);
+    connection->tcpImpl->onConnectionClosed(connection);
+  }
+
+  void onConnectionClosed(UvTcpConnection* connection) {
+    if (connection->established) {
+      Packet closedPacket;
+      closedPacket.parameters[kParameter_ClosedReason] =
+          connection->closedReason;
+      closedPacket.parameters.inheritFrom(connection->parameters);
+      mAsyncEventsPacketPusher->pushPacket(
+          move(closedPacket),
+          kChannel_ConnectionClosed);
     }
 
-    Packet closedPacket;
-    setConnectionParameters(connection, &closedPacket.parameters);
-    extendedShutdown->packetPusher->pushPacket(
-        move(closedPacket),
-        kChannel_SenderShutdown);
+    releaseConnection(connection);
   }
-};
 
-atomic_uint64_t UvTcpImpl::atomicConnectionIndex;
-once_flag UvTcpImpl::initAtomicConnectionIndexOnce;
+  static void onSenderShutdownWrapper(uv_shutdown_t* shutdown, int status) {
+    auto connection = reinterpret_cast<UvTcpConnection*>(shutdown->handle->data);
+    if (connection->tcpImpl == nullptr) {
+      delete reinterpret_cast<ExtendedShutdownT*>(shutdown);
+      return;
+    }
+
+    connection->tcpImpl->onSenderShutdown(
+        connection,
+        reinterpret_cast<ExtendedShutdownT*>(shutdown),
+        status);
+  }
+
+  void onSenderShutdown(
+      UvTcpConnection* connection,
+      ExtendedShutdownT* shutdown,
+      int status) {
+    const shared_ptr<IPacketPusher> packetPusher = shutdown->packetPusher;
+    delete shutdown;
+
+    if (status != 0) {
+      sendUvErrorPacket(
+          "Failed to shutdown sender.",
+          status,
+          connection->connectionId,
+          packetPusher);
+      return;
+    }
+
+    // The connection stays open to receive until the remote side closes it.
+    Packet shutdownPacket;
+    shutdownPacket.parameters = connection->parameters;
+    packetPusher->pushPacket(move(shutdownPacket), kChannel_SenderShutdown);
+  }
+};
 
 class UvTcpConnector : public IPathable, public IImplementation {
  public:
@@ -1019,6 +1814,40 @@ class UvTcpDisconnector : public IPathable, public IImplementation {
   const shared_ptr<UvTcpImpl> mTcp;
 };
 
+class UvTcpPauseReceiving : public IPathable, public IImplementation {
+ public:
+  UvTcpPauseReceiving(const shared_ptr<UvTcpImpl>& tcp) : mTcp(tcp) {}
+  ~UvTcpPauseReceiving() override = default;
+
+  void handlePacket(const PathablePacket& pathablePacket) override {
+    mTcp->pauseReceiving(pathablePacket);
+  }
+
+  IPathable* asPathable() override { return this; }
+  ISource* asSource() override { return nullptr; }
+  IGroup* asGroup() override { return nullptr; }
+
+ private:
+  const shared_ptr<UvTcpImpl> mTcp;
+};
+
+class UvTcpResumeReceiving : public IPathable, public IImplementation {
+ public:
+  UvTcpResumeReceiving(const shared_ptr<UvTcpImpl>& tcp) : mTcp(tcp) {}
+  ~UvTcpResumeReceiving() override = default;
+
+  void handlePacket(const PathablePacket& pathablePacket) override {
+    mTcp->resumeReceiving(pathablePacket);
+  }
+
+  IPathable* asPathable() override { return this; }
+  ISource* asSource() override { return nullptr; }
+  IGroup* asGroup() override { return nullptr; }
+
+ private:
+  const shared_ptr<UvTcpImpl> mTcp;
+};
+
 class UvTcpReceiver : public ISource, public IImplementation {
  public:
   UvTcpReceiver(const shared_ptr<UvTcpImpl>& tcp) : mTcp(tcp) {}
@@ -1079,6 +1908,10 @@ UvTcpConnectionGroup::UvTcpConnectionGroup(
   mInterfaces[kNodeName_Disconnector] = make_shared<UvTcpDisconnector>(mImpl);
   mInterfaces[kNodeName_ShutdownSender] =
       make_shared<UvTcpShutdownSender>(mImpl);
+  mInterfaces[kNodeName_PauseReceiving] =
+      make_shared<UvTcpPauseReceiving>(mImpl);
+  mInterfaces[kNodeName_ResumeReceiving] =
+      make_shared<UvTcpResumeReceiving>(mImpl);
 }
 
 size_t UvTcpConnectionGroup::getInterfaceCount() { return mInterfaces.size(); }
@@ -1097,6 +1930,12 @@ string UvTcpConnectionGroup::getInterfaceName(size_t nodeIndex) {
       return kNodeName_Receiver;
     case 5:
       return kNodeName_Disconnector;
+    case 6:
+      return kNodeName_ShutdownSender;
+    case 7:
+      return kNodeName_PauseReceiving;
+    case 8:
+      return kNodeName_ResumeReceiving;
     default:
       throw runtime_error("Invalid node index: " + to_string(nodeIndex));
   }
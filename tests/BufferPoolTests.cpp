@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <thread>
+
 #include "gtest/gtest.h"
 #include "maplang/BufferFactory.h"
 #include "maplang/BufferPool.h"
@@ -122,4 +124,57 @@ TEST(
   ASSERT_EQ(2, buffer3.length);
 }
 
+TEST(WhenBuffersOfDifferentSizesAreRequested, SmallerBuffersAreStillReused) {
+  BufferPool pool(make_shared<BufferFactory>());
+
+  auto smallBuffer = pool.get(100);
+  uint8_t* const rawSmallBuffer = smallBuffer.data.get();
+  smallBuffer.data.reset();
+
+  auto largeBuffer = pool.get(100000);
+  largeBuffer.data.reset();
+
+  const auto smallBuffer2 = pool.get(120);
+  ASSERT_EQ(rawSmallBuffer, smallBuffer2.data.get());
+  ASSERT_EQ(120, smallBuffer2.length);
+}
+
+TEST(WhenABufferIsReturnedOnAnotherThread, ItIsReused) {
+  BufferPool pool(make_shared<BufferFactory>());
+
+  auto buffer1 = pool.get(1);
+  uint8_t* const rawBuffer1 = buffer1.data.get();
+
+  // The thread's cached buffers are shared when it exits.
+  thread releasingThread([&buffer1] { buffer1.data.reset(); });
+  releasingThread.join();
+
+  const auto buffer2 = pool.get(1);
+  ASSERT_EQ(rawBuffer1, buffer2.data.get());
+}
+
+TEST(WhenMoreThanMaxRetainedBytesAreReturned, TheRestAreFreed) {
+  BufferPool pool(make_shared<BufferFactory>(), 1024);
+
+  auto buffer1 = pool.get(1024);
+  auto buffer2 = pool.get(1024);
+  buffer1.data.reset();
+  buffer2.data.reset();
+
+  ASSERT_EQ(1024, pool.getRetainedBytes());
+}
+
+TEST(WhenABufferPoolIsUsedAsABufferFactory, ItReturnsPooledBuffers) {
+  const shared_ptr<const IBufferFactory> bufferFactory =
+      make_shared<BufferPool>(make_shared<BufferFactory>());
+
+  auto buffer1 = bufferFactory->Create(10);
+  uint8_t* const rawBuffer1 = buffer1.data.get();
+  buffer1.data.reset();
+
+  const auto buffer2 = bufferFactory->Create(10);
+  ASSERT_EQ(rawBuffer1, buffer2.data.get());
+  ASSERT_EQ(10, buffer2.length);
+}
+
 }  // namespace maplang
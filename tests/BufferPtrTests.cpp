@@ -0,0 +1,91 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gtest/gtest.h"
+#include "maplang/Buffer.h"
+#include "maplang/BufferPtr.h"
+
+using namespace std;
+
+namespace maplang {
+
+TEST(BufferPtrTests, WhenABufferIsCopied_ItSharesTheReferenceCount) {
+  const BufferPtr buffer = BufferPtr::make(16);
+  ASSERT_EQ(1, buffer.use_count());
+
+  {
+    const BufferPtr copy = buffer;
+
+    ASSERT_EQ(buffer, copy);
+    ASSERT_EQ(2, buffer.use_count());
+  }
+
+  ASSERT_EQ(1, buffer.use_count());
+}
+
+TEST(BufferPtrTests, WhenABufferIsSliced_TheSliceSharesOwnership) {
+  Buffer buffer("hello");
+
+  const Buffer slice = buffer.slice(1, 3);
+  buffer = Buffer();
+
+  ASSERT_EQ(1, slice.data.use_count());
+  ASSERT_EQ("ell", string(reinterpret_cast<char*>(slice.data.get()), 3));
+}
+
+TEST(BufferPtrTests, WhenTheLastReferenceIsReleased_TheDeleterIsCalled) {
+  uint8_t bytes[4];
+  uint8_t* deletedBytes = nullptr;
+
+  BufferPtr buffer(bytes, [&deletedBytes](uint8_t* data) {
+    deletedBytes = data;
+  });
+  BufferPtr copy = buffer;
+
+  buffer.reset();
+  ASSERT_EQ(nullptr, deletedBytes);
+
+  copy = nullptr;
+  ASSERT_EQ(bytes, deletedBytes);
+}
+
+TEST(BufferPtrTests, WhenASharedPtrIsAssigned_ItKeepsTheSharedPtrsBytes) {
+  const auto sharedBytes =
+      shared_ptr<uint8_t>(new uint8_t[4], default_delete<uint8_t[]>());
+
+  Buffer buffer;
+  buffer.data = sharedBytes;
+
+  ASSERT_EQ(sharedBytes.get(), buffer.data.get());
+  ASSERT_EQ(2, sharedBytes.use_count());
+
+  buffer.data.reset();
+  ASSERT_EQ(1, sharedBytes.use_count());
+}
+
+TEST(BufferPtrTests, WhenAThreadConfinedBufferIsCopied_ItIsCounted) {
+  BufferPtr buffer = BufferPtr::makeThreadConfined(16);
+  BufferPtr copy = buffer;
+
+  ASSERT_EQ(2, copy.use_count());
+
+  buffer.reset();
+
+  ASSERT_EQ(1, copy.use_count());
+  ASSERT_NE(nullptr, copy);
+}
+
+}  // namespace maplang
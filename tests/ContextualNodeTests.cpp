@@ -0,0 +1,450 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <maplang/LambdaPathable.h>
+
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <set>
+
+#include "gtest/gtest.h"
+#include "maplang/DataGraph.h"
+#include "maplang/FactoriesBuilder.h"
+#include "maplang/ImplementationFactoryBuilder.h"
+#include "maplang/LambdaPacketPusher.h"
+#include "nodes/ContextualNode.h"
+
+using namespace std;
+
+namespace maplang {
+
+struct InstanceCounts {
+  atomic<size_t> created = 0;
+  atomic<size_t> reset = 0;
+  atomic<size_t> destroyed = 0;
+};
+
+// Passes packets through on "out", and counts creations and resets.
+class CountingResettable final : public IImplementation,
+                                 public IPathable,
+                                 public IResettable {
+ public:
+  explicit CountingResettable(const shared_ptr<InstanceCounts>& counts)
+      : mCounts(counts) {
+    mCounts->created++;
+  }
+
+  ~CountingResettable() override { mCounts->destroyed++; }
+
+  void handlePacket(const PathablePacket& packet) override {
+    packet.packetPusher->pushPacket(packet.packet, "out");
+  }
+
+  void reset() override { mCounts->reset++; }
+
+  IPathable* asPathable() override { return this; }
+  ISource* asSource() override { return nullptr; }
+  IGroup* asGroup() override { return nullptr; }
+  IResettable* asResettable() override { return this; }
+
+ private:
+  const shared_ptr<InstanceCounts> mCounts;
+};
+
+static Factories createFactories(const shared_ptr<InstanceCounts>& counts) {
+  auto implementationFactoryBuilder =
+      make_shared<ImplementationFactoryBuilder>();
+  implementationFactoryBuilder->WithFactoryForName(
+      "Counting Resettable",
+      [counts](const Factories& factories, const nlohmann::json&) {
+        return make_shared<CountingResettable>(counts);
+      });
+
+  return FactoriesBuilder()
+      .WithImplementationFactoryBuilder(implementationFactoryBuilder)
+      .BuildFactories();
+}
+
+class ContextualNodeTests : public testing::Test {
+ public:
+  ContextualNodeTests()
+      : mInstanceCounts(make_shared<InstanceCounts>()),
+        mDataGraph(make_shared<DataGraph>(createFactories(mInstanceCounts))) {}
+
+  /*
+   * Contextual Pass-through nodes, keyed by "id", which output on "out" to
+   * |sink|. The Context Remover's "Removed Key" channel goes to
+   * |removedKeySink|, and the router's "Context Evicted" channel goes to
+   * |evictedKeySink|. |extraInitParameters| are added to the Contextual
+   * node's init parameters.
+   */
+  void createContextualGraph(
+      const nlohmann::json& extraInitParameters,
+      const shared_ptr<IImplementation>& sink,
+      const shared_ptr<IImplementation>& removedKeySink,
+      const shared_ptr<IImplementation>& evictedKeySink =
+          make_shared<LambdaPathable>([](const PathablePacket& packet) {})) {
+    nlohmann::json initParameters = {
+        {"type", "Pass-through"},
+        {"key", "id"},
+        {"outputChannel", "out"}};
+    initParameters.update(extraInitParameters);
+
+    mDataGraph->setInstanceInitParameters("contextual", initParameters);
+    mDataGraph->setInstanceType("contextual", "Contextual");
+
+    mDataGraph->createNode("router", true, true);
+    mDataGraph->createNode("remover", true, true);
+    mDataGraph->createNode("sink", true, false);
+    mDataGraph->createNode("removed key sink", true, false);
+    mDataGraph->createNode("evicted key sink", true, false);
+
+    mDataGraph->setNodeInstance("router", "router instance");
+    mDataGraph->setNodeInstance("remover", "remover instance");
+    mDataGraph->setNodeInstance("sink", "sink instance");
+    mDataGraph->setNodeInstance("removed key sink", "removed key instance");
+    mDataGraph->setNodeInstance("evicted key sink", "evicted key instance");
+
+    mDataGraph->setInstanceImplementationToGroupInterface(
+        "router instance",
+        "contextual",
+        "Context Router");
+    mDataGraph->setInstanceImplementationToGroupInterface(
+        "remover instance",
+        "contextual",
+        "Context Remover");
+    mDataGraph->setInstanceImplementation("sink instance", sink);
+    mDataGraph->setInstanceImplementation(
+        "removed key instance",
+        removedKeySink);
+    mDataGraph->setInstanceImplementation(
+        "evicted key instance",
+        evictedKeySink);
+
+    mDataGraph->connect("router", "out", "sink");
+    mDataGraph->connect("remover", "Removed Key", "removed key sink");
+    mDataGraph->connect("router", "Context Evicted", "evicted key sink");
+
+    mDataGraph->startGraph();
+  }
+
+  const shared_ptr<InstanceCounts> mInstanceCounts;
+  const std::shared_ptr<DataGraph> mDataGraph;
+};
+
+TEST_F(
+    ContextualNodeTests,
+    WhenContextsAreSharded_PacketsReachTheirInstancesWithTheirParameters) {
+  static constexpr size_t kContextCount = 16;
+  static constexpr size_t kPacketsPerContext = 10;
+  static constexpr size_t kPacketCount = kContextCount * kPacketsPerContext;
+
+  atomic<size_t> receivedPacketCount = 0;
+  atomic<size_t> mismatchedPacketCount = 0;
+  promise<void> allPacketsReceived;
+
+  auto sink = make_shared<LambdaPathable>([&](const PathablePacket& packet) {
+    const Parameters& parameters = packet.packet.parameters;
+    if (parameters["index"].get<size_t>() % kContextCount
+        != parameters["id"].get<size_t>()) {
+      mismatchedPacketCount++;
+    }
+
+    if (++receivedPacketCount == kPacketCount) {
+      allPacketsReceived.set_value();
+    }
+  });
+
+  auto removedKeySink =
+      make_shared<LambdaPathable>([](const PathablePacket& packet) {});
+
+  createContextualGraph({{"shards", 4}}, sink, removedKeySink);
+
+  for (size_t i = 0; i < kPacketCount; i++) {
+    Packet packet;
+    packet.parameters["id"] = i % kContextCount;
+    packet.parameters["index"] = i;
+    mDataGraph->sendPacket(packet, "router");
+  }
+
+  ASSERT_EQ(
+      future_status::ready,
+      allPacketsReceived.get_future().wait_for(chrono::seconds(10)));
+  ASSERT_EQ(0, mismatchedPacketCount);
+}
+
+TEST_F(
+    ContextualNodeTests,
+    WhenAShardedContextIsRemoved_RemovedKeyIsSentOnlyIfItExisted) {
+  promise<void> packetReceived;
+  auto sink = make_shared<LambdaPathable>(
+      [&packetReceived](const PathablePacket& packet) {
+        packetReceived.set_value();
+      });
+
+  mutex removedKeysMutex;
+  multiset<string> removedKeys;
+  auto removedKeySink = make_shared<LambdaPathable>(
+      [&removedKeys, &removedKeysMutex](const PathablePacket& packet) {
+        lock_guard<mutex> lock(removedKeysMutex);
+        removedKeys.insert(packet.packet.parameters["id"].get<string>());
+      });
+
+  createContextualGraph({{"shards", 4}}, sink, removedKeySink);
+
+  Packet packet;
+  packet.parameters["id"] = "existing";
+  mDataGraph->sendPacket(packet, "router");
+  ASSERT_EQ(
+      future_status::ready,
+      packetReceived.get_future().wait_for(chrono::seconds(10)));
+
+  Packet removeExisting;
+  removeExisting.parameters["id"] = "existing";
+  mDataGraph->sendPacket(removeExisting, "remover");
+
+  Packet removeMissing;
+  removeMissing.parameters["id"] = "missing";
+  mDataGraph->sendPacket(removeMissing, "remover");
+
+  usleep(100000);
+
+  lock_guard<mutex> lock(removedKeysMutex);
+  ASSERT_EQ(multiset<string>({"existing"}), removedKeys);
+}
+
+TEST_F(
+    ContextualNodeTests,
+    WhenThereAreMoreThanMaxInstances_TheLeastRecentlyUsedIsEvicted) {
+  mutex evictedKeysMutex;
+  vector<string> evictedKeys;
+  auto evictedKeySink = make_shared<LambdaPathable>(
+      [&evictedKeys, &evictedKeysMutex](const PathablePacket& packet) {
+        lock_guard<mutex> lock(evictedKeysMutex);
+        evictedKeys.push_back(packet.packet.parameters["id"].get<string>());
+      });
+
+  auto ignored = make_shared<LambdaPathable>([](const PathablePacket&) {});
+  createContextualGraph(
+      {{"maxInstances", 2}},
+      ignored,
+      ignored,
+      evictedKeySink);
+
+  for (const string id : {"a", "b", "a", "c", "a", "d"}) {
+    Packet packet;
+    packet.parameters["id"] = id;
+    mDataGraph->sendPacket(packet, "router");
+  }
+
+  usleep(100000);
+
+  lock_guard<mutex> lock(evictedKeysMutex);
+  ASSERT_EQ(vector<string>({"b", "c"}), evictedKeys);
+}
+
+TEST_F(ContextualNodeTests, WhenAShardedContextIsIdle_ItIsEvicted) {
+  promise<string> evictedKey;
+  auto evictedKeySink = make_shared<LambdaPathable>(
+      [&evictedKey](const PathablePacket& packet) {
+        evictedKey.set_value(packet.packet.parameters["id"].get<string>());
+      });
+
+  auto ignored = make_shared<LambdaPathable>([](const PathablePacket&) {});
+  createContextualGraph(
+      {{"shards", 2}, {"idleTimeoutMs", 20}},
+      ignored,
+      ignored,
+      evictedKeySink);
+
+  Packet packet;
+  packet.parameters["id"] = "idle";
+  mDataGraph->sendPacket(packet, "router");
+
+  auto evictedKeyFuture = evictedKey.get_future();
+  ASSERT_EQ(
+      future_status::ready,
+      evictedKeyFuture.wait_for(chrono::seconds(10)));
+  ASSERT_EQ("idle", evictedKeyFuture.get());
+}
+
+TEST_F(
+    ContextualNodeTests,
+    WhenTheKeyIsAJsonPointer_RemovedAndEvictedKeysAreAtThePointer) {
+  mutex keysMutex;
+  vector<string> removedKeys;
+  vector<string> evictedKeys;
+  auto removedKeySink = make_shared<LambdaPathable>(
+      [&removedKeys, &keysMutex](const PathablePacket& packet) {
+        lock_guard<mutex> lock(keysMutex);
+        removedKeys.push_back(
+            packet.packet.parameters["connection"]["id"].get<string>());
+      });
+  auto evictedKeySink = make_shared<LambdaPathable>(
+      [&evictedKeys, &keysMutex](const PathablePacket& packet) {
+        lock_guard<mutex> lock(keysMutex);
+        evictedKeys.push_back(
+            packet.packet.parameters["connection"]["id"].get<string>());
+      });
+
+  auto ignored = make_shared<LambdaPathable>([](const PathablePacket&) {});
+  createContextualGraph(
+      {{"key", "/connection/id"}, {"maxInstances", 1}},
+      ignored,
+      removedKeySink,
+      evictedKeySink);
+
+  for (const string id : {"a", "b"}) {
+    Packet packet;
+    packet.parameters["connection"] = {{"id", id}};
+    mDataGraph->sendPacket(packet, "router");
+  }
+
+  Packet remove;
+  remove.parameters["connection"] = {{"id", "b"}};
+  mDataGraph->sendPacket(remove, "remover");
+
+  usleep(100000);
+
+  lock_guard<mutex> lock(keysMutex);
+  ASSERT_EQ(vector<string>({"a"}), evictedKeys);
+  ASSERT_EQ(vector<string>({"b"}), removedKeys);
+}
+
+TEST_F(ContextualNodeTests, WhenAContextIsRemoved_ItsInstanceIsReused) {
+  mutex receivedMutex;
+  condition_variable receivedCv;
+  size_t receivedCount = 0;
+  size_t removedCount = 0;
+
+  auto sink = make_shared<LambdaPathable>([&](const PathablePacket& packet) {
+    lock_guard<mutex> lock(receivedMutex);
+    receivedCount++;
+    receivedCv.notify_all();
+  });
+
+  auto removedKeySink =
+      make_shared<LambdaPathable>([&](const PathablePacket& packet) {
+        lock_guard<mutex> lock(receivedMutex);
+        removedCount++;
+        receivedCv.notify_all();
+      });
+
+  createContextualGraph(
+      {{"type", "Counting Resettable"}, {"shards", 1}},
+      sink,
+      removedKeySink);
+
+  // The Contextual node creates one instance as a template.
+  const size_t templateInstanceCount = mInstanceCounts->created;
+
+  const auto waitFor = [&](const size_t& count, size_t expected) {
+    unique_lock<mutex> lock(receivedMutex);
+    return receivedCv.wait_for(lock, chrono::seconds(10), [&] {
+      return count == expected;
+    });
+  };
+
+  Packet first;
+  first.parameters["id"] = "first";
+  mDataGraph->sendPacket(first, "router");
+  ASSERT_TRUE(waitFor(receivedCount, 1));
+
+  mDataGraph->sendPacket(first, "remover");
+  ASSERT_TRUE(waitFor(removedCount, 1));
+
+  Packet second;
+  second.parameters["id"] = "second";
+  mDataGraph->sendPacket(second, "router");
+  ASSERT_TRUE(waitFor(receivedCount, 2));
+
+  ASSERT_EQ(templateInstanceCount + 1, mInstanceCounts->created);
+  ASSERT_EQ(1, mInstanceCounts->reset);
+}
+
+TEST(ContextualNodeShardTests, WhenAShardedNodeIsDestroyed_ItsInstancesAreDestroyed) {
+  const auto counts = make_shared<InstanceCounts>();
+  const Factories factories = createFactories(counts);
+
+  mutex receivedMutex;
+  condition_variable receivedCv;
+  size_t receivedCount = 0;
+  const auto packetPusher = make_shared<LambdaPacketPusher>(
+      [&](const Packet& packet, const string& channel) {
+        lock_guard<mutex> lock(receivedMutex);
+        receivedCount++;
+        receivedCv.notify_all();
+      });
+
+  auto contextualNode = make_shared<ContextualNode>(
+      factories,
+      nlohmann::json {
+          {"type", "Counting Resettable"},
+          {"key", "id"},
+          {"shards", 2},
+          {"idleTimeoutMs", 60000}});
+  auto router = contextualNode->getInterface("Context Router");
+
+  for (const string id : {"a", "b", "c", "d"}) {
+    Packet packet;
+    packet.parameters["id"] = id;
+    router->asPathable()->handlePacket(PathablePacket(packet, packetPusher));
+  }
+
+  {
+    unique_lock<mutex> lock(receivedMutex);
+    ASSERT_TRUE(receivedCv.wait_for(lock, chrono::seconds(10), [&] {
+      return receivedCount == 4;
+    }));
+  }
+
+  router.reset();
+  contextualNode.reset();
+
+  ASSERT_EQ(counts->created, counts->destroyed);
+}
+
+TEST(
+    ContextualNodeShardTests,
+    WhenIdleEvictionIsEnabledWithoutASubgraphContext_PacketsAreDelivered) {
+  const auto counts = make_shared<InstanceCounts>();
+  const Factories factories = createFactories(counts);
+
+  size_t receivedCount = 0;
+  const auto packetPusher = make_shared<LambdaPacketPusher>(
+      [&receivedCount](const Packet& packet, const string& channel) {
+        receivedCount++;
+      });
+
+  const auto contextualNode = make_shared<ContextualNode>(
+      factories,
+      nlohmann::json {
+          {"type", "Counting Resettable"},
+          {"key", "id"},
+          {"idleTimeoutMs", 20}});
+  const auto router = contextualNode->getInterface("Context Router");
+
+  for (const string id : {"a", "b", "a"}) {
+    Packet packet;
+    packet.parameters["id"] = id;
+    router->asPathable()->handlePacket(PathablePacket(packet, packetPusher));
+  }
+
+  ASSERT_EQ(3, receivedCount);
+}
+
+}  // namespace maplang
@@ -16,6 +16,10 @@
 
 #include <maplang/LambdaPathable.h>
 
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <set>
 #include <thread>
 
 #include "gtest/gtest.h"
@@ -27,6 +31,13 @@ using namespace std;
 
 namespace maplang {
 
+class StatelessLambdaPathable final : public LambdaPathable {
+ public:
+  using LambdaPathable::LambdaPathable;
+
+  bool isStateless() const override { return true; }
+};
+
 class DataGraphTests : public testing::Test {
  public:
   DataGraphTests()
@@ -403,4 +414,294 @@ TEST_F(
   ASSERT_EQ(asyncThreadId, directThreadId);
 }
 
+TEST_F(
+    DataGraphTests,
+    WhenAThreadGroupQueueIsFullAndDropsNewest_ExtraPacketsAreDropped) {
+  const string testChannel = "test channel";
+
+  atomic<size_t> receivedPacketCount = 0;
+  promise<void> firstPacketReceived;
+  promise<void> releaseSink;
+  shared_future<void> sinkReleased = releaseSink.get_future().share();
+
+  auto source = make_shared<SimpleSource>();
+  auto lambdaSink = make_shared<LambdaPathable>(
+      [&receivedPacketCount, &firstPacketReceived, sinkReleased](
+          const PathablePacket& packet) {
+        if (receivedPacketCount++ == 0) {
+          firstPacketReceived.set_value();
+          sinkReleased.wait();
+        }
+      });
+
+  mDataGraph->createNode("source", false, true);
+  mDataGraph->createNode("sink", true, false);
+
+  mDataGraph->setNodeInstance("source", "source instance");
+  mDataGraph->setNodeInstance("sink", "sink instance");
+
+  mDataGraph->connect("source", testChannel, "sink");
+
+  mDataGraph->setInstanceImplementation("source instance", source);
+  mDataGraph->setInstanceImplementation("sink instance", lambdaSink);
+
+  mDataGraph->setThreadGroupForInstance("sink instance", "test");
+  mDataGraph->setThreadGroupQueueLimit(
+      "test",
+      2,
+      QueueOverflowPolicy::DropNewest);
+
+  mDataGraph->startGraph();
+
+  // The sink holds the first packet, so the rest wait in the queue.
+  source->sendPacket(Packet(), testChannel);
+  firstPacketReceived.get_future().wait();
+
+  for (size_t i = 0; i < 5; i++) {
+    source->sendPacket(Packet(), testChannel);
+  }
+
+  releaseSink.set_value();
+  usleep(100000);
+
+  ASSERT_EQ(3, receivedPacketCount);
+}
+
+TEST_F(
+    DataGraphTests,
+    WhenAThreadGroupQueueIsFullAndRoutesToOverflow_ExtraPacketsGoToOverflow) {
+  const string testChannel = "test channel";
+
+  atomic<size_t> receivedPacketCount = 0;
+  atomic<size_t> overflowPacketCount = 0;
+  promise<void> firstPacketReceived;
+  promise<void> releaseSink;
+  shared_future<void> sinkReleased = releaseSink.get_future().share();
+
+  auto source = make_shared<SimpleSource>();
+  auto lambdaSink = make_shared<LambdaPathable>(
+      [&receivedPacketCount, &firstPacketReceived, sinkReleased](
+          const PathablePacket& packet) {
+        if (receivedPacketCount++ == 0) {
+          firstPacketReceived.set_value();
+          sinkReleased.wait();
+        }
+      });
+
+  auto overflowSink = make_shared<LambdaPathable>(
+      [&overflowPacketCount](const PathablePacket& packet) {
+        overflowPacketCount++;
+      });
+
+  mDataGraph->createNode("source", false, true);
+  mDataGraph->createNode("sink", true, false);
+  mDataGraph->createNode("overflow sink", true, false);
+
+  mDataGraph->setNodeInstance("source", "source instance");
+  mDataGraph->setNodeInstance("sink", "sink instance");
+  mDataGraph->setNodeInstance("overflow sink", "overflow sink instance");
+
+  mDataGraph->connect("source", testChannel, "sink");
+  mDataGraph->connect("source", DataGraph::kChannel_Overflow, "overflow sink");
+
+  mDataGraph->setInstanceImplementation("source instance", source);
+  mDataGraph->setInstanceImplementation("sink instance", lambdaSink);
+  mDataGraph->setInstanceImplementation("overflow sink instance", overflowSink);
+
+  mDataGraph->setThreadGroupForInstance("sink instance", "test");
+  mDataGraph->setThreadGroupQueueLimit(
+      "test",
+      1,
+      QueueOverflowPolicy::RouteToOverflowChannel);
+
+  mDataGraph->startGraph();
+
+  source->sendPacket(Packet(), testChannel);
+  firstPacketReceived.get_future().wait();
+
+  for (size_t i = 0; i < 3; i++) {
+    source->sendPacket(Packet(), testChannel);
+  }
+
+  releaseSink.set_value();
+  usleep(100000);
+
+  ASSERT_EQ(2, receivedPacketCount);
+  ASSERT_EQ(2, overflowPacketCount);
+}
+
+TEST_F(
+    DataGraphTests,
+    WhenManyPacketsAreQueuedFromAnotherThread_TheyAllArriveInOrder) {
+  const string testChannel = "test channel";
+  static constexpr size_t kPacketCount = 10000;
+
+  atomic<size_t> receivedPacketCount = 0;
+  atomic<bool> receivedOutOfOrder = false;
+  promise<void> allPacketsReceived;
+
+  auto source = make_shared<SimpleSource>();
+  auto lambdaSink = make_shared<LambdaPathable>(
+      [&receivedPacketCount, &receivedOutOfOrder, &allPacketsReceived](
+          const PathablePacket& packet) {
+        const size_t index = packet.packet.parameters["index"].get<size_t>();
+        if (index != receivedPacketCount) {
+          receivedOutOfOrder = true;
+        }
+
+        if (++receivedPacketCount == kPacketCount) {
+          allPacketsReceived.set_value();
+        }
+      });
+
+  mDataGraph->createNode("source", false, true);
+  mDataGraph->createNode("sink", true, false);
+
+  mDataGraph->setNodeInstance("source", "source instance");
+  mDataGraph->setNodeInstance("sink", "sink instance");
+
+  mDataGraph->connect("source", testChannel, "sink");
+
+  mDataGraph->setInstanceImplementation("source instance", source);
+  mDataGraph->setInstanceImplementation("sink instance", lambdaSink);
+
+  mDataGraph->startGraph();
+
+  for (size_t i = 0; i < kPacketCount; i++) {
+    Packet packet;
+    packet.parameters["index"] = i;
+    source->sendPacket(packet, testChannel);
+  }
+
+  ASSERT_EQ(
+      future_status::ready,
+      allPacketsReceived.get_future().wait_for(chrono::seconds(10)));
+  ASSERT_FALSE(receivedOutOfOrder);
+}
+
+TEST_F(
+    DataGraphTests,
+    WhenWorkersHoldAFullQueueAndItDropsOldest_NewPacketsAreDropped) {
+  const string testChannel = "test channel";
+
+  atomic<size_t> receivedPacketCount = 0;
+  promise<void> firstPacketReceived;
+  promise<void> releaseNode;
+  shared_future<void> nodeReleased = releaseNode.get_future().share();
+
+  auto source = make_shared<SimpleSource>();
+  auto statelessNode = make_shared<StatelessLambdaPathable>(
+      [&receivedPacketCount, &firstPacketReceived, nodeReleased](
+          const PathablePacket& packet) {
+        if (receivedPacketCount++ == 0) {
+          firstPacketReceived.set_value();
+          nodeReleased.wait();
+        }
+      });
+
+  mDataGraph->createNode("source", false, true);
+  mDataGraph->createNode("stateless", true, false);
+
+  mDataGraph->setNodeInstance("source", "source instance");
+  mDataGraph->setNodeInstance("stateless", "stateless instance");
+
+  mDataGraph->connect("source", testChannel, "stateless");
+
+  mDataGraph->setInstanceImplementation("source instance", source);
+  mDataGraph->setInstanceImplementation("stateless instance", statelessNode);
+
+  mDataGraph->setThreadGroupForInstance("stateless instance", "workers");
+  mDataGraph->setThreadGroupWorkerCount("workers", 1);
+  mDataGraph->setThreadGroupQueueLimit(
+      "workers",
+      2,
+      QueueOverflowPolicy::DropOldest);
+
+  mDataGraph->startGraph();
+
+  // The only worker holds the first packet, so the next two fill the queue
+  // on the worker pool, where they can't be dropped.
+  source->sendPacket(Packet(), testChannel);
+  firstPacketReceived.get_future().wait();
+
+  for (size_t i = 0; i < 5; i++) {
+    source->sendPacket(Packet(), testChannel);
+  }
+
+  releaseNode.set_value();
+  usleep(100000);
+
+  ASSERT_EQ(3, receivedPacketCount);
+}
+
+TEST_F(
+    DataGraphTests,
+    WhenAThreadGroupHasWorkers_StatelessNodesRunInParallelAndKeepParameters) {
+  const string testChannel = "test channel";
+  static constexpr size_t kPacketCount = 8;
+
+  mutex workerThreadIdsMutex;
+  set<thread::id> workerThreadIds;
+  atomic<size_t> receivedPacketCount = 0;
+  atomic<size_t> packetsWithIndexCount = 0;
+  promise<void> allPacketsReceived;
+
+  auto source = make_shared<SimpleSource>();
+  auto statelessNode = make_shared<StatelessLambdaPathable>(
+      [&workerThreadIds, &workerThreadIdsMutex](const PathablePacket& packet) {
+        this_thread::sleep_for(chrono::milliseconds(20));
+
+        {
+          lock_guard<mutex> lock(workerThreadIdsMutex);
+          workerThreadIds.insert(this_thread::get_id());
+        }
+
+        packet.packetPusher->pushPacket(Packet(), "out");
+      });
+
+  auto lambdaSink = make_shared<LambdaPathable>(
+      [&receivedPacketCount, &packetsWithIndexCount, &allPacketsReceived](
+          const PathablePacket& packet) {
+        if (packet.packet.parameters.contains("index")) {
+          packetsWithIndexCount++;
+        }
+
+        if (++receivedPacketCount == kPacketCount) {
+          allPacketsReceived.set_value();
+        }
+      });
+
+  mDataGraph->createNode("source", false, true);
+  mDataGraph->createNode("stateless", true, true);
+  mDataGraph->createNode("sink", true, false);
+
+  mDataGraph->setNodeInstance("source", "source instance");
+  mDataGraph->setNodeInstance("stateless", "stateless instance");
+  mDataGraph->setNodeInstance("sink", "sink instance");
+
+  mDataGraph->connect("source", testChannel, "stateless");
+  mDataGraph->connect("stateless", "out", "sink");
+
+  mDataGraph->setInstanceImplementation("source instance", source);
+  mDataGraph->setInstanceImplementation("stateless instance", statelessNode);
+  mDataGraph->setInstanceImplementation("sink instance", lambdaSink);
+
+  mDataGraph->setThreadGroupForInstance("stateless instance", "workers");
+  mDataGraph->setThreadGroupWorkerCount("workers", 4);
+
+  mDataGraph->startGraph();
+
+  for (size_t i = 0; i < kPacketCount; i++) {
+    Packet packet;
+    packet.parameters["index"] = i;
+    source->sendPacket(packet, testChannel);
+  }
+
+  ASSERT_EQ(
+      future_status::ready,
+      allPacketsReceived.get_future().wait_for(chrono::seconds(10)));
+  ASSERT_EQ(kPacketCount, packetsWithIndexCount);
+  ASSERT_GT(workerThreadIds.size(), 1);
+}
+
 }  // namespace maplang
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FlatStringMap.h"
+
+#include <map>
+#include <random>
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+namespace maplang {
+
+TEST(FlatStringMapTests, WhenAKeyIsInserted_ItCanBeFoundByStringView) {
+  FlatStringMap<int> map;
+  const string key = "a key which doesn't fit in the small string buffer";
+
+  auto [value, inserted] = map.insert(key, FlatStringMap<int>::hashKey(key));
+  ASSERT_TRUE(inserted);
+  *value = 5;
+
+  const string_view lookup(key);
+  ASSERT_NE(nullptr, map.find(lookup));
+  ASSERT_EQ(5, *map.find(lookup));
+  ASSERT_EQ(nullptr, map.find("another key"));
+  ASSERT_FALSE(map.insert(key, FlatStringMap<int>::hashKey(key)).second);
+  ASSERT_EQ(1, map.size());
+}
+
+TEST(FlatStringMapTests, WhenKeysHaveTheSameHash_TheyAreKeptApart) {
+  FlatStringMap<int> map;
+
+  for (int i = 0; i < 8; i++) {
+    *map.insert(to_string(i), 1234).first = i;
+  }
+
+  ASSERT_TRUE(map.erase("3", 1234));
+  ASSERT_FALSE(map.erase("3", 1234));
+
+  for (int i = 0; i < 8; i++) {
+    int* const value = map.find(to_string(i), 1234);
+    if (i == 3) {
+      ASSERT_EQ(nullptr, value);
+    } else {
+      ASSERT_NE(nullptr, value);
+      ASSERT_EQ(i, *value);
+    }
+  }
+}
+
+TEST(FlatStringMapTests, WhenKeysAreInsertedAndErasedRandomly_ItMatchesAMap) {
+  FlatStringMap<size_t> map;
+  std::map<string, size_t> expected;
+  mt19937 random(1);
+
+  for (size_t i = 0; i < 20000; i++) {
+    const string key = to_string(random() % 1000);
+    if (random() % 3 == 0) {
+      ASSERT_EQ(expected.erase(key) > 0, map.erase(key));
+    } else {
+      *map.insert(key, FlatStringMap<size_t>::hashKey(key)).first = i;
+      expected[key] = i;
+    }
+  }
+
+  ASSERT_EQ(expected.size(), map.size());
+  for (const auto& [key, value] : expected) {
+    size_t* const found = map.find(key);
+    ASSERT_NE(nullptr, found);
+    ASSERT_EQ(value, *found);
+  }
+
+  size_t visitedCount = 0;
+  map.forEach([&visitedCount, &expected](string_view key, size_t value) {
+    ASSERT_EQ(expected[string(key)], value);
+    visitedCount++;
+  });
+  ASSERT_EQ(expected.size(), visitedCount);
+}
+
+}  // namespace maplang
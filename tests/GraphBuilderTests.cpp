@@ -14,12 +14,14 @@
  * limitations under the License.
  */
 
+#include <mutex>
 #include <thread>
 
 #include "gtest/gtest.h"
 #include "maplang/DataGraph.h"
 #include "maplang/FactoriesBuilder.h"
 #include "maplang/GraphBuilder.h"
+#include "maplang/HttpUtilities.h"
 #include "maplang/LambdaPathable.h"
 
 using namespace std;
@@ -123,4 +125,60 @@ TEST_F(GraphBuilderTests, WhenASimplGraphIsLoaded_ItHasTheCorrectConnections) {
   ASSERT_TRUE(foundN2ToN3Connection);
 }
 
+TEST_F(
+    GraphBuilderTests,
+    WhenAnHttpResponseWriterIsImplementedByType_ItsDateHeaderAdvances) {
+  const string dotGraph = R"(
+    digraph SomeGraphName {
+      "Writer" [instance="Writer instance", allowIncoming=true, allowOutgoing=true]
+      "Sink" [instance="Sink instance", allowIncoming=true]
+
+      "Writer" -> "Sink" [label="Http Data"]
+    }
+  )";
+  const string implementation = R"(
+    {
+      "Writer instance": {
+        "type": "HTTP Response Writer",
+        "initParameters": { "dateHeader": true }
+      }
+    }
+  )";
+
+  const auto dataGraph = buildDataGraph(mFactories, dotGraph);
+  implementDataGraph(dataGraph, implementation);
+
+  mutex dateHeadersMutex;
+  vector<string> dateHeaders;
+  dataGraph->setInstanceImplementation(
+      "Sink instance",
+      make_shared<LambdaPathable>(
+          [&dateHeadersMutex, &dateHeaders](const PathablePacket& packet) {
+            const Buffer& headers = packet.packet.buffers[0];
+            const string httpData(
+                reinterpret_cast<const char*>(headers.data.get()),
+                headers.length);
+
+            const size_t dateStart = httpData.find("\r\ndate: ") + 2;
+            const size_t dateEnd = httpData.find("\r\n", dateStart);
+
+            lock_guard<mutex> lock(dateHeadersMutex);
+            dateHeaders.push_back(
+                httpData.substr(dateStart, dateEnd - dateStart));
+          }));
+
+  Packet response;
+  response.parameters[http::kParameter_HttpStatusCode] = http::kHttpStatus_Ok;
+
+  dataGraph->sendPacket(response, "Writer");
+  this_thread::sleep_for(chrono::milliseconds(1500));
+  dataGraph->sendPacket(response, "Writer");
+  this_thread::sleep_for(chrono::milliseconds(100));
+
+  lock_guard<mutex> lock(dateHeadersMutex);
+  ASSERT_EQ(2, dateHeaders.size());
+  ASSERT_EQ(0, dateHeaders[0].find("date: "));
+  ASSERT_NE(dateHeaders[0], dateHeaders[1]);
+}
+
 }  // namespace maplang
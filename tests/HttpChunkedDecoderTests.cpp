@@ -0,0 +1,100 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "HttpChunkedDecoder.h"
+
+#include "gtest/gtest.h"
+#include "maplang/HttpUtilities.h"
+
+using namespace std;
+
+namespace maplang {
+
+static const string kChunkedBody =
+    "5\r\n"
+    "hello\r\n"
+    "7;name=value\r\n"
+    ", world\r\n"
+    "0\r\n"
+    "Trailer: value\r\n"
+    "\r\n";
+
+// Decodes |buffer|, and returns how many of its bytes belong to the body.
+static size_t decodeAll(
+    HttpChunkedDecoder* decoder,
+    const Buffer& buffer,
+    string* body) {
+  size_t decodedByteCount = 0;
+  while (decodedByteCount < buffer.length && !decoder->isComplete()) {
+    Buffer data;
+    decodedByteCount +=
+        decoder->decode(buffer.slice(decodedByteCount), &data);
+    body->append(reinterpret_cast<const char*>(data.data.get()), data.length);
+  }
+
+  return decodedByteCount;
+}
+
+TEST(HttpChunkedDecoderTests, WhenABodyIsInOneBuffer_ItStopsAtTheEnd) {
+  HttpChunkedDecoder decoder;
+  string body;
+
+  ASSERT_EQ(
+      kChunkedBody.length(),
+      decodeAll(&decoder, Buffer(kChunkedBody + "GET /"), &body));
+  ASSERT_TRUE(decoder.isComplete());
+  ASSERT_EQ("hello, world", body);
+}
+
+TEST(HttpChunkedDecoderTests, WhenABodyIsSplitAnywhere_ItIsDecodedTheSame) {
+  for (size_t splitAt = 1; splitAt < kChunkedBody.length(); splitAt++) {
+    HttpChunkedDecoder decoder;
+    const Buffer chunkedBody(kChunkedBody);
+    string body;
+
+    ASSERT_EQ(
+        splitAt,
+        decodeAll(&decoder, chunkedBody.slice(0, splitAt), &body));
+    ASSERT_FALSE(decoder.isComplete()) << "Split at " << splitAt;
+
+    decodeAll(&decoder, chunkedBody.slice(splitAt), &body);
+    ASSERT_TRUE(decoder.isComplete()) << "Split at " << splitAt;
+    ASSERT_EQ("hello, world", body) << "Split at " << splitAt;
+  }
+}
+
+TEST(HttpChunkedDecoderTests, WhenABodyIsMalformed_ItThrows) {
+  for (const string malformedBody :
+       {"\r\n", "x\r\n", "5\r\nhello0\r\n\r\n", "5\nhello\r\n"}) {
+    HttpChunkedDecoder decoder;
+    string body;
+
+    ASSERT_THROW(
+        decodeAll(&decoder, Buffer(malformedBody), &body),
+        runtime_error)
+        << malformedBody;
+  }
+}
+
+TEST(HttpChunkedDecoderTests, OnlyAFinalChunkedCodingIsChunked) {
+  ASSERT_TRUE(http::isChunkedTransferEncoding("chunked"));
+  ASSERT_TRUE(http::isChunkedTransferEncoding("gzip, Chunked "));
+  ASSERT_FALSE(http::isChunkedTransferEncoding("chunked, gzip"));
+  ASSERT_FALSE(http::isChunkedTransferEncoding("notchunked"));
+  ASSERT_FALSE(http::isChunkedTransferEncoding(""));
+}
+
+}  // namespace maplang
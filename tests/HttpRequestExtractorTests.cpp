@@ -40,7 +40,9 @@ TEST_F(
     WhenAnHttpRequestIsProcessed_HeaderFieldsAndBodyAreCorrect) {
   auto extractor = make_shared<HttpRequestExtractor>(mFactories, json());
 
-  Buffer buffer("GET / HTTP/1.1\r\nheaderKey: headerValue\r\n\r\nHi");
+  Buffer buffer(
+      "GET / HTTP/1.1\r\nheaderKey: headerValue\r\nContent-Length: "
+      "10\r\n\r\nHi");
 
   Packet packet;
   packet.buffers.emplace_back(buffer);
@@ -117,7 +119,7 @@ TEST_F(
       ASSERT_STREQ("headerValue", headerValue.c_str());
 
       foundHeaderKey = true;
-    } else {
+    } else if (headerKey != "content-length") {
       FAIL() << "Unexpected header '" << headerKey << "'.";
     }
   }
@@ -159,4 +161,187 @@ TEST_F(
   ASSERT_STREQ(requestId.c_str(), requestEndedPacketsRequestId.c_str());
 }
 
+TEST_F(
+    HttpRequestExtractorTests,
+    WhenContentLengthIsSet_TheRequestEndsAfterThatManyBodyBytes) {
+  auto extractor = make_shared<HttpRequestExtractor>(mFactories, json());
+
+  vector<string> channels;
+  string body;
+  const auto packetPusher = make_shared<LambdaPacketPusher>(
+      [&channels, &body](const Packet& packet, const string& channel) {
+        channels.push_back(channel);
+        if (channel == "Body Data") {
+          body.append(
+              reinterpret_cast<const char*>(packet.buffers[0].data.get()),
+              packet.buffers[0].length);
+        }
+      });
+
+  for (const string data :
+       {"GET / HTTP/1.1\r\nContent-",
+        "Length: 7\r\n\r\nabc",
+        "def",
+        "g"}) {
+    Packet packet;
+    packet.buffers.emplace_back(data);
+    extractor->handlePacket(PathablePacket(packet, packetPusher));
+  }
+
+  ASSERT_EQ("abcdefg", body);
+  ASSERT_EQ(
+      vector<string>(
+          {"New Request",
+           "Body Data",
+           "Body Data",
+           "Body Data",
+           "Request Ended"}),
+      channels);
+}
+
+TEST_F(
+    HttpRequestExtractorTests,
+    WhenRequestsArePipelined_EachRequestIsExtractedInOrder) {
+  auto extractor = make_shared<HttpRequestExtractor>(mFactories, json());
+
+  vector<string> channels;
+  vector<Packet> newRequestPackets;
+  vector<string> requestIds;
+  string body;
+  const auto packetPusher = make_shared<LambdaPacketPusher>(
+      [&channels, &newRequestPackets, &requestIds, &body](
+          const Packet& packet,
+          const string& channel) {
+        channels.push_back(channel);
+        requestIds.push_back(
+            packet.parameters[http::kParameter_HttpRequestId].get<string>());
+
+        if (channel == "New Request") {
+          newRequestPackets.push_back(packet);
+        } else if (channel == "Body Data") {
+          body.append(
+              reinterpret_cast<const char*>(packet.buffers[0].data.get()),
+              packet.buffers[0].length);
+        }
+      });
+
+  Packet packet;
+  packet.buffers.emplace_back(
+      "GET /first HTTP/1.1\r\n\r\n"
+      "POST /second HTTP/1.1\r\nContent-Length: 3\r\n\r\nabc"
+      "GET /third HTTP/1.1\r\n\r\n"
+      "GET /fou");
+  extractor->handlePacket(PathablePacket(packet, packetPusher));
+
+  Packet lastPacket;
+  lastPacket.buffers.emplace_back("rth HTTP/1.1\r\n\r\n");
+  extractor->handlePacket(PathablePacket(lastPacket, packetPusher));
+
+  ASSERT_EQ(
+      vector<string>(
+          {"New Request",
+           "Request Ended",
+           "New Request",
+           "Body Data",
+           "Request Ended",
+           "New Request",
+           "Request Ended",
+           "New Request",
+           "Request Ended"}),
+      channels);
+  ASSERT_EQ("abc", body);
+
+  ASSERT_EQ(4, newRequestPackets.size());
+  const vector<string> paths = {"/first", "/second", "/third", "/fourth"};
+  for (size_t i = 0; i < newRequestPackets.size(); i++) {
+    const auto& parameters = newRequestPackets[i].parameters;
+    ASSERT_EQ(paths[i], parameters[http::kParameter_HttpPath].get<string>());
+    ASSERT_EQ(
+        i,
+        parameters[http::kParameter_HttpRequestIndex].get<uint64_t>());
+  }
+
+  // Every packet of a request has its id, and each request has a new id.
+  ASSERT_EQ(requestIds[0], requestIds[1]);
+  ASSERT_EQ(requestIds[2], requestIds[3]);
+  ASSERT_EQ(requestIds[2], requestIds[4]);
+  ASSERT_NE(requestIds[0], requestIds[2]);
+  ASSERT_NE(requestIds[2], requestIds[5]);
+  ASSERT_NE(requestIds[5], requestIds[7]);
+}
+
+TEST_F(
+    HttpRequestExtractorTests,
+    WhenABodyIsChunked_ItIsDecodedAndTheNextRequestFollows) {
+  auto extractor = make_shared<HttpRequestExtractor>(mFactories, json());
+
+  vector<string> channels;
+  string body;
+  const auto packetPusher = make_shared<LambdaPacketPusher>(
+      [&channels, &body](const Packet& packet, const string& channel) {
+        channels.push_back(channel);
+        if (channel == "Body Data") {
+          body.append(
+              reinterpret_cast<const char*>(packet.buffers[0].data.get()),
+              packet.buffers[0].length);
+        }
+      });
+
+  for (const string data :
+       {"POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc",
+        "\r\n4\r\ndefg\r\n0\r\n\r\nGET / HTTP/1.1\r\n\r\n"}) {
+    Packet packet;
+    packet.buffers.emplace_back(data);
+    extractor->handlePacket(PathablePacket(packet, packetPusher));
+  }
+
+  ASSERT_EQ("abcdefg", body);
+  ASSERT_EQ(
+      vector<string>(
+          {"New Request",
+           "Body Data",
+           "Body Data",
+           "Request Ended",
+           "New Request",
+           "Request Ended"}),
+      channels);
+}
+
+TEST_F(
+    HttpRequestExtractorTests,
+    WhenARequestIsMalformed_TheRestOfTheConnectionIsDroppedUntilReset) {
+  auto extractor = make_shared<HttpRequestExtractor>(mFactories, json());
+
+  vector<string> channels;
+  vector<string> paths;
+  const auto packetPusher = make_shared<LambdaPacketPusher>(
+      [&channels, &paths](const Packet& packet, const string& channel) {
+        channels.push_back(channel);
+        if (channel == "New Request") {
+          paths.push_back(
+              packet.parameters[http::kParameter_HttpPath].get<string>());
+        }
+      });
+
+  const auto send = [&extractor, &packetPusher](const string& data) {
+    Packet packet;
+    packet.buffers.emplace_back(data);
+    extractor->handlePacket(PathablePacket(packet, packetPusher));
+  };
+
+  send("GET /bad HTTP/1.1\r\nNoColon\r\n");
+  send("\r\nGET /after-bad HTTP/1.1\r\n\r\n");
+
+  ASSERT_EQ(vector<string>({"error"}), channels);
+
+  // The connection closed, and the extractor is reused for another one.
+  extractor->reset();
+  send("GET /good HTTP/1.1\r\n\r\n");
+
+  ASSERT_EQ(vector<string>({"/good"}), paths);
+  ASSERT_EQ(
+      vector<string>({"error", "New Request", "Request Ended"}),
+      channels);
+}
+
 }  // namespace maplang
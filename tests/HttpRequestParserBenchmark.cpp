@@ -0,0 +1,259 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compares HttpRequestParser with the MemoryStream-based header parsing the
+ * HTTP Request Extractor used before it, on a request with browser-sized
+ * headers. The request is parsed from one buffer, and from 64-byte buffers
+ * (as if it arrived in several reads). Reports the time and heap allocations
+ * per request.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "HttpRequestParser.h"
+#include "maplang/HttpUtilities.h"
+#include "maplang/MemoryStream.h"
+
+using namespace std;
+using namespace maplang;
+using json = nlohmann::json;
+
+static atomic<size_t> gAllocationCount(0);
+
+void* operator new(size_t size) {
+  gAllocationCount.fetch_add(1, memory_order_relaxed);
+
+  void* const memory = malloc(size == 0 ? 1 : size);
+  if (memory == nullptr) {
+    throw bad_alloc();
+  }
+
+  return memory;
+}
+
+void operator delete(void* memory) noexcept { free(memory); }
+void operator delete(void* memory, size_t) noexcept { free(memory); }
+
+static constexpr size_t kWarmUpRequestCount = 1000;
+static constexpr size_t kMeasuredRequestCount = 50000;
+static constexpr size_t kSplitBufferLength = 64;
+
+static const string kRequest =
+    "GET /assets/app.js?v=20200512 HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "Connection: keep-alive\r\n"
+    "User-Agent: Mozilla/5.0 (Macintosh; Intel Mac OS X 10_15_4) "
+    "AppleWebKit/537.36 (KHTML, like Gecko) Chrome/81.0.4044.138 "
+    "Safari/537.36\r\n"
+    "Accept: */*\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "Sec-Fetch-Mode: no-cors\r\n"
+    "Sec-Fetch-Dest: script\r\n"
+    "Referer: https://www.example.com/products/index.html\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: en-US,en;q=0.9,de;q=0.8\r\n"
+    "Cookie: _ga=GA1.2.1234567890.1589300000; _gid=GA1.2.987654321.1589300000; "
+    "session=4f2a9c1e7b3d4a6f8e0c2b5d7a9f1e3c; theme=dark\r\n"
+    "If-None-Match: \"5eb9f1a2-1c4f\"\r\n"
+    "If-Modified-Since: Mon, 11 May 2020 22:41:06 GMT\r\n"
+    "\r\n";
+
+// The header parsing of the HTTP Request Extractor before HttpRequestParser.
+namespace legacy {
+
+static string toLower(const string& str) {
+  ostringstream out;
+  size_t length = str.length();
+  for (size_t i = 0; i < length; i++) {
+    out.put(tolower(str[i]));
+  }
+
+  return out.str();
+}
+
+static json parseHeaders(const MemoryStream& headers) {
+  json parsedHeaders;
+  headers.split(
+      "\r\n",
+      2,
+      [&parsedHeaders](size_t lineIndex, MemoryStream&& headerLine) {
+        static constexpr size_t maxTokens = 2;
+        ostringstream key;
+        ostringstream value;
+        headerLine.split(
+            ':',
+            [&key, &value](size_t kvIndex, MemoryStream&& keyOrValue) {
+              if (kvIndex == 0) {
+                key << keyOrValue.trim();
+              } else {
+                value << keyOrValue.trim();
+              }
+
+              return true;
+            },
+            maxTokens);
+
+        parsedHeaders[toLower(key.str())] = value.str();
+        return true;
+      });
+
+  return parsedHeaders;
+}
+
+static json createHeaderParameters(const MemoryStream& memoryStream) {
+  MemoryStream firstLine;
+  MemoryStream headersStream;
+
+  memoryStream.split(
+      "\r\n",
+      2,
+      [&firstLine, &headersStream](size_t index, MemoryStream&& stream) {
+        if (index == 0) {
+          firstLine = move(stream);
+        } else {
+          headersStream = move(stream);
+        }
+
+        return true;
+      });
+
+  json parameters;
+
+  parameters[http::kParameter_HttpHeaders] = parseHeaders(headersStream);
+  firstLine.split(' ', [&parameters](size_t index, MemoryStream&& token) {
+    ostringstream outStream;
+    outStream << token;
+    string tokenString = outStream.str();
+
+    if (index == 0) {
+      parameters[http::kParameter_HttpMethod] = tokenString;
+    } else if (index == 1) {
+      parameters[http::kParameter_HttpPath] = tokenString;
+    } else if (index == 2) {
+      parameters[http::kParameter_HttpVersion] = tokenString;
+    }
+
+    return true;
+  });
+
+  return parameters;
+}
+
+static json parse(const vector<Buffer>& buffers) {
+  static constexpr char kDoubleCrLf[] = "\r\n\r\n";
+  static constexpr size_t kDoubleCrLfLength = sizeof(kDoubleCrLf) - 1;
+
+  MemoryStream headerData;
+  for (const Buffer& buffer : buffers) {
+    headerData.append(buffer);
+
+    const size_t headersEnd =
+        headerData.firstIndexOf(kDoubleCrLf, kDoubleCrLfLength);
+    if (headersEnd != MemoryStream::kNotFound) {
+      return createHeaderParameters(headerData.subStream(0, headersEnd));
+    }
+  }
+
+  return json();
+}
+
+}  // namespace legacy
+
+static json parseWithHttpRequestParser(
+    HttpRequestParser* parser,
+    const vector<Buffer>& buffers) {
+  parser->reset();
+
+  for (const Buffer& buffer : buffers) {
+    parser->parse(buffer);
+    if (parser->isComplete()) {
+      return parser->createParameters();
+    }
+  }
+
+  return json();
+}
+
+static vector<Buffer> splitRequest(size_t bufferLength) {
+  const Buffer request(kRequest);
+  vector<Buffer> buffers;
+  for (size_t offset = 0; offset < request.length; offset += bufferLength) {
+    buffers.push_back(request.slice(
+        offset,
+        min(bufferLength, request.length - offset)));
+  }
+
+  return buffers;
+}
+
+static void measure(
+    const char* name,
+    const vector<Buffer>& buffers,
+    const function<json(const vector<Buffer>&)>& parse) {
+  size_t headerCount = 0;
+  for (size_t i = 0; i < kWarmUpRequestCount; i++) {
+    headerCount += parse(buffers)[http::kParameter_HttpHeaders].size();
+  }
+
+  const size_t allocationCountBefore = gAllocationCount;
+  const auto start = chrono::steady_clock::now();
+
+  for (size_t i = 0; i < kMeasuredRequestCount; i++) {
+    headerCount += parse(buffers)[http::kParameter_HttpHeaders].size();
+  }
+
+  const auto elapsed = chrono::steady_clock::now() - start;
+  const size_t allocationCount = gAllocationCount - allocationCountBefore;
+
+  printf(
+      "%-40s %8.0f ns per request %8.1f allocations per request\n",
+      name,
+      static_cast<double>(
+          chrono::duration_cast<chrono::nanoseconds>(elapsed).count())
+          / kMeasuredRequestCount,
+      static_cast<double>(allocationCount) / kMeasuredRequestCount);
+
+  if (headerCount == 0) {
+    printf("No headers were parsed.\n");
+  }
+}
+
+int main(int argc, char** argv) {
+  const vector<Buffer> oneBuffer = splitRequest(kRequest.length());
+  const vector<Buffer> splitBuffers = splitRequest(kSplitBufferLength);
+
+  HttpRequestParser parser;
+  const auto parseWithParser = [&parser](const vector<Buffer>& buffers) {
+    return parseWithHttpRequestParser(&parser, buffers);
+  };
+
+  printf("Request: %zu bytes\n", kRequest.length());
+  measure("MemoryStream, one buffer:", oneBuffer, legacy::parse);
+  measure("HttpRequestParser, one buffer:", oneBuffer, parseWithParser);
+  measure("MemoryStream, 64-byte buffers:", splitBuffers, legacy::parse);
+  measure("HttpRequestParser, 64-byte buffers:", splitBuffers, parseWithParser);
+
+  return 0;
+}
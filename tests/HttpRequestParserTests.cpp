@@ -0,0 +1,154 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "HttpRequestParser.h"
+
+#include "gtest/gtest.h"
+#include "maplang/HttpUtilities.h"
+
+using namespace std;
+using namespace nlohmann;
+
+namespace maplang {
+
+static const string kRequest =
+    "GET /index.html HTTP/1.1\r\n"
+    "Host: example.com\r\n"
+    "User-Agent:  test agent \r\n"
+    "Content-Length: 5\r\n"
+    "Empty:\r\n"
+    "\r\n"
+    "hello";
+
+static const size_t kHeaderBlockLength = kRequest.length() - 5;
+
+static void assertParametersAreCorrect(const json& parameters) {
+  ASSERT_EQ("GET", parameters[http::kParameter_HttpMethod].get<string>());
+  ASSERT_EQ("/index.html", parameters[http::kParameter_HttpPath].get<string>());
+  ASSERT_EQ("HTTP/1.1", parameters[http::kParameter_HttpVersion].get<string>());
+
+  const json expectedHeaders = {
+      {"host", "example.com"},
+      {"user-agent", "test agent"},
+      {"content-length", "5"},
+      {"empty", ""}};
+  ASSERT_EQ(expectedHeaders, parameters[http::kParameter_HttpHeaders]);
+}
+
+TEST(HttpRequestParserTests, WhenARequestIsInOneBuffer_ItStopsAtTheBody) {
+  HttpRequestParser parser;
+
+  ASSERT_EQ(kHeaderBlockLength, parser.parse(Buffer(kRequest)));
+  ASSERT_TRUE(parser.isComplete());
+  ASSERT_EQ(5, parser.getContentLength());
+  assertParametersAreCorrect(parser.createParameters());
+}
+
+TEST(HttpRequestParserTests, WhenARequestIsSplitAnywhere_ItIsParsedTheSame) {
+  for (size_t splitAt = 1; splitAt < kHeaderBlockLength; splitAt++) {
+    HttpRequestParser parser;
+    const Buffer request(kRequest);
+
+    ASSERT_EQ(splitAt, parser.parse(request.slice(0, splitAt)));
+    ASSERT_FALSE(parser.isComplete()) << "Split at " << splitAt;
+
+    ASSERT_EQ(
+        kHeaderBlockLength - splitAt,
+        parser.parse(request.slice(splitAt)));
+    ASSERT_TRUE(parser.isComplete()) << "Split at " << splitAt;
+    assertParametersAreCorrect(parser.createParameters());
+  }
+}
+
+TEST(HttpRequestParserTests, WhenHeadersAreIncluded_OnlyThoseAreInParameters) {
+  HttpRequestParser parser;
+  parser.parse(Buffer(kRequest));
+
+  const unordered_set<string> includedHeaders = {"host"};
+  const json parameters = parser.createParameters(&includedHeaders);
+
+  ASSERT_EQ(
+      json({{"host", "example.com"}}),
+      parameters[http::kParameter_HttpHeaders]);
+}
+
+TEST(HttpRequestParserTests, WhenAHeaderLineHasNoColon_ParsingThrows) {
+  HttpRequestParser parser;
+
+  ASSERT_THROW(
+      parser.parse(Buffer("GET / HTTP/1.1\r\nNoColon\r\n\r\n")),
+      runtime_error);
+}
+
+TEST(HttpRequestParserTests, WhenAHeaderNameEndsInWhitespace_ParsingThrows) {
+  HttpRequestParser parser;
+
+  ASSERT_THROW(
+      parser.parse(Buffer("GET / HTTP/1.1\r\nContent-Length : 5\r\n\r\n")),
+      runtime_error);
+}
+
+TEST(HttpRequestParserTests, WhenContentLengthsDiffer_ParsingThrows) {
+  HttpRequestParser parser;
+
+  ASSERT_THROW(
+      parser.parse(Buffer(
+          "GET / HTTP/1.1\r\nContent-Length: 5\r\nContent-Length: 6\r\n"
+          "\r\n")),
+      runtime_error);
+
+  // The same value twice is allowed.
+  parser.reset();
+  parser.parse(Buffer(
+      "GET / HTTP/1.1\r\nContent-Length: 5\r\ncontent-length: 5\r\n\r\n"));
+  ASSERT_TRUE(parser.isComplete());
+  ASSERT_EQ(5, parser.getContentLength());
+}
+
+TEST(
+    HttpRequestParserTests,
+    WhenContentLengthAndTransferEncodingAreBothSet_ParsingThrows) {
+  for (const string request :
+       {"POST / HTTP/1.1\r\nContent-Length: 5\r\n"
+        "Transfer-Encoding: chunked\r\n\r\n",
+        "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n"
+        "Content-Length: 5\r\n\r\n"}) {
+    HttpRequestParser parser;
+
+    ASSERT_THROW(parser.parse(Buffer(request)), runtime_error) << request;
+  }
+}
+
+TEST(HttpRequestParserTests, WhenAHeaderHasNonAsciiBytes_TheyAreKept) {
+  HttpRequestParser parser;
+  parser.parse(
+      Buffer("GET / HTTP/1.1\r\nX-\xc3\x89t\xc3\xa9: \xc3\xa9\r\n\r\n"));
+
+  ASSERT_TRUE(parser.isComplete());
+  ASSERT_EQ(
+      json({{"x-\xc3\x89t\xc3\xa9", "\xc3\xa9"}}),
+      parser.createParameters()[http::kParameter_HttpHeaders]);
+}
+
+TEST(HttpRequestParserTests, WhenContentLengthIsNotANumber_ParsingThrows) {
+  HttpRequestParser parser;
+
+  ASSERT_THROW(
+      parser.parse(Buffer("GET / HTTP/1.1\r\nContent-Length: 5x\r\n\r\n")),
+      runtime_error);
+}
+
+}  // namespace maplang
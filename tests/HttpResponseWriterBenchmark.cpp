@@ -0,0 +1,131 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Measures the HTTP Response Writer with and without "maxCachedResponses",
+ * on responses with typical headers and a Date header. Each response inherits
+ * its status and headers from one shared Parameters object (as if added by an
+ * Add Parameters node), or has its own equal headers, as when they're built
+ * for each response. Reports the time and heap allocations per response.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "maplang/FactoriesBuilder.h"
+#include "maplang/HttpUtilities.h"
+#include "maplang/LambdaPacketPusher.h"
+#include "nodes/HttpResponseWriter.h"
+
+using namespace std;
+using namespace maplang;
+using json = nlohmann::json;
+
+static atomic<size_t> gAllocationCount(0);
+
+void* operator new(size_t size) {
+  gAllocationCount.fetch_add(1, memory_order_relaxed);
+
+  void* const memory = malloc(size == 0 ? 1 : size);
+  if (memory == nullptr) {
+    throw bad_alloc();
+  }
+
+  return memory;
+}
+
+void operator delete(void* memory) noexcept { free(memory); }
+void operator delete(void* memory, size_t) noexcept { free(memory); }
+
+static constexpr size_t kWarmUpResponseCount = 1000;
+static constexpr size_t kMeasuredResponseCount = 100000;
+
+static json createResponseParameters() {
+  return {
+      {http::kParameter_HttpStatusCode, http::kHttpStatus_Ok},
+      {http::kParameter_HttpHeaders,
+       {{"content-type", "application/json; charset=utf-8"},
+        {"cache-control", "no-cache, no-store, must-revalidate"},
+        {"server", "maplang"},
+        {"x-content-type-options", "nosniff"},
+        {"x-frame-options", "DENY"},
+        {"vary", "Accept-Encoding"}}}};
+}
+
+static void measure(
+    const char* name,
+    size_t maxCachedResponses,
+    bool shareHeaders) {
+  const Factories factories = FactoriesBuilder().BuildFactories();
+  HttpResponseWriter writer(
+      factories,
+      {{"dateHeader", true}, {"maxCachedResponses", maxCachedResponses}});
+
+  size_t writtenLength = 0;
+  const auto packetPusher = make_shared<LambdaPacketPusher>(
+      [&writtenLength](const Packet& packet, const string& channel) {
+        writtenLength += packet.buffers[0].length;
+      });
+
+  const Parameters sharedResponseParameters = createResponseParameters();
+  const Buffer body(string(R"({"status": "ok", "items": [1, 2, 3]})"));
+
+  const auto writeResponses = [&](size_t responseCount) {
+    for (size_t i = 0; i < responseCount; i++) {
+      Packet packet;
+      packet.parameters = shareHeaders ? sharedResponseParameters
+                                       : Parameters(createResponseParameters());
+      packet.buffers.push_back(body);
+
+      writer.handlePacket(PathablePacket(packet, packetPusher));
+    }
+  };
+
+  writeResponses(kWarmUpResponseCount);
+
+  const size_t allocationCountBefore = gAllocationCount;
+  const auto start = chrono::steady_clock::now();
+
+  writeResponses(kMeasuredResponseCount);
+
+  const auto elapsed = chrono::steady_clock::now() - start;
+  const size_t allocationCount = gAllocationCount - allocationCountBefore;
+
+  printf(
+      "%-40s %8.0f ns per response %8.1f allocations per response\n",
+      name,
+      static_cast<double>(
+          chrono::duration_cast<chrono::nanoseconds>(elapsed).count())
+          / kMeasuredResponseCount,
+      static_cast<double>(allocationCount) / kMeasuredResponseCount);
+
+  if (writtenLength == 0) {
+    printf("No headers were written.\n");
+  }
+}
+
+int main(int argc, char** argv) {
+  measure("No cache, shared headers:", 0, true);
+  measure("Cache, shared headers:", 64, true);
+  measure("No cache, own headers:", 0, false);
+  measure("Cache, own headers:", 64, false);
+
+  return 0;
+}
@@ -0,0 +1,260 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nodes/HttpResponseWriter.h"
+
+#include "gtest/gtest.h"
+#include "maplang/FactoriesBuilder.h"
+#include "maplang/HttpUtilities.h"
+#include "maplang/LambdaPacketPusher.h"
+#include "nodes/HttpResponseExtractor.h"
+
+using namespace std;
+using namespace nlohmann;
+
+namespace maplang {
+
+static string toString(const Buffer& buffer) {
+  return string(
+      reinterpret_cast<const char*>(buffer.data.get()),
+      buffer.length);
+}
+
+class HttpResponseWriterTests : public testing::Test {
+ public:
+  HttpResponseWriterTests()
+      : mFactories(FactoriesBuilder().BuildFactories()),
+        mWriter(mFactories, json()),
+        mPacketPusher(make_shared<LambdaPacketPusher>(
+            [this](const Packet& packet, const string& channel) {
+              ASSERT_EQ("Http Data", channel);
+
+              string httpData;
+              for (const Buffer& buffer : packet.buffers) {
+                httpData += toString(buffer);
+              }
+
+              mHttpData.push_back(httpData);
+              mHttpDataPackets.push_back(packet);
+            })) {}
+
+  void write(const Packet& packet) {
+    mWriter.handlePacket(PathablePacket(packet, mPacketPusher));
+  }
+
+  const Factories mFactories;
+  HttpResponseWriter mWriter;
+  const shared_ptr<IPacketPusher> mPacketPusher;
+  vector<string> mHttpData;
+  vector<Packet> mHttpDataPackets;
+};
+
+TEST_F(HttpResponseWriterTests, WhenAResponseHasABody_ContentLengthIsSet) {
+  Packet packet;
+  packet.parameters[http::kParameter_HttpStatusCode] = http::kHttpStatus_Ok;
+  packet.parameters[http::kParameter_HttpHeaders] = {
+      {http::kHttpHeaderNormalized_ContentType, "text/plain"},
+      {http::kHttpHeaderNormalized_ContentLength, "1000"}};
+  packet.buffers.emplace_back("hello");
+  write(packet);
+
+  ASSERT_EQ(
+      vector<string>(
+          {"HTTP/1.1 200 OK\r\ncontent-type: text/plain\r\n"
+           "content-length: 5\r\n\r\nhello"}),
+      mHttpData);
+
+  // The body is sent as it is, after the headers.
+  ASSERT_EQ(2, mHttpDataPackets[0].buffers.size());
+  ASSERT_EQ(packet.buffers[0].data, mHttpDataPackets[0].buffers[1].data);
+}
+
+TEST_F(HttpResponseWriterTests, WhenAStatusHasAReason_ItIsInTheStatusLine) {
+  Packet packet;
+  packet.parameters[http::kParameter_HttpStatusCode] = 404;
+  packet.parameters[http::kParameter_HttpStatusReason] = "Not Found";
+  write(packet);
+
+  Packet defaultReasonPacket;
+  defaultReasonPacket.parameters[http::kParameter_HttpStatusCode] =
+      http::kHttpStatus_BadRequest;
+  write(defaultReasonPacket);
+
+  ASSERT_EQ(
+      vector<string>(
+          {"HTTP/1.1 404 Not Found\r\n\r\n",
+           "HTTP/1.1 400 BAD REQUEST\r\n\r\n"}),
+      mHttpData);
+}
+
+TEST_F(
+    HttpResponseWriterTests,
+    WhenAResponseIsChunked_EachPacketIsAChunkUntilAnEmptyPacket) {
+  Packet headerPacket;
+  headerPacket.parameters[http::kParameter_HttpStatusCode] =
+      http::kHttpStatus_Ok;
+  headerPacket.parameters[http::kParameter_HttpHeaders] = {
+      {http::kHttpHeaderNormalized_TransferEncoding, "chunked"}};
+  headerPacket.buffers.emplace_back("hello");
+  write(headerPacket);
+
+  Packet chunkPacket;
+  chunkPacket.parameters[http::kParameter_HttpChunk] = true;
+  chunkPacket.buffers.emplace_back(", chunked world");
+  write(chunkPacket);
+
+  // The response's headers also mark a chunk.
+  Packet lastChunkPacket;
+  lastChunkPacket.parameters[http::kParameter_HttpHeaders] =
+      headerPacket.parameters[http::kParameter_HttpHeaders];
+  write(lastChunkPacket);
+
+  ASSERT_EQ(
+      vector<string>(
+          {"HTTP/1.1 200 OK\r\ntransfer-encoding: chunked\r\n\r\n"
+           "5\r\nhello\r\n",
+           "f\r\n, chunked world\r\n",
+           "0\r\n\r\n"}),
+      mHttpData);
+
+  // The response extractor decodes it back.
+  HttpResponseExtractor extractor(mFactories, json());
+  vector<string> channels;
+  string body;
+  extractor.setPacketPusher(make_shared<LambdaPacketPusher>(
+      [&channels, &body](const Packet& packet, const string& channel) {
+        channels.push_back(channel);
+        if (channel == "Body Data") {
+          body += toString(packet.buffers[0]);
+        }
+      }));
+
+  for (const string& httpData : mHttpData) {
+    Packet packet;
+    packet.buffers.emplace_back(httpData);
+    extractor.handlePacket(PathablePacket(packet, mPacketPusher));
+  }
+
+  ASSERT_EQ("hello, chunked world", body);
+  ASSERT_EQ(
+      vector<string>(
+          {"Reponse Headers Received",
+           "Body Data",
+           "Body Data",
+           "Request Ended"}),
+      channels);
+}
+
+TEST_F(
+    HttpResponseWriterTests,
+    WhenAPacketHasNoStatusAndIsNotAChunk_AnErrorIsSent) {
+  vector<string> channels;
+  const auto packetPusher = make_shared<LambdaPacketPusher>(
+      [&channels](const Packet& packet, const string& channel) {
+        channels.push_back(channel);
+      });
+
+  Packet packet;
+  packet.buffers.emplace_back("not a chunk");
+  mWriter.handlePacket(PathablePacket(packet, packetPusher));
+
+  Packet notChunkedPacket;
+  notChunkedPacket.parameters[http::kParameter_HttpHeaders] = {
+      {http::kHttpHeaderNormalized_ContentType, "text/plain"}};
+  mWriter.handlePacket(PathablePacket(notChunkedPacket, packetPusher));
+
+  ASSERT_EQ(vector<string>({"error", "error"}), channels);
+}
+
+TEST_F(
+    HttpResponseWriterTests,
+    WhenResponsesAreCached_IdenticalHeadersAreSerializedOnce) {
+  HttpResponseWriter cachingWriter(
+      mFactories,
+      {{"maxCachedResponses", 2}, {"dateHeader", true}});
+
+  // Shared by every response, as if added by an Add Parameters node.
+  const Parameters responseParameters = {
+      {http::kParameter_HttpStatusCode, http::kHttpStatus_Ok},
+      {http::kParameter_HttpHeaders,
+       {{http::kHttpHeaderNormalized_ContentType, "text/plain"}}}};
+
+  const auto writeResponse = [&](const string& body) {
+    Packet packet;
+    packet.parameters["requestBody"] = body;
+    packet.parameters.inheritFrom(responseParameters);
+    packet.buffers.emplace_back(body);
+
+    cachingWriter.handlePacket(PathablePacket(packet, mPacketPusher));
+  };
+
+  writeResponse("hello");
+  writeResponse("world");
+  writeResponse("longer body");
+
+  ASSERT_EQ(3, mHttpDataPackets.size());
+  const Buffer& firstHeaders = mHttpDataPackets[0].buffers[0];
+  ASSERT_EQ(firstHeaders.data, mHttpDataPackets[1].buffers[0].data);
+  ASSERT_NE(firstHeaders.data, mHttpDataPackets[2].buffers[0].data);
+
+  ASSERT_EQ(0, mHttpData[1].find("HTTP/1.1 200 OK\r\n"));
+  ASSERT_NE(string::npos, mHttpData[1].find("\r\ndate: "));
+  ASSERT_NE(string::npos, mHttpData[1].find("\r\n\r\nworld"));
+  ASSERT_NE(string::npos, mHttpData[2].find("content-length: 11\r\n"));
+}
+
+TEST_F(
+    HttpResponseWriterTests,
+    WhenTheCacheIsFull_TheLeastRecentlyUsedResponseIsEvicted) {
+  HttpResponseWriter cachingWriter(mFactories, {{"maxCachedResponses", 2}});
+
+  const auto createResponse = [](const string& contentType) {
+    return Parameters {
+        {http::kParameter_HttpStatusCode, http::kHttpStatus_Ok},
+        {http::kParameter_HttpHeaders,
+         {{http::kHttpHeaderNormalized_ContentType, contentType}}}};
+  };
+
+  const Parameters a = createResponse("text/a");
+  const Parameters b = createResponse("text/b");
+  const Parameters c = createResponse("text/c");
+
+  // Returns the header buffer's data.
+  const auto writeResponse = [&](const Parameters& parameters) {
+    Packet packet;
+    packet.parameters = parameters;
+    packet.buffers.emplace_back("body");
+
+    cachingWriter.handlePacket(PathablePacket(packet, mPacketPusher));
+    return mHttpDataPackets.back().buffers[0].data;
+  };
+
+  const auto aHeaders = writeResponse(a);
+  const auto bHeaders = writeResponse(b);
+  ASSERT_EQ(aHeaders, writeResponse(a));
+
+  // Evicts b, which was used less recently than a.
+  writeResponse(c);
+
+  ASSERT_EQ(aHeaders, writeResponse(a));
+  ASSERT_NE(bHeaders, writeResponse(b));
+
+  // Equal headers hit, even when they aren't shared.
+  ASSERT_EQ(aHeaders, writeResponse(createResponse("text/a")));
+  ASSERT_NE(string::npos, mHttpData.back().find("content-type: text/a\r\n"));
+}
+
+}  // namespace maplang
@@ -0,0 +1,168 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Counts heap allocations per hop while packets travel down a 5-node chain:
+ *
+ *   source -> hop1 -> hop2 -> hop3 -> sink
+ *
+ * The packets carry parameters shaped like those of a TCP connection and
+ * HTTP request. Two variants are measured: hops which forward the packet they
+ * received, and hops which send a new packet with one parameter of their own
+ * (the received parameters are propagated by the DataGraph).
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <thread>
+
+#include "maplang/DataGraph.h"
+#include "maplang/FactoriesBuilder.h"
+#include "maplang/LambdaPathable.h"
+#include "maplang/SimpleSource.h"
+
+using namespace std;
+using namespace maplang;
+using json = nlohmann::json;
+
+static atomic<size_t> gAllocationCount(0);
+
+void* operator new(size_t size) {
+  gAllocationCount.fetch_add(1, memory_order_relaxed);
+
+  void* const memory = malloc(size == 0 ? 1 : size);
+  if (memory == nullptr) {
+    throw bad_alloc();
+  }
+
+  return memory;
+}
+
+void operator delete(void* memory) noexcept { free(memory); }
+void operator delete(void* memory, size_t) noexcept { free(memory); }
+
+static constexpr size_t kHopCount = 4;
+static constexpr size_t kWarmUpPacketCount = 1000;
+static constexpr size_t kMeasuredPacketCount = 20000;
+
+static json createParameters() {
+  return R"({
+    "TcpConnectionId": 4294967308,
+    "LocalAddress": "198.51.100.1",
+    "LocalPort": 8080,
+    "RemoteAddress": "203.0.113.7",
+    "RemotePort": 51514,
+    "httpRequestId": "a1b2c3d4e5f6",
+    "httpMethod": "GET",
+    "httpPath": "/index.html",
+    "httpVersion": "HTTP/1.1",
+    "httpHeaders": {
+      "host": "example.com",
+      "user-agent": "benchmark",
+      "accept": "*/*"
+    }
+  })"_json;
+}
+
+static double measureAllocationsPerHop(bool hopsCreateNewPackets) {
+  const auto dataGraph =
+      make_shared<DataGraph>(FactoriesBuilder().BuildFactories());
+  const auto source = make_shared<SimpleSource>();
+  atomic<size_t> receivedPacketCount(0);
+
+  dataGraph->createNode("source", false, true);
+  dataGraph->setNodeInstance("source", "source-instance");
+  dataGraph->setInstanceImplementation("source-instance", source);
+
+  string previousNodeName = "source";
+  for (size_t i = 1; i < kHopCount; i++) {
+    const string nodeName = "hop" + to_string(i);
+    const string instanceName = nodeName + "-instance";
+
+    auto hop = make_shared<LambdaPathable>(
+        [hopsCreateNewPackets, i](const PathablePacket& pathablePacket) {
+          if (hopsCreateNewPackets) {
+            Packet packet;
+            packet.parameters["hop" + to_string(i)] = i;
+            pathablePacket.packetPusher->pushPacket(move(packet), "out");
+          } else {
+            pathablePacket.packetPusher->pushPacket(
+                pathablePacket.packet,
+                "out");
+          }
+        });
+
+    dataGraph->createNode(nodeName, true, true);
+    dataGraph->setNodeInstance(nodeName, instanceName);
+    dataGraph->setInstanceImplementation(instanceName, hop);
+    dataGraph->connect(previousNodeName, "out", nodeName);
+
+    previousNodeName = nodeName;
+  }
+
+  auto sink = make_shared<LambdaPathable>(
+      [&receivedPacketCount](const PathablePacket& pathablePacket) {
+        receivedPacketCount++;
+      });
+
+  dataGraph->createNode("sink", true, false);
+  dataGraph->setNodeInstance("sink", "sink-instance");
+  dataGraph->setInstanceImplementation("sink-instance", sink);
+  dataGraph->connect(previousNodeName, "out", "sink");
+
+  dataGraph->startGraph();
+
+  const auto sendAndWait = [&source, &receivedPacketCount](
+                               const Packet& packet,
+                               size_t packetCount) {
+    const size_t waitForCount = receivedPacketCount + packetCount;
+    for (size_t i = 0; i < packetCount; i++) {
+      source->sendPacket(packet, "out");
+    }
+
+    while (receivedPacketCount < waitForCount) {
+      this_thread::sleep_for(chrono::microseconds(100));
+    }
+  };
+
+  Packet packet;
+  packet.parameters = createParameters();
+
+  sendAndWait(packet, kWarmUpPacketCount);
+
+  const size_t allocationCountBefore = gAllocationCount;
+  sendAndWait(packet, kMeasuredPacketCount);
+  const size_t allocationCount = gAllocationCount - allocationCountBefore;
+
+  return static_cast<double>(allocationCount)
+         / static_cast<double>(kMeasuredPacketCount * kHopCount);
+}
+
+int main(int argc, char** argv) {
+  printf(
+      "Forwarding received packets:  %6.2f allocations per hop\n",
+      measureAllocationsPerHop(false));
+
+  printf(
+      "Sending new packets:          %6.2f allocations per hop\n",
+      measureAllocationsPerHop(true));
+
+  return 0;
+}
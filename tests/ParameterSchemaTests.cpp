@@ -0,0 +1,77 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gtest/gtest.h"
+#include "maplang/ParameterSchema.h"
+
+using namespace std;
+using namespace nlohmann;
+
+namespace maplang {
+
+TEST(ParameterSchemaTests, WhenParametersAreResolved_SlotsReturnTheirValues) {
+  ParameterSchema schema;
+  const ParameterSlot idSlot =
+      schema.declare("id", ParameterSchema::Type::String);
+  const ParameterSlot nestedSlot = schema.declare("/outer/inner");
+  const ParameterSlot missingSlot = schema.declare("missing");
+
+  const Parameters parameters = R"({
+    "id": "abc",
+    "outer": { "inner": 5 }
+  })"_json;
+
+  const ResolvedParameters resolved = schema.resolve(parameters);
+
+  ASSERT_EQ("abc", resolved.getString(idSlot));
+  ASSERT_EQ(5, resolved.get(nestedSlot)->get<int>());
+  ASSERT_FALSE(resolved.has(missingSlot));
+}
+
+TEST(ParameterSchemaTests, WhenParametersAreInherited_SlotsFindThem) {
+  ParameterSchema schema;
+  const ParameterSlot idSlot =
+      schema.declare("id", ParameterSchema::Type::String);
+
+  const Parameters parent = R"({ "id": "from parent" })"_json;
+  Parameters parameters = R"({ "other": 1 })"_json;
+  parameters.inheritFrom(parent);
+
+  ASSERT_EQ("from parent", schema.resolve(parameters).getString(idSlot));
+}
+
+TEST(ParameterSchemaTests, WhenARequiredParameterIsMissing_ResolveThrows) {
+  ParameterSchema schema;
+  schema.declare(
+      "id",
+      ParameterSchema::Type::Any,
+      ParameterSchema::Presence::Required);
+
+  const Parameters parameters = R"({ "other": 1 })"_json;
+
+  EXPECT_ANY_THROW(schema.resolve(parameters));
+}
+
+TEST(ParameterSchemaTests, WhenAParameterHasTheWrongType_ResolveThrows) {
+  ParameterSchema schema;
+  schema.declare("id", ParameterSchema::Type::String);
+
+  const Parameters parameters = R"({ "id": 1 })"_json;
+
+  EXPECT_ANY_THROW(schema.resolve(parameters));
+}
+
+}  // namespace maplang
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gtest/gtest.h"
+#include "maplang/Parameters.h"
+
+using namespace std;
+using namespace nlohmann;
+
+namespace maplang {
+
+TEST(ParametersTests, WhenACopyIsModified_TheOriginalIsNotChanged) {
+  Parameters original = R"({ "key1": "value1" })"_json;
+  Parameters copy = original;
+
+  ASSERT_TRUE(copy.sharesValueWith(original));
+
+  copy["key1"] = "changed";
+
+  ASSERT_FALSE(copy.sharesValueWith(original));
+  ASSERT_EQ("value1", original["key1"].get<string>());
+  ASSERT_EQ("changed", copy["key1"].get<string>());
+}
+
+TEST(ParametersTests, WhenParametersInherit_OwnValuesAreNotOverwritten) {
+  const Parameters parent = R"({ "key1": "parent", "key2": "parent" })"_json;
+  Parameters child = R"({ "key1": "child" })"_json;
+
+  child.inheritFrom(parent);
+
+  ASSERT_EQ("child", child["key1"].get<string>());
+  ASSERT_EQ("parent", child["key2"].get<string>());
+  ASSERT_FALSE(child.contains("key3"));
+  ASSERT_EQ(R"({ "key1": "child", "key2": "parent" })"_json, child);
+  ASSERT_EQ(R"({ "key1": "parent", "key2": "parent" })"_json, parent);
+}
+
+TEST(ParametersTests, WhenNullParametersInherit_TheyShareTheParentsValue) {
+  const Parameters parent = R"({ "key1": "parent" })"_json;
+  Parameters child;
+
+  child.inheritFrom(parent);
+
+  ASSERT_TRUE(child.sharesValueWith(parent));
+}
+
+TEST(ParametersTests, WhenAnInheritingCopyIsModified_TheParentIsNotChanged) {
+  const Parameters parent = R"({ "key1": "parent" })"_json;
+  Parameters child = R"({ "key2": "child" })"_json;
+  child.inheritFrom(parent);
+
+  child["key1"] = "changed";
+
+  ASSERT_EQ("changed", child["key1"].get<string>());
+  ASSERT_EQ("child", child["key2"].get<string>());
+  ASSERT_EQ("parent", parent["key1"].get<string>());
+}
+
+TEST(ParametersTests, WhenALongChainInherits_AllValuesAreVisible) {
+  static constexpr size_t kChainLength = 100;
+
+  Parameters parameters = R"({ "key0": 0 })"_json;
+  for (size_t i = 1; i < kChainLength; i++) {
+    Parameters child = json {{"key" + to_string(i), i}};
+    child.inheritFrom(parameters);
+    parameters = child;
+  }
+
+  for (size_t i = 0; i < kChainLength; i++) {
+    ASSERT_EQ(i, parameters["key" + to_string(i)].get<size_t>());
+  }
+
+  ASSERT_EQ(kChainLength, parameters.asJson().size());
+}
+
+}  // namespace maplang
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "maplang/SlabBufferPool.h"
+
+using namespace std;
+
+namespace maplang {
+
+TEST(SlabBufferPoolTests, WhenABufferIsRequested_ItUsesTheSmallestSizeClass) {
+  SlabBufferPool pool({1024, 4096, 16384});
+
+  ASSERT_EQ(1024, pool.get(1).length);
+  ASSERT_EQ(4096, pool.get(1025).length);
+  ASSERT_EQ(16384, pool.get(16384).length);
+  ASSERT_EQ(16384, pool.get(65536).length);
+}
+
+TEST(SlabBufferPoolTests, WhenABufferIsReleased_ItIsReused) {
+  SlabBufferPool pool;
+
+  Buffer buffer1 = pool.get(1);
+  uint8_t* const rawBuffer1 = buffer1.data.get();
+  const Buffer buffer2 = pool.get(1);
+  buffer1.data.reset();
+
+  const Buffer buffer3 = pool.get(1);
+
+  ASSERT_NE(rawBuffer1, buffer2.data.get());
+  ASSERT_EQ(rawBuffer1, buffer3.data.get());
+}
+
+TEST(SlabBufferPoolTests, WhenABufferIsReleasedOnAnotherThread_ItIsReused) {
+  SlabBufferPool pool({1024});
+
+  Buffer buffer1 = pool.get(1);
+  uint8_t* const rawBuffer1 = buffer1.data.get();
+
+  thread releasingThread([&buffer1] { buffer1.data.reset(); });
+  releasingThread.join();
+
+  // Buffers released on other threads are reused once the free slots run out.
+  vector<Buffer> buffers;
+  bool reused = false;
+  for (size_t i = 0; i < 100000 && !reused; i++) {
+    buffers.push_back(pool.get(1));
+    reused = buffers.back().data.get() == rawBuffer1;
+  }
+
+  ASSERT_TRUE(reused);
+}
+
+TEST(SlabBufferPoolTests, WhenABufferIsReleased_OnReleaseIsCalled) {
+  SlabBufferPool pool;
+  size_t allocatedSize;
+  uint8_t* const data = pool.allocate(100, &allocatedSize);
+  bool released = false;
+
+  BufferPtr buffer =
+      SlabBufferPool::share(data, [&released] { released = true; });
+  ASSERT_FALSE(released);
+
+  buffer.reset();
+
+  ASSERT_TRUE(released);
+}
+
+TEST(SlabBufferPoolTests, WhenThePoolIsDeletedBeforeABuffer_ItDoesntCrash) {
+  Buffer buffer;
+
+  {
+    SlabBufferPool pool;
+    buffer = pool.get(1);
+  }
+
+  buffer.data.get()[0] = 1;
+  buffer.data.reset();
+}
+
+}  // namespace maplang
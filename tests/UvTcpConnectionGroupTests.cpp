@@ -0,0 +1,539 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nodes/UvTcpConnectionGroup.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <future>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "maplang/FactoriesBuilder.h"
+#include "maplang/LambdaPacketPusher.h"
+#include "maplang/UvLoopRunner.h"
+
+using namespace std;
+using namespace nlohmann;
+
+namespace maplang {
+
+static constexpr chrono::seconds kMaxWait(5);
+
+class TestSubgraphContext final : public ISubgraphContext {
+ public:
+  explicit TestSubgraphContext(const shared_ptr<uv_loop_t>& uvLoop)
+      : mUvLoop(uvLoop) {}
+
+  shared_ptr<uv_loop_t> getUvLoop() const override { return mUvLoop; }
+
+ private:
+  const shared_ptr<uv_loop_t> mUvLoop;
+};
+
+/*
+ * Runs a UvTcpConnectionGroup on its own loop, and connects to it with
+ * loopback sockets. Packets from the group are kept by channel.
+ */
+class UvTcpConnectionGroupTests : public testing::Test {
+ public:
+  UvTcpConnectionGroupTests()
+      : mFactories(FactoriesBuilder().BuildFactories()),
+        mUvLoopRunner(make_shared<UvLoopRunner>()),
+        mPacketPusher(make_shared<LambdaPacketPusher>(
+            [this](const Packet& packet, const string& channel) {
+              lock_guard<mutex> lock(mMutex);
+              mPackets[channel].push_back(packet);
+              if (channel == "Data Received") {
+                mReceivedByteCount += countBytes({packet});
+              }
+
+              mPacketPushed.notify_all();
+            })) {}
+
+  ~UvTcpConnectionGroupTests() override {
+    for (int client : mClients) {
+      close(client);
+    }
+
+    if (mGroup != nullptr && mUvLoopRunner != nullptr) {
+      destroyGroup();
+    }
+  }
+
+  // Runs |task| on the loop's thread, and returns once it has run.
+  void runOnLoop(function<void()>&& task) {
+    promise<void> ran;
+    mUvLoopRunner->post([&task, &ran] {
+      task();
+      ran.set_value();
+    });
+
+    ASSERT_EQ(future_status::ready, ran.get_future().wait_for(kMaxWait));
+  }
+
+  void createGroup(const json& initParameters) {
+    runOnLoop([this, &initParameters] {
+      mGroup = make_shared<UvTcpConnectionGroup>(mFactories, initParameters);
+      mGroup->getInterface("Receiver")->asSource()->setPacketPusher(
+          mPacketPusher);
+      mGroup->getInterface("Async Events")->asSource()->setPacketPusher(
+          mPacketPusher);
+      mGroup->getInterface("Listener")->setSubgraphContext(
+          make_shared<TestSubgraphContext>(mUvLoopRunner->getLoop()));
+    });
+  }
+
+  // Listens on a loopback port, and returns it.
+  uint16_t listen() {
+    Packet listenPacket;
+    listenPacket.parameters["Address"] = "127.0.0.1";
+    listenPacket.parameters["Port"] = 0;
+    sendToInterface("Listener", listenPacket);
+
+    EXPECT_TRUE(waitForPackets("Listening", 1));
+    return getPackets("Listening")[0].parameters["LocalPort"].get<uint16_t>();
+  }
+
+  void sendToInterface(const string& interfaceName, const Packet& packet) {
+    runOnLoop([this, &interfaceName, &packet] {
+      mGroup->getInterface(interfaceName)
+          ->asPathable()
+          ->handlePacket(PathablePacket(packet, mPacketPusher));
+    });
+  }
+
+  // Returns the client's socket, which is closed after the test.
+  int connectClient(uint16_t port) {
+    const int client = socket(AF_INET, SOCK_STREAM, 0);
+    EXPECT_LE(0, client);
+
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    EXPECT_EQ(
+        0,
+        connect(
+            client,
+            reinterpret_cast<const sockaddr*>(&address),
+            sizeof(address)));
+
+    mClients.insert(client);
+    return client;
+  }
+
+  void closeClient(int client) {
+    close(client);
+    mClients.erase(client);
+  }
+
+  // Returns false if |channel| doesn't get |count| packets in time.
+  bool waitForPackets(const string& channel, size_t count) {
+    unique_lock<mutex> lock(mMutex);
+    return mPacketPushed.wait_for(lock, kMaxWait, [this, &channel, count] {
+      return mPackets[channel].size() >= count;
+    });
+  }
+
+  bool waitForReceivedBytes(size_t byteCount) {
+    unique_lock<mutex> lock(mMutex);
+    return mPacketPushed.wait_for(lock, kMaxWait, [this, byteCount] {
+      return mReceivedByteCount >= byteCount;
+    });
+  }
+
+  size_t getReceivedByteCount() {
+    lock_guard<mutex> lock(mMutex);
+    return mReceivedByteCount;
+  }
+
+  // Releases the buffers of the Data Received packets kept so far.
+  void releaseReceivedBuffers() {
+    vector<Packet> dataReceivedPackets;
+    {
+      lock_guard<mutex> lock(mMutex);
+      dataReceivedPackets.swap(mPackets["Data Received"]);
+    }
+  }
+
+  vector<Packet> getPackets(const string& channel) {
+    lock_guard<mutex> lock(mMutex);
+    return mPackets[channel];
+  }
+
+  /*
+   * Releases the group on the loop's thread. Returns true if the loop then
+   * exits, i.e. the group left no handles open.
+   */
+  bool destroyGroup() {
+    runOnLoop([this] { mGroup.reset(); });
+
+    mUvLoopRunner->drain();
+    return mUvLoopRunner->waitForExit(
+        chrono::duration_cast<chrono::milliseconds>(kMaxWait));
+  }
+
+  static size_t countBytes(const vector<Packet>& packets) {
+    size_t byteCount = 0;
+    for (const Packet& packet : packets) {
+      for (const Buffer& buffer : packet.buffers) {
+        byteCount += buffer.length;
+      }
+    }
+
+    return byteCount;
+  }
+
+  static uint64_t getConnectionId(const Packet& packet) {
+    return packet.parameters["TcpConnectionId"].get<uint64_t>();
+  }
+
+  const Factories mFactories;
+  shared_ptr<UvLoopRunner> mUvLoopRunner;
+  const shared_ptr<IPacketPusher> mPacketPusher;
+
+  // Only used on the loop's thread.
+  shared_ptr<UvTcpConnectionGroup> mGroup;
+
+  set<int> mClients;
+
+  mutex mMutex;
+  condition_variable mPacketPushed;
+  map<string, vector<Packet>> mPackets;
+  size_t mReceivedByteCount = 0;
+};
+
+TEST_F(
+    UvTcpConnectionGroupTests,
+    WhenTheListenerIsSharded_ConnectionsAreSpreadAcrossShardsAndClosedByEach) {
+  static constexpr size_t kShardCount = 4;
+  static constexpr size_t kClientCount = 16;
+  static constexpr size_t kBytesPerClient = 1000;
+
+  createGroup({{"listenerShards", kShardCount}});
+  const uint16_t port = listen();
+
+  // The other shards start listening after shard 0.
+  usleep(100000);
+
+  vector<int> clients;
+  const string data(kBytesPerClient, 'x');
+  for (size_t i = 0; i < kClientCount; i++) {
+    const int client = connectClient(port);
+    ASSERT_EQ(data.size(), write(client, data.data(), data.size()));
+    clients.push_back(client);
+  }
+
+  ASSERT_TRUE(waitForReceivedBytes(kClientCount * kBytesPerClient));
+  ASSERT_TRUE(waitForPackets("New Incoming Connection", kClientCount));
+
+  map<uint16_t, uint64_t> connectionIdsByRemotePort;
+  map<uint64_t, uint32_t> connectionShards;
+  for (const Packet& packet : getPackets("New Incoming Connection")) {
+    const uint32_t shard = packet.parameters["TcpShard"].get<uint32_t>();
+    ASSERT_GT(kShardCount, shard);
+
+    const uint64_t connectionId = getConnectionId(packet);
+    connectionIdsByRemotePort[packet.parameters["RemotePort"]
+                                  .get<uint16_t>()] = connectionId;
+    connectionShards[connectionId] = shard;
+  }
+
+  ASSERT_EQ(kClientCount, connectionShards.size());
+
+  set<uint32_t> shardsUsed;
+  for (const auto& [connectionId, shard] : connectionShards) {
+    shardsUsed.insert(shard);
+  }
+
+  ASSERT_LT(1, shardsUsed.size());
+
+  for (const Packet& packet : getPackets("Data Received")) {
+    ASSERT_EQ(
+        connectionShards[getConnectionId(packet)],
+        packet.parameters["TcpShard"].get<uint32_t>());
+  }
+
+  // A quarter of the clients disconnect, and a quarter are disconnected
+  // through shard 0, which forwards to each connection's shard.
+  set<uint64_t> disconnectedIds;
+  for (size_t i = 0; i < kClientCount / 2; i++) {
+    if (i < kClientCount / 4) {
+      closeClient(clients[i]);
+      continue;
+    }
+
+    sockaddr_in address {};
+    socklen_t addressLength = sizeof(address);
+    getsockname(
+        clients[i],
+        reinterpret_cast<sockaddr*>(&address),
+        &addressLength);
+    const uint64_t connectionId =
+        connectionIdsByRemotePort[ntohs(address.sin_port)];
+    disconnectedIds.insert(connectionId);
+
+    Packet disconnectPacket;
+    disconnectPacket.parameters["TcpConnectionId"] = connectionId;
+    sendToInterface("Disconnector", disconnectPacket);
+  }
+
+  ASSERT_TRUE(waitForPackets("Connection Closed", kClientCount / 2));
+
+  set<uint64_t> closedIds;
+  for (const Packet& packet : getPackets("Connection Closed")) {
+    const uint64_t connectionId = getConnectionId(packet);
+    ASSERT_EQ(1, connectionShards.count(connectionId));
+    ASSERT_EQ(
+        connectionShards[connectionId],
+        packet.parameters["TcpShard"].get<uint32_t>());
+
+    closedIds.insert(connectionId);
+  }
+
+  ASSERT_EQ(kClientCount / 2, closedIds.size());
+  for (const uint64_t connectionId : disconnectedIds) {
+    ASSERT_EQ(1, closedIds.count(connectionId));
+  }
+
+  // The other half are still open, and are closed without packets.
+  ASSERT_TRUE(destroyGroup());
+  ASSERT_EQ(kClientCount / 2, getPackets("Connection Closed").size());
+
+  for (size_t i = kClientCount / 4; i < kClientCount; i++) {
+    char byte;
+    ASSERT_EQ(0, read(clients[i], &byte, 1));
+  }
+}
+
+TEST_F(
+    UvTcpConnectionGroupTests,
+    WhenAConnectionSlotIsReused_TheClosedConnectionsIdIsUnknown) {
+  createGroup(json::object());
+  const uint16_t port = listen();
+
+  const int firstClient = connectClient(port);
+  ASSERT_TRUE(waitForPackets("New Incoming Connection", 1));
+  const uint64_t firstConnectionId =
+      getConnectionId(getPackets("New Incoming Connection")[0]);
+
+  closeClient(firstClient);
+  ASSERT_TRUE(waitForPackets("Connection Closed", 1));
+
+  // The closed connection's slot is reused, with a new generation.
+  const int secondClient = connectClient(port);
+  ASSERT_TRUE(waitForPackets("New Incoming Connection", 2));
+  const uint64_t secondConnectionId =
+      getConnectionId(getPackets("New Incoming Connection")[1]);
+
+  ASSERT_NE(firstConnectionId, secondConnectionId);
+  ASSERT_EQ(firstConnectionId & 0xFFFFFFFF, secondConnectionId & 0xFFFFFFFF);
+
+  const string data = "sent to the reused slot";
+  Packet dataPacket;
+  dataPacket.parameters["TcpConnectionId"] = firstConnectionId;
+  dataPacket.buffers.emplace_back(data);
+  sendToInterface("Sender", dataPacket);
+
+  const vector<Packet> errorPackets = getPackets("error");
+  ASSERT_EQ(1, errorPackets.size());
+  ASSERT_EQ("Unknown connection", errorPackets[0].parameters["errorName"]);
+
+  dataPacket.parameters["TcpConnectionId"] = secondConnectionId;
+  sendToInterface("Sender", dataPacket);
+
+  string readData(data.size(), 0);
+  size_t readBytes = 0;
+  while (readBytes < data.size()) {
+    const ssize_t readLength =
+        read(secondClient, &readData[readBytes], data.size() - readBytes);
+    ASSERT_LT(0, readLength);
+    readBytes += readLength;
+  }
+
+  ASSERT_EQ(data, readData);
+  ASSERT_EQ(1, getPackets("error").size());
+}
+
+TEST_F(
+    UvTcpConnectionGroupTests,
+    WhenTheWriteQueuePassesTheWaterMarks_FullAndDrainedAreSent) {
+  static constexpr size_t kHighWaterMark = 256 * 1024;
+  static constexpr size_t kLowWaterMark = 64 * 1024;
+  static constexpr size_t kMaxSentBytes = 64 * 1024 * 1024;
+
+  createGroup(
+      {{"writeQueueHighWaterMark", kHighWaterMark},
+       {"writeQueueLowWaterMark", kLowWaterMark}});
+  const int client = connectClient(listen());
+
+  ASSERT_TRUE(waitForPackets("New Incoming Connection", 1));
+  const uint64_t connectionId =
+      getConnectionId(getPackets("New Incoming Connection")[0]);
+
+  Packet dataPacket;
+  dataPacket.parameters["TcpConnectionId"] = connectionId;
+  dataPacket.buffers.emplace_back(string(64 * 1024, 'x'));
+
+  // The client isn't reading, so writes are queued once the sockets' buffers
+  // are full.
+  size_t sentBytes = 0;
+  runOnLoop([this, &dataPacket, &sentBytes] {
+    IPathable* const sender = mGroup->getInterface("Sender")->asPathable();
+    while (sentBytes < kMaxSentBytes
+           && getPackets("Write Queue Full").empty()) {
+      sender->handlePacket(PathablePacket(dataPacket, mPacketPusher));
+      sentBytes += dataPacket.buffers[0].length;
+    }
+  });
+
+  const vector<Packet> fullPackets = getPackets("Write Queue Full");
+  ASSERT_EQ(1, fullPackets.size());
+  ASSERT_EQ(connectionId, getConnectionId(fullPackets[0]));
+  ASSERT_LE(
+      kHighWaterMark,
+      fullPackets[0].parameters["WriteQueueSize"].get<size_t>());
+  ASSERT_TRUE(getPackets("Write Queue Drained").empty());
+
+  // Reading lets the queue drain.
+  vector<char> readBuffer(64 * 1024);
+  size_t readBytes = 0;
+  while (readBytes < sentBytes && getPackets("Write Queue Drained").empty()) {
+    const ssize_t readLength =
+        read(client, readBuffer.data(), readBuffer.size());
+    ASSERT_LT(0, readLength);
+    readBytes += readLength;
+  }
+
+  ASSERT_TRUE(waitForPackets("Write Queue Drained", 1));
+
+  const vector<Packet> drainedPackets = getPackets("Write Queue Drained");
+  ASSERT_EQ(1, drainedPackets.size());
+  ASSERT_EQ(connectionId, getConnectionId(drainedPackets[0]));
+  ASSERT_GE(
+      kLowWaterMark,
+      drainedPackets[0].parameters["WriteQueueSize"].get<size_t>());
+  ASSERT_EQ(1, getPackets("Write Queue Full").size());
+}
+
+TEST_F(
+    UvTcpConnectionGroupTests,
+    WhenReceivingIsPaused_DataIsOnlyDeliveredAfterItResumes) {
+  createGroup(json::object());
+  const int client = connectClient(listen());
+
+  ASSERT_TRUE(waitForPackets("New Incoming Connection", 1));
+  Packet connectionPacket;
+  connectionPacket.parameters["TcpConnectionId"] =
+      getConnectionId(getPackets("New Incoming Connection")[0]);
+
+  sendToInterface("Pause Receiving", connectionPacket);
+
+  const string data = "sent while paused";
+  ASSERT_EQ(data.size(), write(client, data.data(), data.size()));
+  usleep(100000);
+
+  ASSERT_EQ(0, getReceivedByteCount());
+
+  sendToInterface("Resume Receiving", connectionPacket);
+
+  ASSERT_TRUE(waitForReceivedBytes(data.size()));
+  ASSERT_EQ(data.size(), getReceivedByteCount());
+}
+
+TEST_F(
+    UvTcpConnectionGroupTests,
+    WhenTheReceiveBudgetIsUsedUp_ReceivingPausesUntilBuffersAreReleased) {
+  static constexpr size_t kReceiveBudget = 64 * 1024;
+  static constexpr size_t kSentByteCount = 16 * 1024 * 1024;
+
+  createGroup({{"receiveBudget", kReceiveBudget}});
+  const int client = connectClient(listen());
+
+  // Blocks while the group isn't receiving.
+  thread writer([client] {
+    const string data(kSentByteCount, 'x');
+    size_t writtenByteCount = 0;
+    while (writtenByteCount < data.size()) {
+      const ssize_t writeLength = write(
+          client,
+          data.data() + writtenByteCount,
+          data.size() - writtenByteCount);
+      if (writeLength <= 0) {
+        return;
+      }
+
+      writtenByteCount += writeLength;
+    }
+  });
+
+  // The received buffers are kept, so receiving stops at the budget.
+  ASSERT_TRUE(waitForReceivedBytes(kReceiveBudget));
+  usleep(100000);
+  const size_t heldByteCount = getReceivedByteCount();
+  usleep(100000);
+
+  ASSERT_EQ(heldByteCount, getReceivedByteCount());
+  ASSERT_GT(kSentByteCount, heldByteCount);
+
+  // Receiving resumes when the buffers are released.
+  releaseReceivedBuffers();
+  ASSERT_TRUE(waitForReceivedBytes(heldByteCount + 1));
+
+  while (getReceivedByteCount() < kSentByteCount) {
+    const size_t receivedByteCount = getReceivedByteCount();
+    releaseReceivedBuffers();
+    ASSERT_TRUE(waitForReceivedBytes(receivedByteCount + 1));
+  }
+
+  writer.join();
+  ASSERT_EQ(kSentByteCount, getReceivedByteCount());
+}
+
+TEST_F(
+    UvTcpConnectionGroupTests,
+    WhenTheGroupIsReleasedAfterItsLoopStops_ItsHandlesAreClosed) {
+  createGroup({{"receiveBudget", 64 * 1024}});
+
+  // Nothing keeps the loop running without a listening socket or connections.
+  mUvLoopRunner->drain();
+  ASSERT_TRUE(mUvLoopRunner->waitForExit(
+      chrono::duration_cast<chrono::milliseconds>(kMaxWait)));
+
+  const shared_ptr<uv_loop_t> uvLoop = mUvLoopRunner->getLoop();
+  mGroup.reset();
+  mUvLoopRunner.reset();
+
+  size_t openHandleCount = 0;
+  uv_walk(
+      uvLoop.get(),
+      [](uv_handle_t* handle, void* openHandleCount) {
+        (*reinterpret_cast<size_t*>(openHandleCount))++;
+      },
+      &openHandleCount);
+
+  ASSERT_EQ(0, openHandleCount);
+}
+
+}  // namespace maplang
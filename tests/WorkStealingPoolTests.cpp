@@ -0,0 +1,106 @@
+/*
+ * Copyright 2020 VDO Dev Inc <support@maplang.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "maplang/WorkStealingPool.h"
+
+using namespace std;
+
+namespace maplang {
+
+TEST(WorkStealingPoolTests, WhenTasksAreSubmitted_TheyAllRun) {
+  static constexpr size_t kTaskCount = 10000;
+  atomic<size_t> sum = 0;
+  atomic<size_t> ranTaskCount = 0;
+  promise<void> allTasksRan;
+
+  WorkStealingPool<size_t> pool(4, [&](size_t& task) {
+    sum += task;
+    if (++ranTaskCount == kTaskCount) {
+      allTasksRan.set_value();
+    }
+  });
+
+  for (size_t i = 1; i <= kTaskCount; i++) {
+    pool.submit(size_t(i));
+  }
+
+  ASSERT_EQ(
+      future_status::ready,
+      allTasksRan.get_future().wait_for(chrono::seconds(10)));
+  ASSERT_EQ(kTaskCount * (kTaskCount + 1) / 2, sum);
+}
+
+TEST(WorkStealingPoolTests, WhenOneWorkerIsBusy_OtherWorkersStealItsTasks) {
+  static constexpr size_t kTaskCount = 8;
+  mutex threadIdsMutex;
+  set<thread::id> threadIds;
+  atomic<size_t> ranTaskCount = 0;
+  promise<void> allTasksRan;
+
+  WorkStealingPool<size_t>* poolPointer = nullptr;
+  WorkStealingPool<size_t> pool(4, [&](size_t& task) {
+    // The first task submits the rest from its worker, onto its own queue.
+    if (task == 0) {
+      for (size_t i = 1; i < kTaskCount; i++) {
+        poolPointer->submit(size_t(i));
+      }
+    }
+
+    this_thread::sleep_for(chrono::milliseconds(20));
+
+    {
+      lock_guard<mutex> lock(threadIdsMutex);
+      threadIds.insert(this_thread::get_id());
+    }
+
+    if (++ranTaskCount == kTaskCount) {
+      allTasksRan.set_value();
+    }
+  });
+  poolPointer = &pool;
+
+  pool.submit(0);
+
+  ASSERT_EQ(
+      future_status::ready,
+      allTasksRan.get_future().wait_for(chrono::seconds(10)));
+  ASSERT_GT(threadIds.size(), 1);
+  ASSERT_EQ(0, threadIds.count(this_thread::get_id()));
+}
+
+TEST(WorkStealingPoolTests, IsWorkerThreadIsOnlyTrueOnWorkers) {
+  promise<bool> isWorkerThreadOnWorker;
+
+  WorkStealingPool<size_t>* poolPointer = nullptr;
+  WorkStealingPool<size_t> pool(1, [&](size_t& task) {
+    isWorkerThreadOnWorker.set_value(poolPointer->isWorkerThread());
+  });
+  poolPointer = &pool;
+
+  pool.submit(0);
+
+  ASSERT_TRUE(isWorkerThreadOnWorker.get_future().get());
+  ASSERT_FALSE(pool.isWorkerThread());
+}
+
+}  // namespace maplang